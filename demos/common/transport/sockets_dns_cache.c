@@ -0,0 +1,282 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_dns_cache.c
+ * @brief Host name cache shared by the sockets wrappers.
+ */
+
+#include "sockets_dns_cache.h"
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sockets_wrapper.h"
+/*-----------------------------------------------------------*/
+
+/*
+ * convert from seconds to system ticks.
+ */
+#define SECONDS_TO_TICKS( _s_ )    ( ( TickType_t ) ( _s_ ) * ( TickType_t ) configTICK_RATE_HZ )
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief One cached host name.
+ */
+typedef struct SocketsDnsCacheEntry
+{
+    char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ]; /**< Host name, empty if the entry is free. */
+    uint32_t ulAddress;                                 /**< Address, 0 if the resolution failed. */
+    TickType_t xResolvedAt;                             /**< Tick count when it was resolved. */
+    TickType_t xLifetime;                               /**< Ticks it is used for. */
+    SocketsResolver_t xResolver;                        /**< Resolver that produced it. */
+    BaseType_t xLookedUp;                               /**< Looked up since it was resolved. */
+} SocketsDnsCacheEntry_t;
+/*-----------------------------------------------------------*/
+
+static SocketsDnsCacheStats_t xDnsCacheStats;
+
+#if ( SOCKETS_DNS_CACHE_ENTRIES > 0 )
+
+    static SocketsDnsCacheEntry_t xDnsCache[ SOCKETS_DNS_CACHE_ENTRIES ];
+
+/**
+ * @brief Ticks left before an entry expires, 0 if it has.
+ *
+ * Must be called in a critical section.
+ */
+    static TickType_t prvTicksLeft( const SocketsDnsCacheEntry_t * pxEntry )
+    {
+        TickType_t xElapsed = xTaskGetTickCount() - pxEntry->xResolvedAt;
+
+        return ( xElapsed < pxEntry->xLifetime ) ? ( pxEntry->xLifetime - xElapsed ) : 0;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the entry of a host name.
+ *
+ * Must be called in a critical section.
+ *
+ * @return The entry, or NULL if the name is not cached.
+ */
+    static SocketsDnsCacheEntry_t * prvFind( const char * pcHostName )
+    {
+        SocketsDnsCacheEntry_t * pxFound = NULL;
+        size_t xIndex;
+
+        for( xIndex = 0; ( xIndex < SOCKETS_DNS_CACHE_ENTRIES ) && ( pxFound == NULL ); xIndex++ )
+        {
+            if( ( xDnsCache[ xIndex ].cHostName[ 0 ] != '\0' ) &&
+                ( strcmp( xDnsCache[ xIndex ].cHostName, pcHostName ) == 0 ) )
+            {
+                pxFound = &xDnsCache[ xIndex ];
+            }
+        }
+
+        return pxFound;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Cache the result of a resolution, replacing the entry closest to
+ * expiry if the cache is full.
+ */
+    static void prvStore( const char * pcHostName,
+                          uint32_t ulAddress,
+                          SocketsResolver_t xResolver )
+    {
+        SocketsDnsCacheEntry_t * pxEntry;
+        size_t xIndex;
+
+        taskENTER_CRITICAL();
+        {
+            pxEntry = prvFind( pcHostName );
+
+            if( ( ulAddress == 0 ) && ( SOCKETS_DNS_CACHE_NEGATIVE_TTL_SECONDS == 0 ) )
+            {
+                /* Failures are not cached, but a stale address must go. */
+                if( pxEntry != NULL )
+                {
+                    pxEntry->cHostName[ 0 ] = '\0';
+                }
+            }
+            else
+            {
+                for( xIndex = 0; ( xIndex < SOCKETS_DNS_CACHE_ENTRIES ) && ( pxEntry == NULL ); xIndex++ )
+                {
+                    if( xDnsCache[ xIndex ].cHostName[ 0 ] == '\0' )
+                    {
+                        pxEntry = &xDnsCache[ xIndex ];
+                    }
+                }
+
+                if( pxEntry == NULL )
+                {
+                    pxEntry = &xDnsCache[ 0 ];
+
+                    for( xIndex = 1; xIndex < SOCKETS_DNS_CACHE_ENTRIES; xIndex++ )
+                    {
+                        if( prvTicksLeft( &xDnsCache[ xIndex ] ) < prvTicksLeft( pxEntry ) )
+                        {
+                            pxEntry = &xDnsCache[ xIndex ];
+                        }
+                    }
+                }
+
+                ( void ) strcpy( pxEntry->cHostName, pcHostName );
+                pxEntry->ulAddress = ulAddress;
+                pxEntry->xResolvedAt = xTaskGetTickCount();
+                pxEntry->xLifetime = ( ulAddress != 0 ) ?
+                                     SECONDS_TO_TICKS( SOCKETS_DNS_CACHE_TTL_SECONDS ) :
+                                     SECONDS_TO_TICKS( SOCKETS_DNS_CACHE_NEGATIVE_TTL_SECONDS );
+                pxEntry->xResolver = xResolver;
+                pxEntry->xLookedUp = pdFALSE;
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* SOCKETS_DNS_CACHE_ENTRIES > 0 */
+
+uint32_t SocketsDnsCache_Resolve( const char * pcHostName,
+                                  SocketsResolver_t xResolver )
+{
+    uint32_t ulAddress = 0;
+    BaseType_t xCached = pdFALSE;
+
+    #if ( SOCKETS_DNS_CACHE_ENTRIES > 0 )
+        SocketsDnsCacheEntry_t * pxEntry;
+        BaseType_t xCacheable = ( strlen( pcHostName ) <= ( size_t ) SOCKETS_MAX_HOST_NAME_LENGTH ) ?
+                                pdTRUE : pdFALSE;
+
+        if( xCacheable == pdTRUE )
+        {
+            taskENTER_CRITICAL();
+            {
+                pxEntry = prvFind( pcHostName );
+
+                if( ( pxEntry != NULL ) && ( prvTicksLeft( pxEntry ) > 0 ) )
+                {
+                    xCached = pdTRUE;
+                    ulAddress = pxEntry->ulAddress;
+                    pxEntry->xLookedUp = pdTRUE;
+
+                    if( ulAddress != 0 )
+                    {
+                        xDnsCacheStats.ulHits++;
+                    }
+                    else
+                    {
+                        xDnsCacheStats.ulNegativeHits++;
+                    }
+                }
+                else
+                {
+                    xDnsCacheStats.ulMisses++;
+                }
+            }
+            taskEXIT_CRITICAL();
+        }
+    #endif /* SOCKETS_DNS_CACHE_ENTRIES > 0 */
+
+    if( xCached == pdFALSE )
+    {
+        ulAddress = xResolver( pcHostName );
+
+        #if ( SOCKETS_DNS_CACHE_ENTRIES > 0 )
+            /* Names too long to cache are left to the resolver to reject. */
+            if( xCacheable == pdTRUE )
+            {
+                prvStore( pcHostName, ulAddress, xResolver );
+            }
+        #endif
+    }
+
+    return ulAddress;
+}
+/*-----------------------------------------------------------*/
+
+void SocketsDnsCache_Invalidate( const char * pcHostName )
+{
+    #if ( SOCKETS_DNS_CACHE_ENTRIES > 0 )
+        SocketsDnsCacheEntry_t * pxEntry;
+
+        taskENTER_CRITICAL();
+        {
+            pxEntry = prvFind( pcHostName );
+
+            if( pxEntry != NULL )
+            {
+                pxEntry->cHostName[ 0 ] = '\0';
+            }
+        }
+        taskEXIT_CRITICAL();
+    #else
+        ( void ) pcHostName;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+void SocketsDnsCache_Prefetch( void )
+{
+    #if ( SOCKETS_DNS_CACHE_ENTRIES > 0 ) && ( SOCKETS_DNS_CACHE_PREFETCH_SECONDS > 0 )
+        char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ];
+        SocketsResolver_t xResolver = NULL;
+        uint32_t ulAddress;
+        size_t xIndex;
+
+        for( xIndex = 0; xIndex < SOCKETS_DNS_CACHE_ENTRIES; xIndex++ )
+        {
+            cHostName[ 0 ] = '\0';
+
+            taskENTER_CRITICAL();
+            {
+                /* Only addresses in use are worth a DNS query. */
+                if( ( xDnsCache[ xIndex ].cHostName[ 0 ] != '\0' ) &&
+                    ( xDnsCache[ xIndex ].ulAddress != 0 ) &&
+                    ( xDnsCache[ xIndex ].xLookedUp == pdTRUE ) &&
+                    ( prvTicksLeft( &xDnsCache[ xIndex ] ) <= SECONDS_TO_TICKS( SOCKETS_DNS_CACHE_PREFETCH_SECONDS ) ) )
+                {
+                    ( void ) strcpy( cHostName, xDnsCache[ xIndex ].cHostName );
+                    xResolver = xDnsCache[ xIndex ].xResolver;
+                    xDnsCache[ xIndex ].xLookedUp = pdFALSE;
+                }
+            }
+            taskEXIT_CRITICAL();
+
+            if( cHostName[ 0 ] != '\0' )
+            {
+                ulAddress = xResolver( cHostName );
+
+                /* On failure keep the address until it expires. */
+                if( ulAddress != 0 )
+                {
+                    prvStore( cHostName, ulAddress, xResolver );
+
+                    taskENTER_CRITICAL();
+                    {
+                        xDnsCacheStats.ulPrefetches++;
+                    }
+                    taskEXIT_CRITICAL();
+                }
+            }
+        }
+    #endif /* ( SOCKETS_DNS_CACHE_ENTRIES > 0 ) && ( SOCKETS_DNS_CACHE_PREFETCH_SECONDS > 0 ) */
+}
+/*-----------------------------------------------------------*/
+
+void SocketsDnsCache_GetStats( SocketsDnsCacheStats_t * pxStats )
+{
+    taskENTER_CRITICAL();
+    {
+        *pxStats = xDnsCacheStats;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,109 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_dns_cache.h
+ * @brief Host name cache shared by the sockets wrappers.
+ *
+ * Reconnects, backoff retries and the switch from DPS to IoT Hub all resolve
+ * host names the device resolved moments before. The sockets wrappers look
+ * them up here first, and only ask the network stack on a miss.
+ */
+
+#ifndef SOCKETS_DNS_CACHE_H
+#define SOCKETS_DNS_CACHE_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Number of host names cached. Set to 0 to disable the cache.
+ */
+#ifndef SOCKETS_DNS_CACHE_ENTRIES
+    #define SOCKETS_DNS_CACHE_ENTRIES    ( 4 )
+#endif
+
+/**
+ * @brief Seconds a resolved address is used for.
+ *
+ * None of the network stacks report the TTL of the record they resolved, so
+ * keep this below the TTL the service publishes.
+ */
+#ifndef SOCKETS_DNS_CACHE_TTL_SECONDS
+    #define SOCKETS_DNS_CACHE_TTL_SECONDS    ( 300 )
+#endif
+
+/**
+ * @brief Seconds a failed resolution is remembered for, so that retries do not
+ * wait on the DNS server again. Set to 0 to not cache failures.
+ */
+#ifndef SOCKETS_DNS_CACHE_NEGATIVE_TTL_SECONDS
+    #define SOCKETS_DNS_CACHE_NEGATIVE_TTL_SECONDS    ( 5 )
+#endif
+
+/**
+ * @brief Seconds before expiry from which #SocketsDnsCache_Prefetch resolves
+ * an address again. Set to 0 to disable prefetching.
+ */
+#ifndef SOCKETS_DNS_CACHE_PREFETCH_SECONDS
+    #define SOCKETS_DNS_CACHE_PREFETCH_SECONDS    ( 30 )
+#endif
+
+/**
+ * @brief Resolve a host name with the network stack.
+ *
+ * @return The IPv4 address in network byte order, or 0 on failure.
+ */
+typedef uint32_t ( * SocketsResolver_t )( const char * pcHostName );
+
+/**
+ * @brief Cache usage, see #SocketsDnsCache_GetStats.
+ */
+typedef struct SocketsDnsCacheStats
+{
+    uint32_t ulHits;         /**< Lookups answered with a cached address. */
+    uint32_t ulNegativeHits; /**< Lookups answered with a cached failure. */
+    uint32_t ulMisses;       /**< Lookups passed to the network stack. */
+    uint32_t ulPrefetches;   /**< Addresses resolved again before they expired. */
+} SocketsDnsCacheStats_t;
+
+/**
+ * @brief Resolve a host name, from the cache if possible.
+ *
+ * @param[in] pcHostName Host name to resolve.
+ * @param[in] xResolver Resolves the name on a miss. Kept with the entry for
+ * #SocketsDnsCache_Prefetch.
+ *
+ * @return The IPv4 address in network byte order, or 0 on failure.
+ */
+uint32_t SocketsDnsCache_Resolve( const char * pcHostName,
+                                  SocketsResolver_t xResolver );
+
+/**
+ * @brief Drop the cached address of a host name, for example because
+ * connecting to it failed.
+ *
+ * @param[in] pcHostName Host name to drop.
+ */
+void SocketsDnsCache_Invalidate( const char * pcHostName );
+
+/**
+ * @brief Resolve again the host names looked up since they were last resolved,
+ * when they are about to expire.
+ *
+ * Call from a task that has time to spare, so that the next connect finds an
+ * address that has not expired. The samples call it from their keep alive
+ * timer, whose period must stay below #SOCKETS_DNS_CACHE_PREFETCH_SECONDS for
+ * every address to be refreshed in time.
+ */
+void SocketsDnsCache_Prefetch( void );
+
+/**
+ * @brief Get the cache usage since start up.
+ *
+ * @param[out] pxStats Receives the usage.
+ */
+void SocketsDnsCache_GetStats( SocketsDnsCacheStats_t * pxStats );
+
+#endif /* SOCKETS_DNS_CACHE_H */
@@ -17,6 +17,15 @@ typedef void * SocketHandle;
     #define SOCKETS_MAX_HOST_NAME_LENGTH    ( 64 )
 #endif
 
+/**
+ * @brief Longest time, in ticks, Sockets_Connect, Sockets_ConnectTimed and
+ * the TLS transport wait for the server to accept a connection. Callers that
+ * need another bound use Sockets_ConnectStart and Sockets_ConnectPoll.
+ */
+#ifndef SOCKETS_CONNECT_TIMEOUT_TICKS
+    #define SOCKETS_CONNECT_TIMEOUT_TICKS    ( pdMS_TO_TICKS( 10000U ) )
+#endif
+
 /**
  * @brief Error codes
  *
@@ -41,6 +50,46 @@ typedef void * SocketHandle;
  */
 #define SOCKETS_SO_RCVTIMEO         ( 0 )          /**< Set the receive timeout. */
 #define SOCKETS_SO_SNDTIMEO         ( 1 )          /**< Set the send timeout. */
+#define SOCKETS_SO_NODELAY          ( 2 )          /**< Send small segments without waiting for an ACK, uint32_t 0 or 1. */
+#define SOCKETS_SO_KEEPALIVE        ( 3 )          /**< Send TCP keep-alive probes on idle connections, uint32_t 0 or 1. */
+#define SOCKETS_SO_KEEPIDLE         ( 4 )          /**< Seconds idle before the first keep-alive probe, uint32_t. */
+#define SOCKETS_SO_KEEPINTVL        ( 5 )          /**< Seconds between keep-alive probes, uint32_t. */
+#define SOCKETS_SO_KEEPCNT          ( 6 )          /**< Unanswered keep-alive probes before the connection is dropped, uint32_t. */
+#define SOCKETS_SO_SNDBUF           ( 7 )          /**< Send buffer size in bytes, uint32_t. */
+#define SOCKETS_SO_RCVBUF           ( 8 )          /**< Receive buffer size in bytes, uint32_t. */
+#define SOCKETS_SO_WINDOW           ( 9 )          /**< Buffer and TCP window sizes, #SocketsWindow_t. */
+#define SOCKETS_SO_RCVLOWAT         ( 10 )         /**< Bytes received before a receive returns, uint32_t. */
+
+/**
+ * @brief Value of the SOCKETS_SO_WINDOW option, sizes in bytes.
+ *
+ * Stacks that derive the windows from the buffers only use the buffer sizes.
+ */
+typedef struct SocketsWindow
+{
+    uint32_t ulSendBufferSize;    /**< Send buffer size. */
+    uint32_t ulSendWindowSize;    /**< Send window size, at most the send buffer size. */
+    uint32_t ulReceiveBufferSize; /**< Receive buffer size. */
+    uint32_t ulReceiveWindowSize; /**< Receive window size, at most the receive buffer size. */
+} SocketsWindow_t;
+
+/**
+ * @brief One buffer of a scatter-gather send.
+ */
+typedef struct SocketsIoVec
+{
+    const uint8_t * pucData; /**< Buffer that contains data to be sent. */
+    size_t xDataLength;      /**< Length of the data to be sent. */
+} SocketsIoVec_t;
+
+/**
+ * @brief Time spent in each step of Sockets_ConnectTimed, in ticks.
+ */
+typedef struct SocketsConnectTimes
+{
+    TickType_t xResolveTicks; /**< Host name resolution. */
+    TickType_t xConnectTicks; /**< TCP connection establishment. */
+} SocketsConnectTimes_t;
 
 /**
  * @brief Initialize the sockets
@@ -88,6 +137,63 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
                             const char * pcHostName,
                             uint16_t usPort );
 
+/**
+ * @brief Connect the socket to hostname and port, timing each step.
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @param[in] pcHostName `NULL` terminated hostname
+ * @param[in] usPort Connecting port.
+ * @param[out] pxTimes Receives the time spent resolving and connecting,
+ * including on failure. May be NULL.
+ * @return A #BaseType_t with the result of the operation.
+ *        - On success returns SOCKETS_ERROR_NONE
+ */
+BaseType_t Sockets_ConnectTimed( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes );
+
+/**
+ * @brief Start connecting the socket to hostname and port, without waiting
+ * for the server.
+ *
+ * The host name is resolved first, which waits for the DNS server unless
+ * the address is cached. Stacks that cannot connect without blocking connect
+ * before returning.
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @param[in] pcHostName `NULL` terminated hostname
+ * @param[in] usPort Connecting port.
+ * @param[out] pxTimes Receives the time spent resolving and starting the
+ * connection, including on failure. May be NULL.
+ * @return A #BaseType_t with the result of the operation.
+ *        - SOCKETS_ERROR_NONE if the socket is connected.
+ *        - SOCKETS_EWOULDBLOCK if the connection is in progress, see
+ *          Sockets_ConnectPoll.
+ *        - On failure return negative error code.
+ */
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes );
+
+/**
+ * @brief Wait for a connection started with Sockets_ConnectStart.
+ *
+ * A connection that failed, or that the caller gives up on, is closed with
+ * Sockets_Close.
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @param[in] xTimeoutTicks Longest time to wait, 0 to only check, or
+ * portMAX_DELAY to wait until the stack gives up.
+ * @return A #BaseType_t with the result of the operation.
+ *        - SOCKETS_ERROR_NONE once the socket is connected.
+ *        - SOCKETS_EWOULDBLOCK if the connection is still in progress.
+ *        - On failure return negative error code.
+ */
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket,
+                                TickType_t xTimeoutTicks );
+
 /**
  * @brief Disconnect socket handle.
  *
@@ -109,6 +215,23 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
                          uint8_t * pucReceiveBuffer,
                          size_t xReceiveBufferLength );
 
+/**
+ * @brief Wait until socket handle has data to receive.
+ *
+ * A socket the peer closed, or that failed, also counts as readable, since
+ * Sockets_Recv then returns at once.
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @param[in] xTimeoutTicks Longest time to wait, 0 to only check, or
+ * portMAX_DELAY to wait forever.
+ * @return A #BaseType_t with the result of the operation.
+ *        - 1 if the socket is readable.
+ *        - 0 if it did not become readable in time.
+ *        - On failure return negative error code.
+ */
+BaseType_t Sockets_Poll( SocketHandle xSocket,
+                         TickType_t xTimeoutTicks );
+
 /**
  * @brief Send data to socket handle.
  *
@@ -122,15 +245,38 @@ BaseType_t Sockets_Send( SocketHandle xSocket,
                          const uint8_t * pucData,
                          size_t xDataLength );
 
+/**
+ * @brief Send data from several buffers to socket handle.
+ *
+ * The buffers are sent in order, as if they were one contiguous buffer.
+ *
+ * @param[in] xSocket The #SocketHandle used for this call.
+ * @param[in] pxIoVec Array of buffers that contain data to be sent.
+ * @param[in] xIoVecCount Number of buffers in pxIoVec.
+ * @return A #BaseType_t with the result of the operation.
+ *        - On success returns number of bytes sent, which may be less than
+ *          the total when the send timed out.
+ *        - On failure return negative error code.
+ */
+BaseType_t Sockets_SendV( SocketHandle xSocket,
+                          const SocketsIoVec_t * pxIoVec,
+                          size_t xIoVecCount );
+
 /**
  * @brief Set option for socket handle.
  *
+ * Buffer and window sizes are set before connecting, as some stacks allocate
+ * the buffers when the connection is established.
+ *
  * @param[in] xSocket The #SocketHandle used for this call.
  * @param[in] lOptionName Option name.
  * @param[in] pvOptionValue Pointer to option value.
  * @param[in] xOptionLength Lenght of option value.
  * @return A #BaseType_t with the result of the operation.
  *        - On success returns SOCKETS_ERROR_NONE
+ *        - SOCKETS_ENOPROTOOPT if the stack does not support the option,
+ *          or not per socket.
+ *        - On other failures return negative error code.
  */
 BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
                                int32_t lOptionName,
@@ -7,12 +7,14 @@
  */
 
 #include "sockets_wrapper.h"
+#include "sockets_dns_cache.h"
 
 /* Standard includes. */
 #include <string.h>
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 
 /* FreeRTOS+TCP includes. */
 #include "FreeRTOS_IP.h"
@@ -28,6 +30,107 @@
 /* A negative error code indicating a network failure. */
 #define FREERTOS_SOCKETS_WRAPPER_NETWORK_ERROR    ( -1 )
 
+/* Number of open sockets the wrapper keeps a socket set and receive timeout
+ * for. Sockets opened beyond it still work, but create a socket set each time
+ * they are waited on, and connect without the Sockets_ConnectStart poll. */
+#ifndef FREERTOS_SOCKETS_WRAPPER_MAX_SOCKETS
+    #define FREERTOS_SOCKETS_WRAPPER_MAX_SOCKETS    ( 4 )
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+
+/**
+ * @brief State the wrapper keeps for an open socket.
+ */
+    typedef struct SocketsState
+    {
+        Socket_t xSocket;           /**< The socket, NULL if the entry is free. */
+        TickType_t xReceiveTimeout; /**< Receive timeout set through Sockets_SetSockOpt. */
+        SocketSet_t xSocketSet;     /**< Set the socket is waited on with, created on first use. */
+    } SocketsState_t;
+
+    static SocketsState_t xSocketStates[ FREERTOS_SOCKETS_WRAPPER_MAX_SOCKETS ];
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the state of an open socket.
+ *
+ * @return The state, or NULL if the socket was not opened by Sockets_Open.
+ */
+    static SocketsState_t * prvSocketState( Socket_t xTcpSocket )
+    {
+        SocketsState_t * pxState = NULL;
+        size_t xIndex;
+
+        for( xIndex = 0; ( xIndex < FREERTOS_SOCKETS_WRAPPER_MAX_SOCKETS ) && ( pxState == NULL ); xIndex++ )
+        {
+            if( xSocketStates[ xIndex ].xSocket == xTcpSocket )
+            {
+                pxState = &xSocketStates[ xIndex ];
+            }
+        }
+
+        return pxState;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Socket set to wait on a socket with, kept until the socket is
+ * closed so waiting does not allocate. Give it back with prvSocketSetGive.
+ *
+ * @return The set, or NULL if it could not be created.
+ */
+    static SocketSet_t prvSocketSetTake( Socket_t xTcpSocket )
+    {
+        SocketsState_t * pxState = prvSocketState( xTcpSocket );
+        SocketSet_t xSocketSet;
+
+        if( pxState == NULL )
+        {
+            /* The socket has no state to keep the set in. */
+            xSocketSet = FreeRTOS_CreateSocketSet();
+        }
+        else
+        {
+            if( pxState->xSocketSet == NULL )
+            {
+                pxState->xSocketSet = FreeRTOS_CreateSocketSet();
+            }
+
+            xSocketSet = pxState->xSocketSet;
+        }
+
+        return xSocketSet;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Give back a set from prvSocketSetTake, deleting it unless it is kept
+ * with the socket.
+ */
+    static void prvSocketSetGive( Socket_t xTcpSocket,
+                                  SocketSet_t xSocketSet )
+    {
+        SocketsState_t * pxState = prvSocketState( xTcpSocket );
+
+        if( ( pxState == NULL ) || ( pxState->xSocketSet != xSocketSet ) )
+        {
+            FreeRTOS_DeleteSocketSet( xSocketSet );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ipconfigSUPPORT_SELECT_FUNCTION == 1 */
+
+/**
+ * @brief Resolve a host name with FreeRTOS+TCP, see #SocketsResolver_t.
+ */
+static uint32_t prvGetHostByName( const char * pcHostName )
+{
+    return ( uint32_t ) FreeRTOS_gethostbyname( pcHostName );
+}
 /*-----------------------------------------------------------*/
 
 BaseType_t Sockets_Init()
@@ -47,6 +150,25 @@ SocketHandle Sockets_Open()
     Socket_t ulSocketNumber = FreeRTOS_socket( FREERTOS_AF_INET, FREERTOS_SOCK_STREAM, FREERTOS_IPPROTO_TCP );
     SocketHandle xSocket;
 
+    #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+        SocketsState_t * pxState = NULL;
+
+        if( ulSocketNumber != FREERTOS_INVALID_SOCKET )
+        {
+            taskENTER_CRITICAL();
+            {
+                /* Without a free entry the socket is used without state. */
+                if( ( pxState = prvSocketState( NULL ) ) != NULL )
+                {
+                    pxState->xSocket = ulSocketNumber;
+                    pxState->xReceiveTimeout = ipconfigSOCK_DEFAULT_RECEIVE_BLOCK_TIME;
+                    pxState->xSocketSet = NULL;
+                }
+            }
+            taskEXIT_CRITICAL();
+        }
+    #endif /* ipconfigSUPPORT_SELECT_FUNCTION == 1 */
+
     if( ulSocketNumber == FREERTOS_INVALID_SOCKET )
     {
         xSocket = ( SocketHandle ) SOCKETS_INVALID_SOCKET;
@@ -62,6 +184,29 @@ SocketHandle Sockets_Open()
 
 BaseType_t Sockets_Close( SocketHandle xSocket )
 {
+    #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+        SocketsState_t * pxState;
+        SocketSet_t xSocketSet = NULL;
+
+        taskENTER_CRITICAL();
+        {
+            if( ( pxState = prvSocketState( ( Socket_t ) xSocket ) ) != NULL )
+            {
+                xSocketSet = pxState->xSocketSet;
+                pxState->xSocketSet = NULL;
+                pxState->xSocket = NULL;
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        /* Deleting the set frees memory, which is not done in a critical
+         * section. */
+        if( xSocketSet != NULL )
+        {
+            FreeRTOS_DeleteSocketSet( xSocketSet );
+        }
+    #endif /* ipconfigSUPPORT_SELECT_FUNCTION == 1 */
+
     return ( BaseType_t ) FreeRTOS_closesocket( ( Socket_t ) xSocket );
 }
 /*-----------------------------------------------------------*/
@@ -69,14 +214,68 @@ BaseType_t Sockets_Close( SocketHandle xSocket )
 BaseType_t Sockets_Connect( SocketHandle xSocket,
                             const char * pcHostName,
                             uint16_t usPort )
+{
+    return Sockets_ConnectTimed( xSocket, pcHostName, usPort, NULL );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectTimed( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes )
+{
+    BaseType_t lRetVal;
+    SocketsConnectTimes_t xTimes = { 0 };
+    TickType_t xStart;
+
+    lRetVal = Sockets_ConnectStart( xSocket, pcHostName, usPort, &xTimes );
+
+    if( lRetVal == SOCKETS_EWOULDBLOCK )
+    {
+        xStart = xTaskGetTickCount();
+        lRetVal = Sockets_ConnectPoll( xSocket, SOCKETS_CONNECT_TIMEOUT_TICKS );
+        xTimes.xConnectTicks += xTaskGetTickCount() - xStart;
+
+        if( lRetVal != SOCKETS_ERROR_NONE )
+        {
+            /* The host may have moved, resolve it again next time. */
+            SocketsDnsCache_Invalidate( pcHostName );
+            lRetVal = SOCKETS_SOCKET_ERROR;
+        }
+    }
+
+    if( pxTimes != NULL )
+    {
+        *pxTimes = xTimes;
+    }
+
+    return lRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes )
 {
     Socket_t xTcpSocket = ( Socket_t ) xSocket;
-    BaseType_t lRetVal = 0;
+    BaseType_t lRetVal = SOCKETS_ERROR_NONE;
+    BaseType_t xResult;
     struct freertos_sockaddr xServerAddress = { 0 };
     uint32_t ulIPAddres;
+    SocketsConnectTimes_t xTimes = { 0 };
+    TickType_t xStart = xTaskGetTickCount();
+
+    #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+        SocketsState_t * pxState = prvSocketState( xTcpSocket );
+        TickType_t xNoWait = 0;
+    #endif
 
     /* Check for errors from DNS lookup. */
-    if( ( ulIPAddres = ( uint32_t ) FreeRTOS_gethostbyname( pcHostName ) ) == 0 )
+    ulIPAddres = SocketsDnsCache_Resolve( pcHostName, prvGetHostByName );
+    xTimes.xResolveTicks = xTaskGetTickCount() - xStart;
+
+    if( ulIPAddres == 0 )
     {
         lRetVal = SOCKETS_SOCKET_ERROR;
     }
@@ -88,16 +287,108 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
         xServerAddress.sin_addr = ulIPAddres;
         xServerAddress.sin_len = ( uint8_t ) sizeof( xServerAddress );
 
-        if( FreeRTOS_connect( xTcpSocket, &xServerAddress, sizeof( xServerAddress ) ) != 0 )
+        xStart = xTaskGetTickCount();
+
+        #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+            /* FreeRTOS_connect only returns before the server answers when
+             * the receive timeout is 0. FreeRTOS+TCP has no getsockopt, so
+             * the timeout restored afterwards is the one remembered by
+             * Sockets_SetSockOpt. */
+            if( pxState != NULL )
+            {
+                ( void ) FreeRTOS_setsockopt( xTcpSocket, 0, FREERTOS_SO_RCVTIMEO, &xNoWait, sizeof( xNoWait ) );
+            }
+        #endif
+
+        xResult = FreeRTOS_connect( xTcpSocket, &xServerAddress, sizeof( xServerAddress ) );
+
+        #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+            if( pxState != NULL )
+            {
+                ( void ) FreeRTOS_setsockopt( xTcpSocket, 0, FREERTOS_SO_RCVTIMEO,
+                                              &( pxState->xReceiveTimeout ), sizeof( pxState->xReceiveTimeout ) );
+            }
+        #endif
+
+        if( ( xResult == -pdFREERTOS_ERRNO_EWOULDBLOCK ) ||
+            ( xResult == -pdFREERTOS_ERRNO_EINPROGRESS ) )
         {
+            lRetVal = SOCKETS_EWOULDBLOCK;
+        }
+        else if( xResult != 0 )
+        {
+            /* The host may have moved, resolve it again next time. */
+            SocketsDnsCache_Invalidate( pcHostName );
             lRetVal = SOCKETS_SOCKET_ERROR;
         }
+
+        xTimes.xConnectTicks = xTaskGetTickCount() - xStart;
+    }
+
+    if( pxTimes != NULL )
+    {
+        *pxTimes = xTimes;
     }
 
     return lRetVal;
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket,
+                                TickType_t xTimeoutTicks )
+{
+    Socket_t xTcpSocket = ( Socket_t ) xSocket;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+
+    #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+        SocketSet_t xSocketSet;
+        EventBits_t xBits;
+
+        if( FreeRTOS_issocketconnected( xTcpSocket ) != pdTRUE )
+        {
+            if( ( xSocketSet = prvSocketSetTake( xTcpSocket ) ) == NULL )
+            {
+                xRetVal = SOCKETS_ENOMEM;
+            }
+            else
+            {
+                /* eSELECT_WRITE reports the connection, eSELECT_EXCEPT its
+                 * failure, as the socket is then closed. */
+                FreeRTOS_FD_SET( xTcpSocket, xSocketSet, eSELECT_WRITE | eSELECT_EXCEPT );
+                ( void ) FreeRTOS_select( xSocketSet, xTimeoutTicks );
+                xBits = FreeRTOS_FD_ISSET( xTcpSocket, xSocketSet );
+                FreeRTOS_FD_CLR( xTcpSocket, xSocketSet, eSELECT_ALL );
+                prvSocketSetGive( xTcpSocket, xSocketSet );
+
+                if( FreeRTOS_issocketconnected( xTcpSocket ) == pdTRUE )
+                {
+                    xRetVal = SOCKETS_ERROR_NONE;
+                }
+                else if( ( xBits & ( EventBits_t ) eSELECT_EXCEPT ) != 0U )
+                {
+                    /* Refused, timed out or reset. */
+                    xRetVal = SOCKETS_SOCKET_ERROR;
+                }
+                else
+                {
+                    xRetVal = SOCKETS_EWOULDBLOCK;
+                }
+            }
+        }
+    #else /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+        /* Sockets_ConnectStart has already waited for the server. */
+        ( void ) xTimeoutTicks;
+
+        if( FreeRTOS_issocketconnected( xTcpSocket ) != pdTRUE )
+        {
+            xRetVal = SOCKETS_SOCKET_ERROR;
+        }
+    #endif /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 void Sockets_Disconnect( SocketHandle xSocket )
 {
     BaseType_t xWaitForShutdownLoopCount = 0;
@@ -133,6 +424,37 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_Poll( SocketHandle xSocket,
+                         TickType_t xTimeoutTicks )
+{
+    BaseType_t xRetVal = 1;
+
+    #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+        SocketSet_t xSocketSet = prvSocketSetTake( ( Socket_t ) xSocket );
+
+        if( xSocketSet == NULL )
+        {
+            xRetVal = SOCKETS_ENOMEM;
+        }
+        else
+        {
+            /* eSELECT_EXCEPT reports a socket the peer closed. */
+            FreeRTOS_FD_SET( ( Socket_t ) xSocket, xSocketSet, eSELECT_READ | eSELECT_EXCEPT );
+            xRetVal = ( FreeRTOS_select( xSocketSet, xTimeoutTicks ) != 0 ) ? 1 : 0;
+            FreeRTOS_FD_CLR( ( Socket_t ) xSocket, xSocketSet, eSELECT_ALL );
+            prvSocketSetGive( ( Socket_t ) xSocket, xSocketSet );
+        }
+    #else /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+        /* Without FreeRTOS_select the socket is reported readable, so that
+         * callers fall back to a receive that blocks for the receive timeout. */
+        ( void ) xSocket;
+        ( void ) xTimeoutTicks;
+    #endif /* if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 ) */
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 BaseType_t Sockets_Send( SocketHandle xSocket,
                          const uint8_t * pucData,
                          size_t xDataLength )
@@ -142,48 +464,216 @@ BaseType_t Sockets_Send( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_SendV( SocketHandle xSocket,
+                          const SocketsIoVec_t * pxIoVec,
+                          size_t xIoVecCount )
+{
+    BaseType_t xSent = 0;
+    BaseType_t xRetVal = 0;
+    BaseType_t xSpace = 0;
+    size_t xTotal = 0;
+    size_t xIndex;
+    uint8_t * pucHead;
+
+    for( xIndex = 0; xIndex < xIoVecCount; xIndex++ )
+    {
+        xTotal += pxIoVec[ xIndex ].xDataLength;
+    }
+
+    /* FreeRTOS+TCP has no gather send. When the buffers fit before the end
+     * of the TX stream buffer, they are copied to its head and handed to the
+     * stack at once, so a small first buffer does not go out in a segment of
+     * its own. A NULL buffer makes FreeRTOS_send only advance the head. */
+    pucHead = FreeRTOS_get_tx_head( ( Socket_t ) xSocket, &xSpace );
+
+    if( ( pucHead != NULL ) && ( xTotal > 0U ) && ( xSpace >= ( BaseType_t ) xTotal ) )
+    {
+        for( xIndex = 0; xIndex < xIoVecCount; xIndex++ )
+        {
+            ( void ) memcpy( pucHead, pxIoVec[ xIndex ].pucData, pxIoVec[ xIndex ].xDataLength );
+            pucHead += pxIoVec[ xIndex ].xDataLength;
+        }
+
+        xRetVal = ( BaseType_t ) FreeRTOS_send( ( Socket_t ) xSocket, NULL, xTotal, 0 );
+
+        if( xRetVal > 0 )
+        {
+            xSent = xRetVal;
+        }
+    }
+    else
+    {
+        /* Otherwise each buffer is copied into the stream buffer in turn,
+         * waiting for space as needed. */
+        for( xIndex = 0; xIndex < xIoVecCount; xIndex++ )
+        {
+            xRetVal = ( BaseType_t ) FreeRTOS_send( ( Socket_t ) xSocket,
+                                                    pxIoVec[ xIndex ].pucData,
+                                                    pxIoVec[ xIndex ].xDataLength, 0 );
+
+            if( xRetVal > 0 )
+            {
+                xSent += xRetVal;
+            }
+
+            if( xRetVal != ( BaseType_t ) pxIoVec[ xIndex ].xDataLength )
+            {
+                break;
+            }
+        }
+    }
+
+    return ( ( xSent > 0 ) || ( xRetVal >= 0 ) ) ? xSent : xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+#if ( ipconfigUSE_TCP_WIN == 1 )
+
+/**
+ * @brief Convert a window size in bytes to the segments FreeRTOS+TCP counts
+ * windows in, at least one.
+ */
+    static int32_t prvWindowSegments( uint32_t ulBytes )
+    {
+        uint32_t ulSegments = ulBytes / ( uint32_t ) ipconfigTCP_MSS;
+
+        return ( ulSegments > 0U ) ? ( int32_t ) ulSegments : 1;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ipconfigUSE_TCP_WIN == 1 */
+
 BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
                                int32_t lOptionName,
                                const void * pvOptionValue,
                                size_t xOptionLength )
 {
     Socket_t xTcpSocket = ( Socket_t ) xSocket;
-    BaseType_t xRetVal;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
     int ulRet = 0;
     TickType_t xTimeout;
+    uint32_t ulValue = 0;
+
+    #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+        SocketsState_t * pxState;
+    #endif
+
+    if( ( lOptionName != SOCKETS_SO_RCVTIMEO ) &&
+        ( lOptionName != SOCKETS_SO_SNDTIMEO ) &&
+        ( lOptionName != SOCKETS_SO_WINDOW ) )
+    {
+        if( xOptionLength != sizeof( uint32_t ) )
+        {
+            xRetVal = SOCKETS_EINVAL;
+        }
+        else
+        {
+            ulValue = *( ( const uint32_t * ) pvOptionValue );
+        }
+    }
 
-    switch( lOptionName )
+    if( xRetVal == SOCKETS_ERROR_NONE )
     {
-        case SOCKETS_SO_RCVTIMEO:
-        case SOCKETS_SO_SNDTIMEO:
-            /* Comply with Berkeley standard - a 0 timeout is wait forever. */
-            xTimeout = *( ( const TickType_t * ) pvOptionValue );
+        switch( lOptionName )
+        {
+            case SOCKETS_SO_RCVTIMEO:
+            case SOCKETS_SO_SNDTIMEO:
+                /* Comply with Berkeley standard - a 0 timeout is wait forever. */
+                xTimeout = *( ( const TickType_t * ) pvOptionValue );
+
+                if( xTimeout == 0U )
+                {
+                    xTimeout = portMAX_DELAY;
+                }
+
+                ulRet = FreeRTOS_setsockopt( xTcpSocket,
+                                             0,
+                                             lOptionName,
+                                             &xTimeout,
+                                             xOptionLength );
+
+                #if ( ipconfigSUPPORT_SELECT_FUNCTION == 1 )
+                    if( ( ulRet == 0 ) && ( lOptionName == SOCKETS_SO_RCVTIMEO ) &&
+                        ( ( pxState = prvSocketState( xTcpSocket ) ) != NULL ) )
+                    {
+                        pxState->xReceiveTimeout = xTimeout;
+                    }
+                #endif
+                break;
 
-            if( xTimeout == 0U )
-            {
-                xTimeout = portMAX_DELAY;
-            }
+            case SOCKETS_SO_NODELAY:
 
-            ulRet = FreeRTOS_setsockopt( xTcpSocket,
-                                         0,
-                                         lOptionName,
-                                         &xTimeout,
-                                         xOptionLength );
+                /* FreeRTOS+TCP has no Nagle algorithm, and already sends
+                 * segments that are not full by default, so there is nothing
+                 * to set. */
+                xRetVal = SOCKETS_ENOPROTOOPT;
+                break;
 
-            if( ulRet != 0 )
-            {
-                xRetVal = SOCKETS_EINVAL;
-            }
-            else
-            {
-                xRetVal = SOCKETS_ERROR_NONE;
-            }
+            case SOCKETS_SO_KEEPALIVE:
+
+                /* ipconfigTCP_KEEP_ALIVE turns keep-alive on for all sockets,
+                 * and ipconfigTCP_KEEP_ALIVE_INTERVAL sets its timing. */
+                if( ( ulValue != 0U ) != ( ipconfigTCP_KEEP_ALIVE != 0 ) )
+                {
+                    xRetVal = SOCKETS_ENOPROTOOPT;
+                }
+
+                break;
+
+            case SOCKETS_SO_SNDBUF:
+                ulRet = FreeRTOS_setsockopt( xTcpSocket,
+                                             0,
+                                             FREERTOS_SO_SNDBUF,
+                                             &ulValue,
+                                             sizeof( ulValue ) );
+                break;
 
-            break;
+            case SOCKETS_SO_RCVBUF:
+                ulRet = FreeRTOS_setsockopt( xTcpSocket,
+                                             0,
+                                             FREERTOS_SO_RCVBUF,
+                                             &ulValue,
+                                             sizeof( ulValue ) );
+                break;
+
+            #if ( ipconfigUSE_TCP_WIN == 1 )
+                case SOCKETS_SO_WINDOW:
+
+                    if( xOptionLength != sizeof( SocketsWindow_t ) )
+                    {
+                        xRetVal = SOCKETS_EINVAL;
+                    }
+                    else
+                    {
+                        const SocketsWindow_t * pxWindow = ( const SocketsWindow_t * ) pvOptionValue;
+                        WinProperties_t xProperties;
+
+                        xProperties.lTxBufSize = ( int32_t ) pxWindow->ulSendBufferSize;
+                        xProperties.lTxWinSize = prvWindowSegments( pxWindow->ulSendWindowSize );
+                        xProperties.lRxBufSize = ( int32_t ) pxWindow->ulReceiveBufferSize;
+                        xProperties.lRxWinSize = prvWindowSegments( pxWindow->ulReceiveWindowSize );
+
+                        ulRet = FreeRTOS_setsockopt( xTcpSocket,
+                                                     0,
+                                                     FREERTOS_SO_WIN_PROPERTIES,
+                                                     &xProperties,
+                                                     sizeof( xProperties ) );
+                    }
+
+                    break;
+            #endif /* ipconfigUSE_TCP_WIN == 1 */
+
+            default:
+                /* Keep-alive timings and low-water marks are not set per
+                 * socket. */
+                xRetVal = SOCKETS_ENOPROTOOPT;
+                break;
+        }
+    }
 
-        default:
-            xRetVal = SOCKETS_ENOPROTOOPT;
-            break;
+    if( ( xRetVal == SOCKETS_ERROR_NONE ) && ( ulRet != 0 ) )
+    {
+        xRetVal = SOCKETS_EINVAL;
     }
 
     return xRetVal;
@@ -7,6 +7,7 @@
  */
 
 #include "sockets_wrapper.h"
+#include "sockets_dns_cache.h"
 
 /* Standard includes. */
 #include <stdbool.h>
@@ -21,9 +22,17 @@
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "semphr.h"
 #include "task.h"
 /*-----------------------------------------------------------*/
 
+/*
+ * Number of buffers passed to lwip_writev at a time.
+ */
+#ifndef SOCKETS_SENDV_MAX_IOVEC
+    #define SOCKETS_SENDV_MAX_IOVEC    ( 8 )
+#endif
+
 /*
  * DNS timeouts.
  */
@@ -31,11 +40,14 @@
     #define lwipdnsresolverMAX_WAIT_SECONDS    ( 20 )
 #endif
 
-#define lwipdnsresolverLOOP_DELAY_MS           ( 250 )
-#define lwipdnsresolverLOOP_DELAY_TICKS        ( ( TickType_t ) lwipdnsresolverLOOP_DELAY_MS / portTICK_PERIOD_MS )
-#define lwipdnsresolverMAX_WAIT_CYCLES                 \
-    ( ( ( lwipdnsresolverMAX_WAIT_SECONDS ) * 1000 ) / \
-      ( lwipdnsresolverLOOP_DELAY_MS ) )
+#define lwipdnsresolverMAX_WAIT_TICKS          ( ( TickType_t ) lwipdnsresolverMAX_WAIT_SECONDS * configTICK_RATE_HZ )
+
+/*
+ * Number of host names that can be resolved at the same time.
+ */
+#ifndef lwipdnsresolverMAX_REQUESTS
+    #define lwipdnsresolverMAX_REQUESTS    ( 2 )
+#endif
 
 /*
  * convert from system ticks to seconds.
@@ -48,6 +60,32 @@
 #define TICK_TO_US( _t_ )    ( ( _t_ ) * 1000 / configTICK_RATE_HZ * 1000 )
 /*-----------------------------------------------------------*/
 
+/*
+ * State of a DNS request slot.
+ */
+typedef enum DnsRequestState
+{
+    eDnsRequestFree = 0, /* Not in use. */
+    eDnsRequestPending,  /* Waiting for lwip_dns_found_callback. */
+    eDnsRequestDone,     /* Answered, the caller has not collected the address yet. */
+    eDnsRequestAbandoned /* The caller timed out, the callback frees the slot. */
+} DnsRequestState_t;
+
+/*
+ * A host name resolution waiting on lwIP. It outlives the caller if the
+ * caller times out, so that the late callback has somewhere to write.
+ */
+typedef struct DnsRequest
+{
+    DnsRequestState_t xState;
+    uint32_t ulAddr;
+    SemaphoreHandle_t xDone;
+} DnsRequest_t;
+/*-----------------------------------------------------------*/
+
+static DnsRequest_t xDnsRequests[ lwipdnsresolverMAX_REQUESTS ];
+/*-----------------------------------------------------------*/
+
 /*
  * Lwip DNS Found callback, compatible with type "dns_found_callback"
  * declared in lwip/dns.h.
@@ -59,16 +97,114 @@ static void lwip_dns_found_callback( const char * ucName,
                                      const ip_addr_t * xIPAddr,
                                      void * pvCallbackArg )
 {
-    uint32_t * ulAddr = ( uint32_t * ) pvCallbackArg;
+    DnsRequest_t * pxRequest = ( DnsRequest_t * ) pvCallbackArg;
+    BaseType_t xWake = pdFALSE;
+
+    taskENTER_CRITICAL();
+    {
+        if( pxRequest->xState == eDnsRequestAbandoned )
+        {
+            pxRequest->xState = eDnsRequestFree;
+        }
+        else
+        {
+            /* NOTE: IPv4 addresses only */
+            pxRequest->ulAddr = ( xIPAddr != NULL ) ? *( ( uint32_t * ) xIPAddr ) : 0;
+            pxRequest->xState = eDnsRequestDone;
+            xWake = pdTRUE;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if( xWake == pdTRUE )
+    {
+        ( void ) xSemaphoreGive( pxRequest->xDone );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Claim a free DNS request slot.
+ *
+ * Returns NULL if all slots are in use.
+ */
+static DnsRequest_t * prvDnsRequestClaim( void )
+{
+    DnsRequest_t * pxRequest = NULL;
+    size_t xIndex;
 
-    if( xIPAddr != NULL )
+    taskENTER_CRITICAL();
     {
-        *ulAddr = *( ( uint32_t * ) xIPAddr ); /* NOTE: IPv4 addresses only */
+        for( xIndex = 0; ( xIndex < lwipdnsresolverMAX_REQUESTS ) && ( pxRequest == NULL ); xIndex++ )
+        {
+            if( xDnsRequests[ xIndex ].xState == eDnsRequestFree )
+            {
+                pxRequest = &xDnsRequests[ xIndex ];
+                pxRequest->xState = eDnsRequestPending;
+                pxRequest->ulAddr = 0;
+            }
+        }
     }
-    else
+    taskEXIT_CRITICAL();
+
+    if( ( pxRequest != NULL ) && ( pxRequest->xDone == NULL ) )
     {
-        *ulAddr = 0;
+        /* Kept for the lifetime of the application once created. */
+        pxRequest->xDone = xSemaphoreCreateBinary();
+
+        if( pxRequest->xDone == NULL )
+        {
+            pxRequest->xState = eDnsRequestFree;
+            pxRequest = NULL;
+        }
     }
+
+    return pxRequest;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Wait for lwip_dns_found_callback to answer a request, and free the slot
+ * unless the callback still has to run.
+ *
+ * Returns the address, or 0 if the resolution failed or timed out.
+ */
+static uint32_t prvDnsRequestWait( DnsRequest_t * pxRequest )
+{
+    uint32_t ulAddr = 0;
+    TimeOut_t xTimeOut;
+    TickType_t xTicksLeft = lwipdnsresolverMAX_WAIT_TICKS;
+    BaseType_t xFinished = pdFALSE;
+
+    vTaskSetTimeOutState( &xTimeOut );
+
+    while( xFinished == pdFALSE )
+    {
+        ( void ) xSemaphoreTake( pxRequest->xDone, xTicksLeft );
+
+        taskENTER_CRITICAL();
+        {
+            if( pxRequest->xState == eDnsRequestDone )
+            {
+                ulAddr = pxRequest->ulAddr;
+                pxRequest->xState = eDnsRequestFree;
+                xFinished = pdTRUE;
+            }
+            else if( xTaskCheckForTimeOut( &xTimeOut, &xTicksLeft ) != pdFALSE )
+            {
+                pxRequest->xState = eDnsRequestAbandoned;
+                xFinished = pdTRUE;
+            }
+            else
+            {
+                /* Woken by the callback of an earlier request on this slot
+                 * that timed out; keep waiting. */
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    return ulAddr;
 }
 /*-----------------------------------------------------------*/
 
@@ -77,31 +213,37 @@ uint32_t prvGetHostByName( const char * pcHostName )
     uint32_t ulAddr = 0;
     err_t xLwipError = ERR_OK;
     ip_addr_t xLwipIpv4Address;
-    uint32_t ulDnsResolutionWaitCycles = 0;
+    DnsRequest_t * pxRequest;
 
-    if( strlen( pcHostName ) <= ( size_t ) SOCKETS_MAX_HOST_NAME_LENGTH )
+    if( strlen( pcHostName ) > ( size_t ) SOCKETS_MAX_HOST_NAME_LENGTH )
+    {
+        configPRINTF( ( "Host name (%s) too long!", pcHostName ) );
+    }
+    else if( ( pxRequest = prvDnsRequestClaim() ) == NULL )
+    {
+        configPRINTF( ( "Too many DNS requests in progress to resolve (%s)!", pcHostName ) );
+    }
+    else
     {
         xLwipError = dns_gethostbyname_addrtype( pcHostName, &xLwipIpv4Address,
-                                                 lwip_dns_found_callback, ( void * ) &ulAddr,
+                                                 lwip_dns_found_callback, ( void * ) pxRequest,
                                                  LWIP_DNS_ADDRTYPE_IPV4 );
 
         switch( xLwipError )
         {
             case ERR_OK:
                 ulAddr = *( ( uint32_t * ) &xLwipIpv4Address ); /* NOTE: IPv4 addresses only */
+                pxRequest->xState = eDnsRequestFree;
                 break;
 
             case ERR_INPROGRESS:
 
                 /*
-                 * The DNS resolver is working the request.  Wait for it to complete
+                 * The DNS resolver is working the request.  Wait for the callback
                  * or time out; print a timeout error message if configured for debug
                  * printing.
                  */
-                do
-                {
-                    vTaskDelay( lwipdnsresolverLOOP_DELAY_TICKS );
-                }   while( ( ulDnsResolutionWaitCycles++ < lwipdnsresolverMAX_WAIT_CYCLES ) && ulAddr == 0 );
+                ulAddr = prvDnsRequestWait( pxRequest );
 
                 if( ulAddr == 0 )
                 {
@@ -112,16 +254,13 @@ uint32_t prvGetHostByName( const char * pcHostName )
                 break;
 
             default:
+                /* The callback is not called for errors. */
+                pxRequest->xState = eDnsRequestFree;
                 configPRINTF( ( "Unexpected error (%lu) from dns_gethostbyname_addrtype() while resolving (%s)!",
                                 ( uint32_t ) xLwipError, pcHostName ) );
                 break;
         }
     }
-    else
-    {
-        ulAddr = 0;
-        configPRINTF( ( "Host name (%s) too long!", pcHostName ) );
-    }
 
     return ulAddr;
 }
@@ -166,13 +305,62 @@ BaseType_t Sockets_Close( SocketHandle xSocket )
 BaseType_t Sockets_Connect( SocketHandle xSocket,
                             const char * pcHostName,
                             uint16_t usPort )
+{
+    return Sockets_ConnectTimed( xSocket, pcHostName, usPort, NULL );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectTimed( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes )
+{
+    BaseType_t lRetVal;
+    SocketsConnectTimes_t xTimes = { 0 };
+    TickType_t xStart;
+
+    lRetVal = Sockets_ConnectStart( xSocket, pcHostName, usPort, &xTimes );
+
+    if( lRetVal == SOCKETS_EWOULDBLOCK )
+    {
+        xStart = xTaskGetTickCount();
+        lRetVal = Sockets_ConnectPoll( xSocket, SOCKETS_CONNECT_TIMEOUT_TICKS );
+        xTimes.xConnectTicks += xTaskGetTickCount() - xStart;
+
+        if( lRetVal != SOCKETS_ERROR_NONE )
+        {
+            /* The host may have moved, resolve it again next time. */
+            SocketsDnsCache_Invalidate( pcHostName );
+            lRetVal = SOCKETS_SOCKET_ERROR;
+        }
+    }
+
+    if( pxTimes != NULL )
+    {
+        *pxTimes = xTimes;
+    }
+
+    return lRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes )
 {
     uint32_t ulSocketNumber = ( uint32_t ) xSocket;
     int32_t lRetVal = SOCKETS_ERROR_NONE;
     uint32_t ulIPAddres = 0;
     struct sockaddr_in xSockAddr = { 0 };
+    SocketsConnectTimes_t xTimes = { 0 };
+    TickType_t xStart = xTaskGetTickCount();
+    int lFlags;
 
-    if( ( ulIPAddres = prvGetHostByName( pcHostName ) ) == 0 )
+    ulIPAddres = SocketsDnsCache_Resolve( pcHostName, prvGetHostByName );
+    xTimes.xResolveTicks = xTaskGetTickCount() - xStart;
+
+    if( ulIPAddres == 0 )
     {
         lRetVal = SOCKETS_SOCKET_ERROR;
     }
@@ -182,16 +370,87 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
         xSockAddr.sin_addr.s_addr = ulIPAddres;
         xSockAddr.sin_port = lwip_htons( usPort );
 
-        if( lwip_connect( ulSocketNumber, ( struct sockaddr * ) &xSockAddr, sizeof( xSockAddr ) ) < 0 )
+        xStart = xTaskGetTickCount();
+
+        /* The socket stays non-blocking until Sockets_ConnectPoll sees the
+         * connection established. */
+        lFlags = lwip_fcntl( ulSocketNumber, F_GETFL, 0 );
+        ( void ) lwip_fcntl( ulSocketNumber, F_SETFL, lFlags | O_NONBLOCK );
+
+        if( lwip_connect( ulSocketNumber, ( struct sockaddr * ) &xSockAddr, sizeof( xSockAddr ) ) == 0 )
+        {
+            ( void ) lwip_fcntl( ulSocketNumber, F_SETFL, lFlags & ~O_NONBLOCK );
+        }
+        else if( errno == EINPROGRESS )
         {
+            lRetVal = SOCKETS_EWOULDBLOCK;
+        }
+        else
+        {
+            /* The host may have moved, resolve it again next time. */
+            SocketsDnsCache_Invalidate( pcHostName );
             lRetVal = SOCKETS_SOCKET_ERROR;
         }
+
+        xTimes.xConnectTicks = xTaskGetTickCount() - xStart;
+    }
+
+    if( pxTimes != NULL )
+    {
+        *pxTimes = xTimes;
     }
 
     return lRetVal;
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket,
+                                TickType_t xTimeoutTicks )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket;
+    BaseType_t xRetVal;
+    fd_set xWriteSet;
+    fd_set xErrorSet;
+    struct timeval xTV;
+    int lError = 0;
+    socklen_t xErrorLength = sizeof( lError );
+    int lFlags;
+    int lRet;
+
+    FD_ZERO( &xWriteSet );
+    FD_ZERO( &xErrorSet );
+    FD_SET( ulSocketNumber, &xWriteSet );
+    FD_SET( ulSocketNumber, &xErrorSet );
+
+    xTV.tv_sec = TICK_TO_S( xTimeoutTicks );
+    xTV.tv_usec = TICK_TO_US( xTimeoutTicks % configTICK_RATE_HZ );
+
+    /* The socket becomes writable once connected, and reports why it
+     * failed otherwise. */
+    lRet = lwip_select( ( int ) ulSocketNumber + 1, NULL, &xWriteSet, &xErrorSet,
+                        ( xTimeoutTicks == portMAX_DELAY ) ? NULL : &xTV );
+
+    if( lRet == 0 )
+    {
+        xRetVal = SOCKETS_EWOULDBLOCK;
+    }
+    else if( ( lRet < 0 ) ||
+             ( lwip_getsockopt( ulSocketNumber, SOL_SOCKET, SO_ERROR, &lError, &xErrorLength ) != 0 ) ||
+             ( lError != 0 ) )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        lFlags = lwip_fcntl( ulSocketNumber, F_GETFL, 0 );
+        ( void ) lwip_fcntl( ulSocketNumber, F_SETFL, lFlags & ~O_NONBLOCK );
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 void Sockets_Disconnect( SocketHandle xSocket )
 {
     lwip_close( ( uint32_t ) xSocket );
@@ -239,6 +498,30 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_Poll( SocketHandle xSocket,
+                         TickType_t xTimeoutTicks )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket;
+    fd_set xReadSet;
+    fd_set xErrorSet;
+    struct timeval xTV;
+    int lRet;
+
+    FD_ZERO( &xReadSet );
+    FD_ZERO( &xErrorSet );
+    FD_SET( ulSocketNumber, &xReadSet );
+    FD_SET( ulSocketNumber, &xErrorSet );
+
+    xTV.tv_sec = TICK_TO_S( xTimeoutTicks );
+    xTV.tv_usec = TICK_TO_US( xTimeoutTicks % configTICK_RATE_HZ );
+
+    lRet = lwip_select( ( int ) ulSocketNumber + 1, &xReadSet, NULL, &xErrorSet,
+                        ( xTimeoutTicks == portMAX_DELAY ) ? NULL : &xTV );
+
+    return ( lRet < 0 ) ? SOCKETS_SOCKET_ERROR : ( ( lRet > 0 ) ? 1 : 0 );
+}
+/*-----------------------------------------------------------*/
+
 BaseType_t Sockets_Send( SocketHandle xSocket,
                          const uint8_t * pucData,
                          size_t xDataLength )
@@ -250,49 +533,137 @@ BaseType_t Sockets_Send( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_SendV( SocketHandle xSocket,
+                          const SocketsIoVec_t * pxIoVec,
+                          size_t xIoVecCount )
+{
+    struct iovec xIoVec[ SOCKETS_SENDV_MAX_IOVEC ];
+    BaseType_t xSent = 0;
+    BaseType_t xRetVal = 0;
+    size_t xIndex = 0;
+    size_t xCount;
+    size_t xLength;
+
+    /* Hand the buffers to lwIP in batches, so they are queued as one
+     * write instead of one segment per buffer. */
+    while( xIndex < xIoVecCount )
+    {
+        xLength = 0;
+
+        for( xCount = 0; ( xCount < SOCKETS_SENDV_MAX_IOVEC ) && ( xIndex + xCount < xIoVecCount ); xCount++ )
+        {
+            xIoVec[ xCount ].iov_base = ( void * ) pxIoVec[ xIndex + xCount ].pucData;
+            xIoVec[ xCount ].iov_len = pxIoVec[ xIndex + xCount ].xDataLength;
+            xLength += pxIoVec[ xIndex + xCount ].xDataLength;
+        }
+
+        xRetVal = ( BaseType_t ) lwip_writev( ( uint32_t ) xSocket, xIoVec, ( int ) xCount );
+
+        if( xRetVal > 0 )
+        {
+            xSent += xRetVal;
+        }
+
+        if( xRetVal != ( BaseType_t ) xLength )
+        {
+            break;
+        }
+
+        xIndex += xCount;
+    }
+
+    return ( ( xSent > 0 ) || ( xRetVal >= 0 ) ) ? xSent : xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
                                int32_t lOptionName,
                                const void * pvOptionValue,
                                size_t xOptionLength )
 {
     uint32_t ulSocketNumber = ( uint32_t ) xSocket;
-    BaseType_t xRetVal;
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
     int ulRet = 0;
+    int lValue = 0;
 
-    switch( lOptionName )
+    if( ( lOptionName != SOCKETS_SO_RCVTIMEO ) &&
+        ( lOptionName != SOCKETS_SO_SNDTIMEO ) &&
+        ( lOptionName != SOCKETS_SO_WINDOW ) )
     {
-        case SOCKETS_SO_RCVTIMEO:
-        case SOCKETS_SO_SNDTIMEO:
-           {
-               TickType_t xTicks;
-               struct timeval xTV;
+        if( xOptionLength != sizeof( uint32_t ) )
+        {
+            xRetVal = SOCKETS_EINVAL;
+        }
+        else
+        {
+            lValue = ( int ) *( ( const uint32_t * ) pvOptionValue );
+        }
+    }
 
-               xTicks = *( ( const TickType_t * ) pvOptionValue );
+    if( xRetVal == SOCKETS_ERROR_NONE )
+    {
+        switch( lOptionName )
+        {
+            case SOCKETS_SO_RCVTIMEO:
+            case SOCKETS_SO_SNDTIMEO:
+               {
+                   TickType_t xTicks;
+                   struct timeval xTV;
 
-               xTV.tv_sec = TICK_TO_S( xTicks );
-               xTV.tv_usec = TICK_TO_US( xTicks % configTICK_RATE_HZ );
+                   xTicks = *( ( const TickType_t * ) pvOptionValue );
 
-               ulRet = lwip_setsockopt( ulSocketNumber,
-                                        SOL_SOCKET,
-                                        lOptionName == SOCKETS_SO_RCVTIMEO ?
-                                        SO_RCVTIMEO : SO_SNDTIMEO,
-                                        ( struct timeval * ) &xTV,
-                                        sizeof( xTV ) );
+                   xTV.tv_sec = TICK_TO_S( xTicks );
+                   xTV.tv_usec = TICK_TO_US( xTicks % configTICK_RATE_HZ );
 
-               if( ulRet != 0 )
-               {
-                   xRetVal = SOCKETS_EINVAL;
+                   ulRet = lwip_setsockopt( ulSocketNumber,
+                                            SOL_SOCKET,
+                                            lOptionName == SOCKETS_SO_RCVTIMEO ?
+                                            SO_RCVTIMEO : SO_SNDTIMEO,
+                                            ( struct timeval * ) &xTV,
+                                            sizeof( xTV ) );
                }
-               else
-               {
-                   xRetVal = SOCKETS_ERROR_NONE;
-               }
-           }
-           break;
+               break;
 
-        default:
-            xRetVal = SOCKETS_ENOPROTOOPT;
-            break;
+            case SOCKETS_SO_NODELAY:
+                ulRet = lwip_setsockopt( ulSocketNumber, IPPROTO_TCP, TCP_NODELAY,
+                                         &lValue, sizeof( lValue ) );
+                break;
+
+            case SOCKETS_SO_KEEPALIVE:
+                ulRet = lwip_setsockopt( ulSocketNumber, SOL_SOCKET, SO_KEEPALIVE,
+                                         &lValue, sizeof( lValue ) );
+                break;
+
+                #if ( LWIP_TCP_KEEPALIVE == 1 )
+                    case SOCKETS_SO_KEEPIDLE:
+                        ulRet = lwip_setsockopt( ulSocketNumber, IPPROTO_TCP, TCP_KEEPIDLE,
+                                                 &lValue, sizeof( lValue ) );
+                        break;
+
+                    case SOCKETS_SO_KEEPINTVL:
+                        ulRet = lwip_setsockopt( ulSocketNumber, IPPROTO_TCP, TCP_KEEPINTVL,
+                                                 &lValue, sizeof( lValue ) );
+                        break;
+
+                    case SOCKETS_SO_KEEPCNT:
+                        ulRet = lwip_setsockopt( ulSocketNumber, IPPROTO_TCP, TCP_KEEPCNT,
+                                                 &lValue, sizeof( lValue ) );
+                        break;
+                #endif /* LWIP_TCP_KEEPALIVE == 1 */
+
+            default:
+                /* lwIP sizes the buffers and the TCP windows for all sockets,
+                 * with TCP_SND_BUF and TCP_WND, and has no low-water marks.
+                 * SO_RCVBUF only caps the bytes queued on UDP and raw
+                 * sockets, not the window advertised by TCP. */
+                xRetVal = SOCKETS_ENOPROTOOPT;
+                break;
+        }
+    }
+
+    if( ( xRetVal == SOCKETS_ERROR_NONE ) && ( ulRet != 0 ) )
+    {
+        xRetVal = SOCKETS_EINVAL;
     }
 
     return xRetVal;
@@ -0,0 +1,656 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sockets_wrapper_posix.c
+ * @brief Host BSD socket wrapper, for the FreeRTOS POSIX port.
+ *
+ * Calls block the whole FreeRTOS scheduler thread, so this is meant for host
+ * tools such as the TLS benchmark rather than for the samples.
+ */
+
+#include "sockets_wrapper.h"
+#include "sockets_dns_cache.h"
+
+/* Standard includes. */
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX includes. */
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+/*-----------------------------------------------------------*/
+
+/*
+ * Number of buffers passed to writev at a time.
+ */
+#ifndef SOCKETS_SENDV_MAX_IOVEC
+    #define SOCKETS_SENDV_MAX_IOVEC    ( 8 )
+#endif
+
+/*
+ * convert from system ticks to seconds.
+ */
+#define TICK_TO_S( _t_ )     ( ( _t_ ) / configTICK_RATE_HZ )
+
+/*
+ * convert from system ticks to micro seconds.
+ */
+#define TICK_TO_US( _t_ )    ( ( _t_ ) * 1000 / configTICK_RATE_HZ * 1000 )
+
+/*
+ * convert between socket handles and file descriptors.
+ */
+#define HANDLE_TO_FD( _h_ )    ( ( int ) ( intptr_t ) ( _h_ ) )
+#define FD_TO_HANDLE( _fd_ )   ( ( SocketHandle ) ( intptr_t ) ( _fd_ ) )
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Resolve a host name with getaddrinfo, see #SocketsResolver_t.
+ */
+static uint32_t prvGetHostByName( const char * pcHostName )
+{
+    struct addrinfo xHints = { 0 };
+    struct addrinfo * pxAddrInfo = NULL;
+    uint32_t ulAddr = 0;
+
+    /* The socket was opened for IPv4. */
+    xHints.ai_family = AF_INET;
+    xHints.ai_socktype = SOCK_STREAM;
+
+    if( getaddrinfo( pcHostName, NULL, &xHints, &pxAddrInfo ) != 0 )
+    {
+        configPRINTF( ( "Unable to resolve (%s)", pcHostName ) );
+    }
+    else
+    {
+        ulAddr = ( ( struct sockaddr_in * ) pxAddrInfo->ai_addr )->sin_addr.s_addr;
+        freeaddrinfo( pxAddrInfo );
+    }
+
+    return ulAddr;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wait for events on a socket.
+ *
+ * The tick signal of the POSIX port interrupts the wait every tick, so it is
+ * restarted with the time left rather than the full timeout.
+ *
+ * @param[in,out] pxPollFd Socket and events to wait for.
+ * @param[in] lTimeoutMs Longest time to wait, or -1 to wait forever.
+ *
+ * @return As poll.
+ */
+static int prvPoll( struct pollfd * pxPollFd,
+                    int lTimeoutMs )
+{
+    struct timespec xNow;
+    uint64_t ullNowMs;
+    uint64_t ullDeadlineMs;
+    int lRet;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+    ullDeadlineMs = ( ( uint64_t ) xNow.tv_sec * 1000U ) + ( ( uint64_t ) xNow.tv_nsec / 1000000U ) +
+                    ( uint64_t ) lTimeoutMs;
+
+    do
+    {
+        lRet = poll( pxPollFd, 1, lTimeoutMs );
+
+        if( ( lRet < 0 ) && ( errno == EINTR ) && ( lTimeoutMs > 0 ) )
+        {
+            ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+            ullNowMs = ( ( uint64_t ) xNow.tv_sec * 1000U ) + ( ( uint64_t ) xNow.tv_nsec / 1000000U );
+            lTimeoutMs = ( ullNowMs < ullDeadlineMs ) ? ( int ) ( ullDeadlineMs - ullNowMs ) : 0;
+        }
+    } while( ( lRet < 0 ) && ( errno == EINTR ) );
+
+    return lRet;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Receive or send timeout of a socket, as set by Sockets_SetSockOpt.
+ *
+ * @param[in] lFd Socket.
+ * @param[in] lOptionName SO_RCVTIMEO or SO_SNDTIMEO.
+ *
+ * @return The timeout in milliseconds, or -1 to wait forever.
+ */
+static int prvTimeoutMs( int lFd,
+                         int lOptionName )
+{
+    struct timeval xTimeout = { 0 };
+    socklen_t xLength = sizeof( xTimeout );
+    int lTimeoutMs = -1;
+
+    /* A zero timeout blocks forever. */
+    if( ( getsockopt( lFd, SOL_SOCKET, lOptionName, &xTimeout, &xLength ) == 0 ) &&
+        ( ( xTimeout.tv_sec != 0 ) || ( xTimeout.tv_usec != 0 ) ) )
+    {
+        lTimeoutMs = ( int ) ( ( xTimeout.tv_sec * 1000 ) + ( ( xTimeout.tv_usec + 999 ) / 1000 ) );
+    }
+
+    return lTimeoutMs;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Init()
+{
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_DeInit()
+{
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+SocketHandle Sockets_Open()
+{
+    int lFd = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    int lNoDelay = 1;
+    SocketHandle xSocket;
+
+    if( lFd < 0 )
+    {
+        xSocket = SOCKETS_INVALID_SOCKET;
+    }
+    else
+    {
+        /* TLS writes whole records, so Nagle only adds latency. */
+        ( void ) setsockopt( lFd, IPPROTO_TCP, TCP_NODELAY, &lNoDelay, sizeof( lNoDelay ) );
+        xSocket = FD_TO_HANDLE( lFd );
+    }
+
+    return xSocket;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Close( SocketHandle xSocket )
+{
+    return ( BaseType_t ) close( HANDLE_TO_FD( xSocket ) );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Connect( SocketHandle xSocket,
+                            const char * pcHostName,
+                            uint16_t usPort )
+{
+    return Sockets_ConnectTimed( xSocket, pcHostName, usPort, NULL );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectTimed( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes )
+{
+    BaseType_t xRetVal;
+    SocketsConnectTimes_t xTimes = { 0 };
+    TickType_t xStart;
+
+    xRetVal = Sockets_ConnectStart( xSocket, pcHostName, usPort, &xTimes );
+
+    if( xRetVal == SOCKETS_EWOULDBLOCK )
+    {
+        xStart = xTaskGetTickCount();
+        xRetVal = Sockets_ConnectPoll( xSocket, SOCKETS_CONNECT_TIMEOUT_TICKS );
+        xTimes.xConnectTicks += xTaskGetTickCount() - xStart;
+
+        if( xRetVal != SOCKETS_ERROR_NONE )
+        {
+            /* The host may have moved, resolve it again next time. */
+            SocketsDnsCache_Invalidate( pcHostName );
+            xRetVal = SOCKETS_SOCKET_ERROR;
+        }
+    }
+
+    if( pxTimes != NULL )
+    {
+        *pxTimes = xTimes;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes )
+{
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+    struct sockaddr_in xSockAddr = { 0 };
+    uint32_t ulIPAddres = 0;
+    SocketsConnectTimes_t xTimes = { 0 };
+    TickType_t xStart = xTaskGetTickCount();
+    int lFlags;
+    int lRet;
+
+    if( strlen( pcHostName ) > ( size_t ) SOCKETS_MAX_HOST_NAME_LENGTH )
+    {
+        configPRINTF( ( "Host name (%s) too long!", pcHostName ) );
+        xRetVal = SOCKETS_EINVAL;
+    }
+    else if( ( ulIPAddres = SocketsDnsCache_Resolve( pcHostName, prvGetHostByName ) ) == 0 )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        xTimes.xResolveTicks = xTaskGetTickCount() - xStart;
+
+        xSockAddr.sin_family = AF_INET;
+        xSockAddr.sin_addr.s_addr = ulIPAddres;
+        xSockAddr.sin_port = htons( usPort );
+
+        xStart = xTaskGetTickCount();
+
+        /* The socket stays non-blocking until Sockets_ConnectPoll sees the
+         * connection established. A connect interrupted by the tick signal
+         * carries on in the background, as a non-blocking one does. */
+        lFlags = fcntl( HANDLE_TO_FD( xSocket ), F_GETFL, 0 );
+        ( void ) fcntl( HANDLE_TO_FD( xSocket ), F_SETFL, lFlags | O_NONBLOCK );
+
+        lRet = connect( HANDLE_TO_FD( xSocket ), ( struct sockaddr * ) &xSockAddr, sizeof( xSockAddr ) );
+
+        if( lRet == 0 )
+        {
+            ( void ) fcntl( HANDLE_TO_FD( xSocket ), F_SETFL, lFlags & ~O_NONBLOCK );
+        }
+        else if( ( errno == EINPROGRESS ) || ( errno == EINTR ) )
+        {
+            xRetVal = SOCKETS_EWOULDBLOCK;
+        }
+        else
+        {
+            /* The host may have moved, resolve it again next time. */
+            SocketsDnsCache_Invalidate( pcHostName );
+            xRetVal = SOCKETS_SOCKET_ERROR;
+        }
+
+        xTimes.xConnectTicks = xTaskGetTickCount() - xStart;
+    }
+
+    if( pxTimes != NULL )
+    {
+        *pxTimes = xTimes;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket,
+                                TickType_t xTimeoutTicks )
+{
+    struct pollfd xPollFd;
+    BaseType_t xRetVal;
+    int lTimeoutMs = -1;
+    int lError = 0;
+    socklen_t xErrorLength = sizeof( lError );
+    int lFlags;
+    int lRet;
+
+    xPollFd.fd = HANDLE_TO_FD( xSocket );
+    xPollFd.events = POLLOUT;
+    xPollFd.revents = 0;
+
+    if( xTimeoutTicks != portMAX_DELAY )
+    {
+        lTimeoutMs = ( int ) ( ( uint64_t ) xTimeoutTicks * 1000U / configTICK_RATE_HZ );
+    }
+
+    lRet = prvPoll( &xPollFd, lTimeoutMs );
+
+    if( lRet == 0 )
+    {
+        xRetVal = SOCKETS_EWOULDBLOCK;
+    }
+    else if( ( lRet < 0 ) ||
+             ( getsockopt( xPollFd.fd, SOL_SOCKET, SO_ERROR, &lError, &xErrorLength ) != 0 ) ||
+             ( lError != 0 ) )
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        lFlags = fcntl( xPollFd.fd, F_GETFL, 0 );
+        ( void ) fcntl( xPollFd.fd, F_SETFL, lFlags & ~O_NONBLOCK );
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Disconnect( SocketHandle xSocket )
+{
+    ( void ) shutdown( HANDLE_TO_FD( xSocket ), SHUT_RDWR );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Recv( SocketHandle xSocket,
+                         uint8_t * pucReceiveBuffer,
+                         size_t xReceiveBufferLength )
+{
+    struct pollfd xPollFd;
+    ssize_t lRetVal;
+    BaseType_t xRetVal;
+
+    xPollFd.fd = HANDLE_TO_FD( xSocket );
+    xPollFd.events = POLLIN;
+    xPollFd.revents = 0;
+
+    /* The receive timeout is waited for in prvPoll, as the tick signal of
+     * the POSIX port would restart it with every interrupted recv. */
+    do
+    {
+        lRetVal = recv( xPollFd.fd, pucReceiveBuffer, xReceiveBufferLength, MSG_DONTWAIT );
+    } while( ( lRetVal < 0 ) && ( errno == EINTR ) );
+
+    /* A timeout leaves errno at EAGAIN. */
+    if( ( lRetVal < 0 ) && ( ( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) ) &&
+        ( prvPoll( &xPollFd, prvTimeoutMs( xPollFd.fd, SO_RCVTIMEO ) ) > 0 ) )
+    {
+        do
+        {
+            lRetVal = recv( xPollFd.fd, pucReceiveBuffer, xReceiveBufferLength, MSG_DONTWAIT );
+        } while( ( lRetVal < 0 ) && ( errno == EINTR ) );
+    }
+
+    if( lRetVal > 0 )
+    {
+        xRetVal = ( BaseType_t ) lRetVal;
+    }
+    else if( lRetVal == 0 )
+    {
+        /* Orderly shutdown by the peer. */
+        xRetVal = SOCKETS_ECLOSED;
+    }
+    else if( ( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) )
+    {
+        xRetVal = SOCKETS_ERROR_NONE; /* timeout or would block */
+    }
+    else if( ( errno == EBADF ) || ( errno == ENOTCONN ) )
+    {
+        xRetVal = SOCKETS_ECLOSED;
+    }
+    else
+    {
+        xRetVal = SOCKETS_SOCKET_ERROR;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Poll( SocketHandle xSocket,
+                         TickType_t xTimeoutTicks )
+{
+    struct pollfd xPollFd;
+    int lTimeoutMs = -1;
+    int lRet;
+
+    xPollFd.fd = HANDLE_TO_FD( xSocket );
+    xPollFd.events = POLLIN;
+    xPollFd.revents = 0;
+
+    if( xTimeoutTicks != portMAX_DELAY )
+    {
+        lTimeoutMs = ( int ) ( ( uint64_t ) xTimeoutTicks * 1000U / configTICK_RATE_HZ );
+    }
+
+    lRet = prvPoll( &xPollFd, lTimeoutMs );
+
+    /* POLLHUP and POLLERR are reported without being asked for. */
+    return ( lRet < 0 ) ? SOCKETS_SOCKET_ERROR : ( ( lRet > 0 ) ? 1 : 0 );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Send( SocketHandle xSocket,
+                         const uint8_t * pucData,
+                         size_t xDataLength )
+{
+    struct pollfd xPollFd;
+    ssize_t lRetVal;
+
+    xPollFd.fd = HANDLE_TO_FD( xSocket );
+    xPollFd.events = POLLOUT;
+    xPollFd.revents = 0;
+
+    /* As for Sockets_Recv, wait for room in prvPoll. */
+    do
+    {
+        lRetVal = send( xPollFd.fd, pucData, xDataLength, MSG_NOSIGNAL | MSG_DONTWAIT );
+    } while( ( lRetVal < 0 ) && ( errno == EINTR ) );
+
+    if( ( lRetVal < 0 ) && ( ( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) ) &&
+        ( prvPoll( &xPollFd, prvTimeoutMs( xPollFd.fd, SO_SNDTIMEO ) ) > 0 ) )
+    {
+        do
+        {
+            lRetVal = send( xPollFd.fd, pucData, xDataLength, MSG_NOSIGNAL | MSG_DONTWAIT );
+        } while( ( lRetVal < 0 ) && ( errno == EINTR ) );
+    }
+
+    if( ( lRetVal < 0 ) && ( ( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) ) )
+    {
+        lRetVal = 0; /* timeout */
+    }
+
+    return ( BaseType_t ) lRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SendV( SocketHandle xSocket,
+                          const SocketsIoVec_t * pxIoVec,
+                          size_t xIoVecCount )
+{
+    struct iovec xIoVec[ SOCKETS_SENDV_MAX_IOVEC ];
+    struct msghdr xMsg = { 0 };
+    struct pollfd xPollFd;
+    BaseType_t xSent = 0;
+    BaseType_t xRetVal = 0;
+    size_t xIndex = 0;
+    size_t xCount;
+    size_t xLength;
+
+    xPollFd.fd = HANDLE_TO_FD( xSocket );
+    xPollFd.events = POLLOUT;
+    xPollFd.revents = 0;
+
+    /* Hand the buffers to the kernel in batches, so they are queued as one
+     * write instead of one segment per buffer. */
+    while( xIndex < xIoVecCount )
+    {
+        xLength = 0;
+
+        for( xCount = 0; ( xCount < SOCKETS_SENDV_MAX_IOVEC ) && ( xIndex + xCount < xIoVecCount ); xCount++ )
+        {
+            xIoVec[ xCount ].iov_base = ( void * ) pxIoVec[ xIndex + xCount ].pucData;
+            xIoVec[ xCount ].iov_len = pxIoVec[ xIndex + xCount ].xDataLength;
+            xLength += pxIoVec[ xIndex + xCount ].xDataLength;
+        }
+
+        xMsg.msg_iov = xIoVec;
+        xMsg.msg_iovlen = xCount;
+
+        do
+        {
+            xRetVal = ( BaseType_t ) sendmsg( xPollFd.fd, &xMsg, MSG_NOSIGNAL | MSG_DONTWAIT );
+        } while( ( xRetVal < 0 ) && ( errno == EINTR ) );
+
+        if( ( xRetVal < 0 ) && ( ( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) ) &&
+            ( prvPoll( &xPollFd, prvTimeoutMs( xPollFd.fd, SO_SNDTIMEO ) ) > 0 ) )
+        {
+            do
+            {
+                xRetVal = ( BaseType_t ) sendmsg( xPollFd.fd, &xMsg, MSG_NOSIGNAL | MSG_DONTWAIT );
+            } while( ( xRetVal < 0 ) && ( errno == EINTR ) );
+        }
+
+        if( xRetVal > 0 )
+        {
+            xSent += xRetVal;
+        }
+
+        if( xRetVal != ( BaseType_t ) xLength )
+        {
+            break;
+        }
+
+        xIndex += xCount;
+    }
+
+    return ( ( xSent > 0 ) || ( xRetVal >= 0 ) ) ? xSent : xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
+                               int32_t lOptionName,
+                               const void * pvOptionValue,
+                               size_t xOptionLength )
+{
+    BaseType_t xRetVal = SOCKETS_ERROR_NONE;
+    int lRet = 0;
+    int lValue = 0;
+
+    if( ( lOptionName != SOCKETS_SO_RCVTIMEO ) &&
+        ( lOptionName != SOCKETS_SO_SNDTIMEO ) &&
+        ( lOptionName != SOCKETS_SO_WINDOW ) )
+    {
+        if( xOptionLength != sizeof( uint32_t ) )
+        {
+            xRetVal = SOCKETS_EINVAL;
+        }
+        else
+        {
+            lValue = ( int ) *( ( const uint32_t * ) pvOptionValue );
+        }
+    }
+
+    if( xRetVal == SOCKETS_ERROR_NONE )
+    {
+        switch( lOptionName )
+        {
+            case SOCKETS_SO_RCVTIMEO:
+            case SOCKETS_SO_SNDTIMEO:
+               {
+                   TickType_t xTicks;
+                   struct timeval xTV;
+
+                   xTicks = *( ( const TickType_t * ) pvOptionValue );
+
+                   /* A zero timeval blocks forever, as a timeout of 0 ticks
+                    * does for the other wrappers. */
+                   xTV.tv_sec = TICK_TO_S( xTicks );
+                   xTV.tv_usec = TICK_TO_US( xTicks % configTICK_RATE_HZ );
+
+                   lRet = setsockopt( HANDLE_TO_FD( xSocket ),
+                                      SOL_SOCKET,
+                                      lOptionName == SOCKETS_SO_RCVTIMEO ?
+                                      SO_RCVTIMEO : SO_SNDTIMEO,
+                                      &xTV,
+                                      sizeof( xTV ) );
+               }
+               break;
+
+            case SOCKETS_SO_NODELAY:
+                lRet = setsockopt( HANDLE_TO_FD( xSocket ), IPPROTO_TCP, TCP_NODELAY,
+                                   &lValue, sizeof( lValue ) );
+                break;
+
+            case SOCKETS_SO_KEEPALIVE:
+                lRet = setsockopt( HANDLE_TO_FD( xSocket ), SOL_SOCKET, SO_KEEPALIVE,
+                                   &lValue, sizeof( lValue ) );
+                break;
+
+                #if defined( TCP_KEEPIDLE ) && defined( TCP_KEEPINTVL ) && defined( TCP_KEEPCNT )
+                    case SOCKETS_SO_KEEPIDLE:
+                        lRet = setsockopt( HANDLE_TO_FD( xSocket ), IPPROTO_TCP, TCP_KEEPIDLE,
+                                           &lValue, sizeof( lValue ) );
+                        break;
+
+                    case SOCKETS_SO_KEEPINTVL:
+                        lRet = setsockopt( HANDLE_TO_FD( xSocket ), IPPROTO_TCP, TCP_KEEPINTVL,
+                                           &lValue, sizeof( lValue ) );
+                        break;
+
+                    case SOCKETS_SO_KEEPCNT:
+                        lRet = setsockopt( HANDLE_TO_FD( xSocket ), IPPROTO_TCP, TCP_KEEPCNT,
+                                           &lValue, sizeof( lValue ) );
+                        break;
+                #endif /* defined( TCP_KEEPIDLE ) && defined( TCP_KEEPINTVL ) && defined( TCP_KEEPCNT ) */
+
+            case SOCKETS_SO_SNDBUF:
+                lRet = setsockopt( HANDLE_TO_FD( xSocket ), SOL_SOCKET, SO_SNDBUF,
+                                   &lValue, sizeof( lValue ) );
+                break;
+
+            case SOCKETS_SO_RCVBUF:
+                lRet = setsockopt( HANDLE_TO_FD( xSocket ), SOL_SOCKET, SO_RCVBUF,
+                                   &lValue, sizeof( lValue ) );
+                break;
+
+            case SOCKETS_SO_WINDOW:
+
+                if( xOptionLength != sizeof( SocketsWindow_t ) )
+                {
+                    xRetVal = SOCKETS_EINVAL;
+                }
+                else
+                {
+                    const SocketsWindow_t * pxWindow = ( const SocketsWindow_t * ) pvOptionValue;
+                    int lSendBuffer = ( int ) pxWindow->ulSendBufferSize;
+                    int lReceiveBuffer = ( int ) pxWindow->ulReceiveBufferSize;
+
+                    /* The host stack derives the windows from the buffers. */
+                    lRet = setsockopt( HANDLE_TO_FD( xSocket ), SOL_SOCKET, SO_SNDBUF,
+                                       &lSendBuffer, sizeof( lSendBuffer ) );
+
+                    if( lRet == 0 )
+                    {
+                        lRet = setsockopt( HANDLE_TO_FD( xSocket ), SOL_SOCKET, SO_RCVBUF,
+                                           &lReceiveBuffer, sizeof( lReceiveBuffer ) );
+                    }
+                }
+
+                break;
+
+            case SOCKETS_SO_RCVLOWAT:
+                lRet = setsockopt( HANDLE_TO_FD( xSocket ), SOL_SOCKET, SO_RCVLOWAT,
+                                   &lValue, sizeof( lValue ) );
+                break;
+
+            default:
+                xRetVal = SOCKETS_ENOPROTOOPT;
+                break;
+        }
+    }
+
+    if( ( xRetVal == SOCKETS_ERROR_NONE ) && ( lRet != 0 ) )
+    {
+        xRetVal = ( errno == ENOPROTOOPT ) ? SOCKETS_ENOPROTOOPT : SOCKETS_EINVAL;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
@@ -5,6 +5,194 @@
 
 #include "sockets_wrapper.h"
 
+/**
+ * @brief Number of TLS sessions kept for resumption, one per host/port pair.
+ *
+ * On reconnect the cached session is offered to the server, so the handshake
+ * can skip the certificate exchange and key agreement. Set to 0 to disable.
+ */
+#ifndef TLS_TRANSPORT_SESSION_CACHE_ENTRIES
+    #define TLS_TRANSPORT_SESSION_CACHE_ENTRIES    ( 2 )
+#endif
+
+/**
+ * @brief Set to 1 to persist cached TLS sessions across reboots.
+ *
+ * When enabled the application must implement #xApplicationTlsSessionSave
+ * and #xApplicationTlsSessionLoad.
+ */
+#ifndef TLS_TRANSPORT_SESSION_CACHE_PERSIST
+    #define TLS_TRANSPORT_SESSION_CACHE_PERSIST    ( 0 )
+#endif
+
+/**
+ * @brief Largest serialized TLS session handed to the persistence hooks.
+ *
+ * The serialized session includes the server certificate, so this must hold
+ * the leaf certificate plus the session ticket.
+ */
+#ifndef TLS_TRANSPORT_SESSION_CACHE_PERSIST_MAX_SIZE
+    #define TLS_TRANSPORT_SESSION_CACHE_PERSIST_MAX_SIZE    ( 4096 )
+#endif
+
+/**
+ * @brief Number of parsed credential sets, each with the mbed TLS
+ * configuration built from it, kept for reuse by later connections.
+ *
+ * Connections using the same root CA, client certificate, private key,
+ * profile, TLS version and ALPN list share one parsed copy and one
+ * configuration. Must be at least 1.
+ */
+#ifndef TLS_TRANSPORT_CREDENTIAL_STORE_ENTRIES
+    #define TLS_TRANSPORT_CREDENTIAL_STORE_ENTRIES    ( 2 )
+#endif
+
+/**
+ * @brief Number of connection contexts kept in static memory.
+ *
+ * With 0 the context of each connection is allocated from the FreeRTOS heap.
+ * Otherwise at most this many connections can be open at once, and opening
+ * one does not allocate its context.
+ */
+#ifndef TLS_TRANSPORT_CONTEXT_POOL_ENTRIES
+    #define TLS_TRANSPORT_CONTEXT_POOL_ENTRIES    ( 0 )
+#endif
+
+/**
+ * @brief Time after which the shared CTR DRBG is reseeded from the entropy
+ * source, in addition to the request based reseed done by mbed TLS.
+ */
+#ifndef TLS_TRANSPORT_DRBG_RESEED_INTERVAL_MS
+    #define TLS_TRANSPORT_DRBG_RESEED_INTERVAL_MS    ( 30U * 60U * 1000U )
+#endif
+
+/**
+ * @brief Size of the per-connection read-ahead buffer, 0 to disable.
+ *
+ * Reads smaller than this decrypt as much application data as fits in the
+ * buffer and later small reads, such as the MQTT fixed header and remaining
+ * length, are served from it by copy.
+ */
+#ifndef TLS_TRANSPORT_READ_AHEAD_SIZE
+    #define TLS_TRANSPORT_READ_AHEAD_SIZE    ( 0 )
+#endif
+
+/**
+ * @brief Largest record the server is asked to send, 512, 1024, 2048 or 4096
+ * bytes, or 0 to not ask.
+ *
+ * With MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH the record buffers shrink to this
+ * size after the handshake if the server accepts the request. Servers that
+ * ignore it can send records of up to 16 KB.
+ */
+#ifndef TLS_TRANSPORT_MAX_FRAGMENT_LENGTH
+    #define TLS_TRANSPORT_MAX_FRAGMENT_LENGTH    ( 4096 )
+#endif
+
+/**
+ * @brief Size of the buffer TLS_Socket_SendV packs small buffers into, so they
+ * share one TLS record. Allocated on first use.
+ */
+#ifndef TLS_TRANSPORT_SEND_BUFFER_SIZE
+    #define TLS_TRANSPORT_SEND_BUFFER_SIZE    ( 1024 )
+#endif
+
+/**
+ * @brief Upper bound on the buffer used by TLS_Socket_SetWriteCoalescing.
+ *
+ * The buffer is sized to the largest record payload of the connection, capped
+ * to this value.
+ */
+#ifndef TLS_TRANSPORT_COALESCE_BUFFER_MAX_SIZE
+    #define TLS_TRANSPORT_COALESCE_BUFFER_MAX_SIZE    ( 4096 )
+#endif
+
+/**
+ * @brief Set to 1 to send small records, such as MQTT control packets, without
+ * waiting for the peer to acknowledge earlier data (SOCKETS_SO_NODELAY).
+ */
+#ifndef TLS_TRANSPORT_TCP_NODELAY
+    #define TLS_TRANSPORT_TCP_NODELAY    ( 1 )
+#endif
+
+/**
+ * @brief Longest time, in ticks, one TLS_Socket_ConnectPoll call waits for
+ * handshake data from the server. Must not be 0, which waits forever.
+ */
+#ifndef TLS_TRANSPORT_CONNECT_POLL_TICKS
+    #define TLS_TRANSPORT_CONNECT_POLL_TICKS    ( 1 )
+#endif
+
+/**
+ * @brief Number of mbed TLS handshake states timed in #TlsConnectMetrics_t.
+ */
+#ifndef TLS_TRANSPORT_HANDSHAKE_STATES
+    #define TLS_TRANSPORT_HANDSHAKE_STATES    ( 32 )
+#endif
+
+/**
+ * @brief Number of buckets in each #TlsConnectHistogram_t histogram.
+ */
+#ifndef TLS_TRANSPORT_HISTOGRAM_BUCKETS
+    #define TLS_TRANSPORT_HISTOGRAM_BUCKETS    ( 10 )
+#endif
+
+/**
+ * @brief Upper bound of the first histogram bucket, in milliseconds. Each
+ * following bucket doubles it, and the last one counts everything above.
+ */
+#ifndef TLS_TRANSPORT_HISTOGRAM_FIRST_BUCKET_MS
+    #define TLS_TRANSPORT_HISTOGRAM_FIRST_BUCKET_MS    ( 16 )
+#endif
+
+/**
+ * @brief Set to 1 to use the constrained TLS profile for connections whose
+ * credentials leave #NetworkCredentials_t.xProfile at its default.
+ */
+#ifndef TLS_TRANSPORT_CONSTRAINED_PROFILE
+    #define TLS_TRANSPORT_CONSTRAINED_PROFILE    ( 0 )
+#endif
+
+/**
+ * @brief Ciphersuites offered by the constrained TLS profile, most preferred
+ * first, as a comma separated list of mbed TLS ciphersuite identifiers.
+ *
+ * The defaults need an ECDSA server certificate. Add
+ * MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256 for servers with an RSA
+ * certificate. TLS 1.3 connections use the TLS 1.3 AES-128 GCM and CCM
+ * ciphersuites instead.
+ */
+#ifndef TLS_TRANSPORT_CONSTRAINED_CIPHERSUITES
+    #define TLS_TRANSPORT_CONSTRAINED_CIPHERSUITES   \
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, \
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CCM
+#endif
+
+/**
+ * @brief Number of servers whose public key is pinned after a successful
+ * handshake, 0 to disable pinning.
+ *
+ * A later handshake with the same host, port and root CA skips the
+ * certificate chain verification if the server presents the pinned key, and
+ * verifies the chain in full if the key changed. The pin outlives the
+ * certificate validity period, so keep it off where expiry must be enforced.
+ * Requires MBEDTLS_SSL_KEEP_PEER_CERTIFICATE.
+ */
+#ifndef TLS_TRANSPORT_CERT_PIN_ENTRIES
+    #define TLS_TRANSPORT_CERT_PIN_ENTRIES    ( 0 )
+#endif
+
+/**
+ * @brief Set to 1 to offer TLS 1.3 to servers when credentials leave
+ * #NetworkCredentials_t.xMaxVersion at its default.
+ *
+ * TLS 1.3 saves a round trip on full handshakes. It needs mbed TLS 3.x built
+ * with MBEDTLS_SSL_PROTO_TLS1_3; on other builds TLS 1.2 is used.
+ */
+#ifndef TLS_TRANSPORT_TLS13
+    #define TLS_TRANSPORT_TLS13    ( 0 )
+#endif
+
 typedef struct NetworkContext   NetworkContext_t;
 
 /* SSL Context Handle */
@@ -16,8 +204,32 @@ typedef struct TlsTransportParams
     SSLContextHandle xSSLContext;
 } TlsTransportParams_t;
 
+/**
+ * @brief TLS parameter sets a connection can be restricted to.
+ */
+typedef enum TlsTransportProfile
+{
+    eTLSTransportProfileBuildDefault = 0, /**< Constrained if #TLS_TRANSPORT_CONSTRAINED_PROFILE is 1; otherwise, standard. */
+    eTLSTransportProfileStandard,         /**< mbed TLS defaults: every enabled ciphersuite, curve and hash. */
+    eTLSTransportProfileConstrained       /**< TLS 1.2 or later, ECDHE on P-256, SHA-256 signatures and the
+                                           *   #TLS_TRANSPORT_CONSTRAINED_CIPHERSUITES ciphersuites. */
+} TlsTransportProfile_t;
+
+/**
+ * @brief Highest TLS version a connection offers.
+ */
+typedef enum TlsTransportVersion
+{
+    eTLSTransportVersionBuildDefault = 0, /**< TLS 1.3 if #TLS_TRANSPORT_TLS13 is 1; otherwise, TLS 1.2. */
+    eTLSTransportVersionTls12,            /**< TLS 1.2. */
+    eTLSTransportVersionTls13             /**< TLS 1.3, falling back to TLS 1.2 if the server or the build lacks it. */
+} TlsTransportVersion_t;
+
 /**
  * @brief Contains the credentials necessary for TLS connection setup.
+ *
+ * Certificates and keys can be PEM, including the terminating `NULL` in the
+ * size, or DER. DER avoids the base64 decoding on first use.
  */
 typedef struct NetworkCredentials
 {
@@ -32,6 +244,19 @@ typedef struct NetworkCredentials
      */
     BaseType_t xDisableSni;
 
+    /**
+     * @brief TLS parameters to offer. The constrained profile keeps the
+     * handshake on cheap elliptic curve operations, but the server must
+     * support them.
+     */
+    TlsTransportProfile_t xProfile;
+
+    /**
+     * @brief Highest TLS version to offer. Lets TLS 1.2 and TLS 1.3 connects
+     * be compared on the same build.
+     */
+    TlsTransportVersion_t xMaxVersion;
+
     const uint8_t * pucRootCa;     /**< @brief String representing a trusted server root certificate. */
     size_t xRootCaSize;            /**< @brief Size associated with #NetworkCredentials.pRootCa. */
     const uint8_t * pucClientCert; /**< @brief String representing the client certificate. */
@@ -51,9 +276,68 @@ typedef enum TlsTransportStatus
     eTLSTransportInvalidCredentials, /**< Provided credentials were invalid. */
     eTLSTransportHandshakeFailed,    /**< Performing TLS handshake with server failed. */
     eTLSTransportInternalError,      /**< A call to a system API resulted in an internal error. */
-    eTLSTransportConnectFailure      /**< Initial connection to the server failed. */
+    eTLSTransportConnectFailure,     /**< Initial connection to the server failed. */
+    eTLSTransportInProgress          /**< Connection setup not finished, call TLS_Socket_ConnectPoll again. */
 } TlsTransportStatus_t;
 
+/**
+ * @brief Receive statistics of a TLS connection.
+ */
+typedef struct TlsTransportRecvStats
+{
+    uint32_t ulRecvCalls;       /**< Number of TLS_Socket_Recv calls. */
+    uint32_t ulBufferedReads;   /**< Calls served from the read-ahead buffer alone. */
+    uint32_t ulTlsReads;        /**< Number of reads from the TLS layer. */
+    uint32_t ulBytesReceived;   /**< Application bytes returned to the caller. */
+} TlsTransportRecvStats_t;
+
+/**
+ * @brief Time spent in each phase of setting up a TLS connection.
+ *
+ * All times are in milliseconds, with the resolution of the RTOS tick.
+ */
+typedef struct TlsConnectMetrics
+{
+    uint32_t ulDnsMs;                                     /**< Host name resolution. */
+    uint32_t ulTcpConnectMs;                              /**< TCP SYN to established. */
+    uint32_t ulHandshakeMs;                               /**< TLS handshake, including waiting for the server. */
+    uint32_t ulCertificateMs;                             /**< Receiving, parsing and verifying the server certificate chain. */
+    uint32_t ulKeyExchangeMs;                             /**< Server and client key exchange. */
+    uint32_t ulTotalMs;                                   /**< TLS_Socket_ConnectStart to connection established. */
+    BaseType_t xResumed;                                  /**< pdTRUE if a cached session was resumed. */
+    BaseType_t xTls13;                                    /**< pdTRUE if TLS 1.3 was negotiated. */
+    uint32_t ulStateMs[ TLS_TRANSPORT_HANDSHAKE_STATES ]; /**< Time spent in each state, indexed by mbed TLS handshake state. */
+} TlsConnectMetrics_t;
+
+/**
+ * @brief Connection setup times of all TLS connections since boot.
+ *
+ * Bucket i of each histogram counts the connections that took less than
+ * #TLS_TRANSPORT_HISTOGRAM_FIRST_BUCKET_MS << i milliseconds in that phase,
+ * and not less than the bound of bucket i - 1.
+ */
+typedef struct TlsConnectHistogram
+{
+    uint32_t ulConnects;                                          /**< Connections established. */
+    uint32_t ulFailures;                                          /**< Connection attempts that failed. */
+    uint32_t ulDnsMs[ TLS_TRANSPORT_HISTOGRAM_BUCKETS ];          /**< Host name resolution. */
+    uint32_t ulTcpConnectMs[ TLS_TRANSPORT_HISTOGRAM_BUCKETS ];   /**< TCP connection establishment. */
+    uint32_t ulHandshakeMs[ TLS_TRANSPORT_HISTOGRAM_BUCKETS ];    /**< TLS handshake. */
+    uint32_t ulTotalMs[ TLS_TRANSPORT_HISTOGRAM_BUCKETS ];        /**< Whole connection setup. */
+} TlsConnectHistogram_t;
+
+/**
+ * @brief Heap used by a TLS connection: the transport context plus what
+ * mbed TLS allocated for it, including parsing its credentials when they
+ * were not in the credential store yet.
+ */
+typedef struct TlsTransportHeapStats
+{
+    size_t xPeakBytes;    /**< Most heap in use at any time, usually during the handshake. */
+    size_t xSteadyBytes;  /**< Heap in use right after the handshake. */
+    size_t xCurrentBytes; /**< Heap in use now. */
+} TlsTransportHeapStats_t;
+
 /**
  * @brief Connect to TLS endpoint
  *
@@ -72,6 +356,92 @@ TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pxNetworkContext,
                                          uint32_t ulReceiveTimeoutMs,
                                          uint32_t ulSendTimeoutMs );
 
+/**
+ * @brief Start connecting to a TLS endpoint without blocking.
+ *
+ * Opens the socket and records the connection parameters. The connection is
+ * then set up by calling TLS_Socket_ConnectPoll until it stops returning
+ * #eTLSTransportInProgress, so a single task can drive several connections
+ * or keep servicing other work in between.
+ *
+ * @p pcHostName and @p pxNetworkCredentials are used by later polls and must
+ * stay valid until the connection is established or has failed.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[in] pcHostName Pointer to NULL terminated hostname.
+ * @param[in] usPort Port to connect to.
+ * @param[in] pxNetworkCredentials Pointer to network credentials.
+ * @param[in] ulReceiveTimeoutMs Receive timeout, also the longest the
+ * handshake waits for the server. The TCP connection is bounded by
+ * SOCKETS_CONNECT_TIMEOUT_TICKS instead.
+ * @param[in] ulSendTimeoutMs Send timeout.
+ * @return A #TlsTransportStatus_t with the result of the operation.
+ */
+TlsTransportStatus_t TLS_Socket_ConnectStart( NetworkContext_t * pxNetworkContext,
+                                              const char * pcHostName,
+                                              uint16_t usPort,
+                                              const NetworkCredentials_t * pxNetworkCredentials,
+                                              uint32_t ulReceiveTimeoutMs,
+                                              uint32_t ulSendTimeoutMs );
+
+/**
+ * @brief Advance a connection started with TLS_Socket_ConnectStart.
+ *
+ * The first poll resolves the host name, which blocks unless the address is
+ * cached, and starts the TCP connection. Later polls wait for the connection,
+ * then run the TLS handshake as far as the data received allows, waiting at
+ * most #TLS_TRANSPORT_CONNECT_POLL_TICKS each. A TCP connection that fails
+ * drops the cached address, so the next attempt resolves the name again.
+ *
+ * On failure all resources are released and the context must not be used
+ * until connected again. A connection still in progress can be abandoned
+ * with TLS_Socket_Disconnect.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @return #eTLSTransportInProgress while the connection is being set up,
+ * #eTLSTransportSuccess once established, or the error that ended it.
+ */
+TlsTransportStatus_t TLS_Socket_ConnectPoll( NetworkContext_t * pxNetworkContext );
+
+/**
+ * @brief Get the setup times of an established TLS connection.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[out] pxMetrics Receives the setup times.
+ * @return A #TlsTransportStatus_t with the result of the operation.
+ */
+TlsTransportStatus_t TLS_Socket_GetConnectMetrics( NetworkContext_t * pxNetworkContext,
+                                                   TlsConnectMetrics_t * pxMetrics );
+
+/**
+ * @brief Get the name of the ciphersuite negotiated for a TLS connection.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @return The ciphersuite name, or NULL if the connection is not established.
+ */
+const char * TLS_Socket_GetCiphersuite( NetworkContext_t * pxNetworkContext );
+
+/**
+ * @brief Get the setup time histograms of all TLS connections since boot.
+ *
+ * @param[out] pxHistogram Receives the histograms.
+ * @return A #TlsTransportStatus_t with the result of the operation.
+ */
+TlsTransportStatus_t TLS_Socket_GetConnectHistogram( TlsConnectHistogram_t * pxHistogram );
+
+/**
+ * @brief Get the heap used by a TLS connection.
+ *
+ * Needs mbedtls_freertos_port.c built with MBEDTLS_FREERTOS_HEAP_STATS set
+ * to 1.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[out] pxStats Receives the heap figures.
+ * @return A #TlsTransportStatus_t with the result of the operation.
+ */
+TlsTransportStatus_t TLS_Socket_GetHeapStats( NetworkContext_t * pxNetworkContext,
+                                              TlsTransportHeapStats_t * pxStats );
+
 /**
  * @brief Disconnect the TLS connection
  *
@@ -91,6 +461,64 @@ int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
                          void * pvBuffer,
                          size_t xBytesToRecv );
 
+/**
+ * @brief Borrow received data in place instead of copying it out.
+ *
+ * Points @p ppucData at decrypted data inside the transport, usually the
+ * record buffer of mbed TLS. At most one TLS record is returned at a time.
+ * The data stays valid until TLS_Socket_RecvRelease, which must be called
+ * before any other receive on the connection. Borrowing again before
+ * releasing returns the same data.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[out] ppucData Receives a pointer to the data.
+ * @return Number of bytes available at @p ppucData, 0 if none arrived
+ * within the receive timeout, or a negative mbed TLS error code.
+ */
+int32_t TLS_Socket_RecvBorrow( NetworkContext_t * pxNetworkContext,
+                               const uint8_t ** ppucData );
+
+/**
+ * @brief Give back data borrowed with TLS_Socket_RecvBorrow.
+ *
+ * Bytes not consumed are returned again by the next receive.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[in] xBytesConsumed Number of bytes from the start of the borrowed
+ * data that were used.
+ * @return A #TlsTransportStatus_t with the result of the operation.
+ */
+TlsTransportStatus_t TLS_Socket_RecvRelease( NetworkContext_t * pxNetworkContext,
+                                             size_t xBytesConsumed );
+
+/**
+ * @brief Get the receive statistics of a TLS connection.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[out] pxStats Receives the statistics.
+ * @return A #TlsTransportStatus_t with the result of the operation.
+ */
+TlsTransportStatus_t TLS_Socket_GetRecvStats( NetworkContext_t * pxNetworkContext,
+                                              TlsTransportRecvStats_t * pxStats );
+
+/**
+ * @brief Wait until a TLS connection has data to receive.
+ *
+ * Data mbed TLS or the transport already holds counts as well as data on
+ * the socket, so an application loop can block here and only call into the
+ * TLS receive path when there is work. Coalesced writes are flushed first,
+ * since the peer cannot answer data it has not received.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[in] xTimeoutTicks Longest time to wait, 0 to only check, or
+ * portMAX_DELAY to wait forever.
+ * @return 1 if there is data to receive, or the connection was closed or
+ * failed, so a receive returns without waiting for the first byte. 0 if
+ * nothing arrived in time, or a negative error code.
+ */
+int32_t TLS_Socket_Poll( NetworkContext_t * pxNetworkContext,
+                         TickType_t xTimeoutTicks );
+
 /**
  * @brief Send data using TLS.
  *
@@ -102,3 +530,93 @@ int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
 int32_t TLS_Socket_Send( NetworkContext_t * pxNetworkContext,
                          const void * pvBuffer,
                          size_t xBytesToSend );
+
+/**
+ * @brief Send data from several buffers using TLS.
+ *
+ * Small buffers are packed together so that, for example, an MQTT header and
+ * its payload go out in one TLS record instead of one record each.
+ *
+ * @param pxNetworkContext Pointer to the Network context.
+ * @param pxIoVec Array of buffers that contain data to be sent.
+ * @param xIoVecCount Number of buffers in pxIoVec.
+ * @return An #int32_t number of bytes successfully sent.
+ */
+int32_t TLS_Socket_SendV( NetworkContext_t * pxNetworkContext,
+                          const SocketsIoVec_t * pxIoVec,
+                          size_t xIoVecCount );
+
+/**
+ * @brief Enable or disable write coalescing on a TLS connection.
+ *
+ * While enabled, TLS_Socket_Send and TLS_Socket_SendV copy small writes into
+ * one buffer, so back-to-back messages share a TLS record. The buffer is
+ * written when full, when a send finds the oldest buffered byte older than
+ * @p ulFlushDelayUs, before every TLS_Socket_Recv and TLS_Socket_Poll, on
+ * TLS_Socket_Flush and on disconnect. The delay is rounded up to whole ticks.
+ *
+ * No timer enforces the delay: it is only checked when the transport is
+ * next called, so the last write before the application goes idle stays
+ * buffered until then. Wait in TLS_Socket_Poll, as the event loop does, or
+ * call TLS_Socket_Flush after the last write.
+ *
+ * Bytes accepted into the buffer are reported as sent.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @param[in] ulFlushDelayUs Time after which a send writes out the buffer,
+ * in microseconds. 0 disables coalescing and flushes the buffer.
+ * @return A #TlsTransportStatus_t with the result of the operation.
+ */
+TlsTransportStatus_t TLS_Socket_SetWriteCoalescing( NetworkContext_t * pxNetworkContext,
+                                                    uint32_t ulFlushDelayUs );
+
+/**
+ * @brief Write any coalesced data to the network.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ * @return #eTLSTransportSuccess once nothing is left buffered; otherwise,
+ * #eTLSTransportInternalError and the remaining data stays buffered.
+ */
+TlsTransportStatus_t TLS_Socket_Flush( NetworkContext_t * pxNetworkContext );
+
+#if ( TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 )
+
+/**
+ * @brief Application hook to persist a serialized TLS session.
+ *
+ * The serialized session contains the session master secret, so it must be
+ * kept in storage that is as well protected as the device credentials. It
+ * starts with a digest of the credentials it was negotiated with, and is only
+ * resumed by connections that use the same credentials.
+ *
+ * Both hooks are called without the transport's mutex held, so they may block
+ * on storage, but connections to different hosts may call them concurrently.
+ *
+ * @param[in] pcHostName `NULL` terminated hostname the session belongs to.
+ * @param[in] usPort Port the session belongs to.
+ * @param[in] pucData Serialized session.
+ * @param[in] xDataLength Length of the serialized session.
+ * @return pdPASS if the session was stored; otherwise, pdFAIL.
+ */
+BaseType_t xApplicationTlsSessionSave( const char * pcHostName,
+                                       uint16_t usPort,
+                                       const uint8_t * pucData,
+                                       size_t xDataLength );
+
+/**
+ * @brief Application hook to load a serialized TLS session.
+ *
+ * @param[in] pcHostName `NULL` terminated hostname the session belongs to.
+ * @param[in] usPort Port the session belongs to.
+ * @param[out] pucBuffer Buffer that receives the serialized session.
+ * @param[in] xBufferLength Length of the buffer.
+ * @param[out] pxDataLength Length of the serialized session written to the buffer.
+ * @return pdPASS if a session was loaded; otherwise, pdFAIL.
+ */
+BaseType_t xApplicationTlsSessionLoad( const char * pcHostName,
+                                       uint16_t usPort,
+                                       uint8_t * pucBuffer,
+                                       size_t xBufferLength,
+                                       size_t * pxDataLength );
+
+#endif /* TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 */
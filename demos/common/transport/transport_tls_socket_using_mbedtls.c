@@ -40,37 +40,205 @@ extern void vLoggingPrintf( const char * pcFormatString,
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
 
 /* TLS transport header. */
 #include "transport_tls_socket.h"
 
 /* FreeRTOS Socket wrapper include. */
 #include "sockets_wrapper.h"
+#include "sockets_dns_cache.h"
 
 /* mbedTLS util includes. */
-#include "mbedtls_error.h"
+#include "mbedtls/version.h"
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/entropy.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/sha256.h"
 #include "mbedtls/ssl.h"
 #include "mbedtls/threading.h"
 #include "mbedtls/x509.h"
+#include "mbedtls_freertos_port.h"
+
+#if ( MBEDTLS_VERSION_MAJOR >= 3 )
+    #include "mbedtls/error.h"
+    #if defined( MBEDTLS_PSA_CRYPTO_C )
+        #include "psa/crypto.h"
+    #endif
+#else
+    #include "mbedtls_error.h"
+#endif
+
+/*-----------------------------------------------------------*/
+
+/* mbed TLS 3.x dropped the _ret suffix of the hash functions, renamed the
+ * error string functions and made the handshake state private. */
+#if ( MBEDTLS_VERSION_MAJOR >= 3 )
+    #define mbedtls_sha256_ret            mbedtls_sha256
+    #define mbedtls_sha256_starts_ret     mbedtls_sha256_starts
+    #define mbedtls_sha256_update_ret     mbedtls_sha256_update
+    #define mbedtls_sha256_finish_ret     mbedtls_sha256_finish
+    #define mbedtls_strerror_highlevel    mbedtls_high_level_strerr
+    #define mbedtls_strerror_lowlevel     mbedtls_low_level_strerr
+
+    #define tlsSSL_STATE( pxContext )                 ( ( pxContext )->MBEDTLS_PRIVATE( state ) )
+    #define tlsSSL_NEGOTIATED_PEER_CERT( pxContext )  ( ( pxContext )->MBEDTLS_PRIVATE( session_negotiate )->MBEDTLS_PRIVATE( peer_cert ) )
+    #define tlsSSL_IN_OFFT( pxContext )               ( ( pxContext )->MBEDTLS_PRIVATE( in_offt ) )
+    #define tlsSSL_IN_MSGLEN( pxContext )             ( ( pxContext )->MBEDTLS_PRIVATE( in_msglen ) )
+    #define tlsSSL_KEEP_CURRENT_MESSAGE( pxContext )  ( ( pxContext )->MBEDTLS_PRIVATE( keep_current_message ) )
+#else
+    #define tlsSSL_STATE( pxContext )                 ( ( pxContext )->state )
+    #define tlsSSL_NEGOTIATED_PEER_CERT( pxContext )  ( ( pxContext )->session_negotiate->peer_cert )
+    #define tlsSSL_IN_OFFT( pxContext )               ( ( pxContext )->in_offt )
+    #define tlsSSL_IN_MSGLEN( pxContext )             ( ( pxContext )->in_msglen )
+    #define tlsSSL_KEEP_CURRENT_MESSAGE( pxContext )  ( ( pxContext )->keep_current_message )
+#endif
+
+/**
+ * @brief Charge the heap mbed TLS allocates from the calling task to a
+ * connection, see #TLS_Socket_GetHeapStats.
+ */
+#if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+    #define tlsHEAP_STATS_ATTACH( pxSslContext )    mbedtls_platform_heap_stats_attach( ( pxSslContext )->lHeapAccount )
+    #define tlsHEAP_STATS_DETACH()                  mbedtls_platform_heap_stats_detach()
+#else
+    #define tlsHEAP_STATS_ATTACH( pxSslContext )
+    #define tlsHEAP_STATS_DETACH()
+#endif
+
+/**
+ * @brief mbed TLS code for #TLS_TRANSPORT_MAX_FRAGMENT_LENGTH.
+ */
+#if ( TLS_TRANSPORT_MAX_FRAGMENT_LENGTH == 512 )
+    #define tlsMAX_FRAG_LEN_CODE    MBEDTLS_SSL_MAX_FRAG_LEN_512
+#elif ( TLS_TRANSPORT_MAX_FRAGMENT_LENGTH == 1024 )
+    #define tlsMAX_FRAG_LEN_CODE    MBEDTLS_SSL_MAX_FRAG_LEN_1024
+#elif ( TLS_TRANSPORT_MAX_FRAGMENT_LENGTH == 2048 )
+    #define tlsMAX_FRAG_LEN_CODE    MBEDTLS_SSL_MAX_FRAG_LEN_2048
+#elif ( TLS_TRANSPORT_MAX_FRAGMENT_LENGTH == 4096 )
+    #define tlsMAX_FRAG_LEN_CODE    MBEDTLS_SSL_MAX_FRAG_LEN_4096
+#elif ( TLS_TRANSPORT_MAX_FRAGMENT_LENGTH != 0 )
+    #error "TLS_TRANSPORT_MAX_FRAGMENT_LENGTH must be 0, 512, 1024, 2048 or 4096."
+#endif
+
+/**
+ * @brief 1 if this build of mbed TLS can negotiate TLS 1.3.
+ */
+#if ( MBEDTLS_VERSION_MAJOR >= 3 ) && defined( MBEDTLS_SSL_PROTO_TLS1_3 )
+    #define tlsTLS13_AVAILABLE    1
+#else
+    #define tlsTLS13_AVAILABLE    0
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Convert a tick count to milliseconds.
+ */
+#define tlsTICKS_TO_MS( xTicks )    ( ( uint32_t ) ( ( ( uint64_t ) ( xTicks ) * 1000U ) / configTICK_RATE_HZ ) )
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Parsed credentials and the mbed TLS configuration built from them,
+ * shared by all connections that use the same root CA, client certificate,
+ * private key and TLS settings. Not modified once built.
+ */
+typedef struct TlsCredentials
+{
+    uint8_t ucDigest[ 32 ];                /**< @brief SHA-256 over the encoded credentials and settings, used as lookup key. */
+    uint32_t ulRefCount;                   /**< @brief Number of connections using these credentials. */
+    BaseType_t xCached;                    /**< @brief pdTRUE if held in the credential store. */
+    BaseType_t xHasClientCert;             /**< @brief pdTRUE if clientCert and privKey are set. */
+    mbedtls_x509_crt rootCa;               /**< @brief Root CA certificate context. */
+    mbedtls_x509_crt clientCert;           /**< @brief Client certificate context. */
+    mbedtls_pk_context privKey;            /**< @brief Client private key context. */
+    mbedtls_x509_crt_profile certProfile;  /**< @brief Certificate security profile. */
+    mbedtls_ssl_config config;             /**< @brief SSL configuration. */
+    #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+        mbedtls_ssl_config pinnedConfig; /**< @brief SSL configuration skipping chain verification, for pinned servers. */
+    #endif
+} TlsCredentials_t;
+
+/**
+ * @brief Connection setup steps driven by TLS_Socket_ConnectPoll.
+ */
+typedef enum TlsConnectStep
+{
+    eTlsConnectTcp = 0,   /**< @brief Resolve the host name and start the TCP connection. */
+    eTlsConnectTcpWait,   /**< @brief Wait for the TCP connection. */
+    eTlsConnectHandshake, /**< @brief Perform the TLS handshake. */
+    eTlsConnectDone       /**< @brief Connection established. */
+} TlsConnectStep_t;
+
+/**
+ * @brief Connection setup state, kept between TLS_Socket_ConnectPoll calls.
+ */
+typedef struct TlsConnectState
+{
+    TlsConnectStep_t xStep;                            /**< @brief Next setup step. */
+    const char * pcHostName;                           /**< @brief Remote host name, borrowed from the caller. */
+    uint16_t usPort;                                   /**< @brief Remote port. */
+    const NetworkCredentials_t * pxNetworkCredentials; /**< @brief TLS setup parameters, borrowed from the caller. */
+    SocketHandle xSocket;                              /**< @brief TCP socket of the connection. */
+    TickType_t xRecvTimeout;                           /**< @brief Receive timeout requested by the caller. */
+    BaseType_t xBlocking;                              /**< @brief pdTRUE if polled by TLS_Socket_Connect, which waits as long as the caller allows. */
+    TickType_t xLastProgress;                          /**< @brief Tick count when handshake data was last received. */
+    TickType_t xStart;                                 /**< @brief Tick count when the connection was started. */
+    TickType_t xTcpStart;                              /**< @brief Tick count when the TCP connection was started. */
+    TickType_t xHandshakeStart;                        /**< @brief Tick count when the handshake was started. */
+    TickType_t xStateStart;                            /**< @brief Tick count when the current handshake state was entered. */
+} TlsConnectState_t;
+
 /**
  * @brief Secured connection context.
  */
 typedef struct MbedSSLContext
 {
-    mbedtls_ssl_config config;               /**< @brief SSL connection configuration. */
     mbedtls_ssl_context context;             /**< @brief SSL connection context */
-    mbedtls_x509_crt_profile certProfile;    /**< @brief Certificate security profile for this connection. */
-    mbedtls_x509_crt rootCa;                 /**< @brief Root CA certificate context. */
-    mbedtls_x509_crt clientCert;             /**< @brief Client certificate context. */
-    mbedtls_pk_context privKey;              /**< @brief Client private key context. */
+    TlsCredentials_t * pxCredentials;        /**< @brief Parsed credentials and configuration, borrowed from the credential store. */
+    TlsConnectState_t xConnect;              /**< @brief Connection setup state. */
+    TlsConnectMetrics_t xConnectMetrics;     /**< @brief Connection setup times. */
+    TlsTransportRecvStats_t xRecvStats;      /**< @brief Receive statistics. */
+    const uint8_t * pucBorrowed;             /**< @brief Data handed out by TLS_Socket_RecvBorrow, NULL if none. */
+    size_t xBorrowedLength;                  /**< @brief Number of bytes at pucBorrowed. */
+    uint8_t * pucSendBuffer;                 /**< @brief Buffer packing small writes into one record, allocated on first use. */
+    size_t xSendBufferSize;                  /**< @brief Size of pucSendBuffer. */
+    size_t xSendBuffered;                    /**< @brief Number of bytes in pucSendBuffer not yet written. */
+    BaseType_t xCoalesce;                    /**< @brief pdTRUE to hold writes back until flushed. */
+    TickType_t xFlushDelay;                  /**< @brief Longest time coalesced writes are held back. */
+    TickType_t xFirstBuffered;               /**< @brief Tick count when the oldest byte in pucSendBuffer was buffered. */
+    #if ( TLS_TRANSPORT_READ_AHEAD_SIZE > 0 )
+        size_t xReadAheadOffset;                                 /**< @brief Offset of the next unread byte in ucReadAhead. */
+        size_t xReadAheadLength;                                 /**< @brief Number of unread bytes in ucReadAhead. */
+        uint8_t ucReadAhead[ TLS_TRANSPORT_READ_AHEAD_SIZE ];    /**< @brief Decrypted application data not yet read. */
+    #endif
+    #if ( tlsTLS13_AVAILABLE == 1 ) && ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+        char * pcTicketHostName; /**< @brief Host to cache TLS 1.3 tickets for, NULL on TLS 1.2 connections. */
+        uint16_t usTicketPort;   /**< @brief Port to cache TLS 1.3 tickets for. */
+    #endif
+    #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+        int32_t lHeapAccount; /**< @brief Heap account mbed TLS allocations are charged to, -1 if none. */
+        size_t xSteadyHeap;   /**< @brief Bytes charged right after the handshake. */
+    #endif
+    #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+        BaseType_t xPinned;          /**< @brief pdTRUE if chain verification is skipped for a server presenting ucPinnedKey. */
+        uint8_t ucPinnedKey[ 32 ];   /**< @brief SHA-256 over the pinned server public key. */
+    #endif
+} MbedSSLContext_t;
+
+/**
+ * @brief mbed TLS state initialized once and shared by all connections.
+ */
+typedef struct TlsRuntime
+{
+    BaseType_t xInitialized;                 /**< @brief pdTRUE once initMbedtls succeeded. */
+    SemaphoreHandle_t xRandomMutex;          /**< @brief Mutex guarding the CTR DRBG and its reseed schedule. */
+    TickType_t xLastReseed;                  /**< @brief Tick count of the last CTR DRBG (re)seed. */
     mbedtls_entropy_context entropyContext;  /**< @brief Entropy context for random number generation. */
     mbedtls_ctr_drbg_context ctrDrgbContext; /**< @brief CTR DRBG context for random number generation. */
-} MbedSSLContext_t;
+} TlsRuntime_t;
 
 /* Each compilation unit must define the NetworkContext struct. */
 struct NetworkContext
@@ -78,6 +246,130 @@ struct NetworkContext
     TlsTransportParams_t * pParams;
 };
 
+/**
+ * @brief The mbed TLS runtime, initialized by the first connection.
+ */
+static TlsRuntime_t xTlsRuntime = { 0 };
+
+/**
+ * @brief Parsed credentials kept for reuse by later connections.
+ */
+static TlsCredentials_t * pxCredentialStore[ TLS_TRANSPORT_CREDENTIAL_STORE_ENTRIES ];
+
+/**
+ * @brief Connection setup times of all connections since boot.
+ */
+static TlsConnectHistogram_t xConnectHistogram = { 0 };
+
+/**
+ * @brief Ciphersuites offered by the constrained profile.
+ */
+static const int lConstrainedCiphersuites[] =
+{
+    #if ( tlsTLS13_AVAILABLE == 1 )
+        MBEDTLS_TLS1_3_AES_128_GCM_SHA256,
+        MBEDTLS_TLS1_3_AES_128_CCM_SHA256,
+    #endif
+    TLS_TRANSPORT_CONSTRAINED_CIPHERSUITES,
+    0
+};
+
+#if ( MBEDTLS_VERSION_MAJOR >= 3 )
+
+/**
+ * @brief Key exchange groups offered by the constrained profile.
+ */
+    static const uint16_t usConstrainedGroups[] = { MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1, MBEDTLS_SSL_IANA_TLS_GROUP_NONE };
+
+/**
+ * @brief Signature algorithms offered by the constrained profile.
+ */
+    static const uint16_t usConstrainedSigAlgs[] = { MBEDTLS_TLS1_3_SIG_ECDSA_SECP256R1_SHA256, MBEDTLS_TLS1_3_SIG_NONE };
+
+#else /* MBEDTLS_VERSION_MAJOR >= 3 */
+
+/**
+ * @brief Key exchange curves offered by the constrained profile.
+ */
+    static const mbedtls_ecp_group_id xConstrainedCurves[] = { MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_NONE };
+
+    #if defined( MBEDTLS_KEY_EXCHANGE__WITH_CERT__ENABLED )
+
+/**
+ * @brief Signature hashes offered by the constrained profile.
+ */
+        static const int lConstrainedSigHashes[] = { MBEDTLS_MD_SHA256, MBEDTLS_MD_NONE };
+    #endif
+
+#endif /* MBEDTLS_VERSION_MAJOR >= 3 */
+
+/**
+ * @brief Mutex guarding the state shared between connections, created on first use.
+ */
+static SemaphoreHandle_t xTransportMutex = NULL;
+
+#if ( TLS_TRANSPORT_CONTEXT_POOL_ENTRIES > 0 )
+
+/**
+ * @brief Connection contexts, used instead of the heap.
+ */
+    static MbedSSLContext_t xContextPool[ TLS_TRANSPORT_CONTEXT_POOL_ENTRIES ];
+
+/**
+ * @brief pdTRUE for each entry of xContextPool that is in use.
+ */
+    static BaseType_t xContextPoolInUse[ TLS_TRANSPORT_CONTEXT_POOL_ENTRIES ];
+#endif
+
+#if ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+
+/**
+ * @brief TLS session saved for resumption with one host/port pair and
+ * credential set.
+ */
+    typedef struct TlsSessionCacheEntry
+    {
+        char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ]; /**< @brief Host the session was negotiated with. */
+        uint16_t usPort;                                   /**< @brief Port the session was negotiated with. */
+        uint8_t ucCredentialsDigest[ 32 ];                 /**< @brief Digest of the credentials the session was negotiated with. */
+        BaseType_t xValid;                                 /**< @brief pdTRUE if xSession can be resumed. */
+        TickType_t xLastUsed;                              /**< @brief Tick count of last use, for eviction. */
+        mbedtls_ssl_session xSession;                      /**< @brief Saved session parameters and ticket. */
+    } TlsSessionCacheEntry_t;
+
+/**
+ * @brief Sessions available for resumption, shared by all connections.
+ */
+    static TlsSessionCacheEntry_t xSessionCache[ TLS_TRANSPORT_SESSION_CACHE_ENTRIES ];
+
+#endif /* TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 */
+
+#if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+
+    #if !defined( MBEDTLS_SSL_KEEP_PEER_CERTIFICATE )
+        #error "TLS_TRANSPORT_CERT_PIN_ENTRIES requires MBEDTLS_SSL_KEEP_PEER_CERTIFICATE."
+    #endif
+
+/**
+ * @brief Server public key pinned after a fully verified handshake.
+ */
+    typedef struct TlsCertPin
+    {
+        char cHostName[ SOCKETS_MAX_HOST_NAME_LENGTH + 1 ]; /**< @brief Host the key was verified for. */
+        uint16_t usPort;                                   /**< @brief Port the key was verified for. */
+        BaseType_t xValid;                                 /**< @brief pdTRUE if the pin can be used. */
+        TickType_t xLastUsed;                              /**< @brief Tick count of last use, for eviction. */
+        uint8_t ucCredentialsDigest[ 32 ];                 /**< @brief Digest of the credentials the chain was verified against. */
+        uint8_t ucKeyDigest[ 32 ];                         /**< @brief SHA-256 over the server SubjectPublicKeyInfo. */
+    } TlsCertPin_t;
+
+/**
+ * @brief Pinned server keys, shared by all connections.
+ */
+    static TlsCertPin_t xCertPins[ TLS_TRANSPORT_CERT_PIN_ENTRIES ];
+
+#endif /* TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 */
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -125,76 +417,229 @@ static void sslContextInit( MbedSSLContext_t * pxSslContext );
 static void sslContextFree( MbedSSLContext_t * pxSslContext );
 
 /**
- * @brief Add X509 certificate to the trusted list of root certificates.
+ * @brief Get storage for the SSL context of a new connection, from the
+ * context pool or the heap.
+ *
+ * @return The SSL context, or NULL if none is available.
+ */
+static MbedSSLContext_t * sslContextAlloc( void );
+
+/**
+ * @brief Give back the storage of an SSL context.
  *
- * OpenSSL does not provide a single function for reading and loading certificates
- * from files into stores, so the file API must be called. Start with the
- * root certificate.
+ * @param[in] pxSslContext SSL context returned by sslContextAlloc.
+ */
+static void sslContextRelease( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Take the mutex guarding state shared between connections, creating
+ * it on first use.
+ *
+ * @return pdTRUE if the mutex was taken; otherwise, pdFALSE.
+ */
+static BaseType_t transportLock( void );
+
+/**
+ * @brief Parse the trusted server root CA.
  *
- * @param[out] pxSslContext SSL context to which the trusted server root CA is to be added.
- * @param[in] pucRootCa PEM-encoded string of the trusted server root CA.
+ * @param[out] pxCredentials Credentials to which the trusted server root CA is to be added.
+ * @param[in] pucRootCa PEM or DER encoded trusted server root CA.
  * @param[in] xRootCaSize Size of the trusted server root CA.
  *
  * @return 0 on success; otherwise, failure;
  */
-static int32_t setRootCa( MbedSSLContext_t * pxSslContext,
+static int32_t setRootCa( TlsCredentials_t * pxCredentials,
                           const uint8_t * pucRootCa,
                           size_t xRootCaSize );
 
 /**
- * @brief Set X509 certificate as client certificate for the server to authenticate.
+ * @brief Parse the client certificate for the server to authenticate.
  *
- * @param[out] pxSslContext SSL context to which the client certificate is to be set.
- * @param[in] pucClientCert PEM-encoded string of the client certificate.
+ * @param[out] pxCredentials Credentials to which the client certificate is to be set.
+ * @param[in] pucClientCert PEM or DER encoded client certificate.
  * @param[in] xClientCertSize Size of the client certificate.
  *
  * @return 0 on success; otherwise, failure;
  */
-static int32_t setClientCertificate( MbedSSLContext_t * pxSslContext,
+static int32_t setClientCertificate( TlsCredentials_t * pxCredentials,
                                      const uint8_t * pucClientCert,
                                      size_t xClientCertSize );
 
 /**
- * @brief Set private key for the client's certificate.
+ * @brief Parse the private key for the client's certificate.
  *
- * @param[out] pxSslContext SSL context to which the private key is to be set.
- * @param[in] pucPrivateKey PEM-encoded string of the client private key.
+ * @param[out] pxCredentials Credentials to which the private key is to be set.
+ * @param[in] pucPrivateKey PEM or DER encoded client private key.
  * @param[in] xPrivateKeySize Size of the client private key.
  *
  * @return 0 on success; otherwise, failure;
  */
-static int32_t setPrivateKey( MbedSSLContext_t * pxSslContext,
+static int32_t setPrivateKey( TlsCredentials_t * pxCredentials,
                               const uint8_t * pucPrivateKey,
                               size_t xPrivateKeySize );
 
 /**
- * @brief Passes TLS credentials to the OpenSSL library.
+ * @brief Hash the encoded credentials and the TLS settings that the
+ * configuration is built from.
+ *
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ * @param[out] pucDigest Receives the SHA-256 digest.
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+static int32_t credentialsDigest( const NetworkCredentials_t * pxNetworkCredentials,
+                                  uint8_t * pucDigest );
+
+/**
+ * @brief Get parsed credentials and configuration from the credential store,
+ * building them on first use.
+ *
+ * Credentials are looked up by content, so the same root CA, client
+ * certificate, private key and TLS settings are parsed and configured once
+ * and then shared by all connections. They are parsed without the transport
+ * lock, so connections that first use the same credentials at the same time
+ * may each parse them, and all but the first stored copy are dropped.
+ *
+ * @param[in] pxNetworkCredentials Encoded TLS credentials.
+ *
+ * @return Parsed credentials with a reference taken, or NULL on failure.
+ */
+static TlsCredentials_t * credentialStoreAcquire( const NetworkCredentials_t * pxNetworkCredentials );
+
+/**
+ * @brief Find credentials in the credential store. Called with the transport
+ * lock taken.
+ *
+ * @param[in] pucDigest Digest of the encoded credentials.
+ * @param[out] pulFreeIndex Receives the index of a free or unused entry, or
+ * #TLS_TRANSPORT_CREDENTIAL_STORE_ENTRIES if there is none.
+ *
+ * @return The stored credentials, or NULL if they are not stored.
+ */
+static TlsCredentials_t * credentialStoreFind( const uint8_t * pucDigest,
+                                               uint32_t * pulFreeIndex );
+
+/**
+ * @brief Parse credentials and build their configuration.
+ *
+ * @param[in] pxNetworkCredentials Encoded TLS credentials.
+ * @param[in] pucDigest Digest of the encoded credentials.
+ *
+ * @return Parsed credentials without a reference, or NULL on failure.
+ */
+static TlsCredentials_t * credentialsParse( const NetworkCredentials_t * pxNetworkCredentials,
+                                            const uint8_t * pucDigest );
+
+/**
+ * @brief Drop a reference taken by #credentialStoreAcquire.
+ *
+ * @param[in] pxCredentials Parsed credentials.
+ */
+static void credentialStoreRelease( TlsCredentials_t * pxCredentials );
+
+/**
+ * @brief Free parsed credentials.
+ *
+ * @param[in] pxCredentials Parsed credentials.
+ */
+static void credentialsFree( TlsCredentials_t * pxCredentials );
+
+/**
+ * @brief Build an SSL configuration for parsed credentials.
+ *
+ * @param[in] pxCredentials Parsed credentials.
+ * @param[out] pxConfig Configuration to build, initialized by the caller.
+ * @param[in] lAuthMode Server certificate verification mode.
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+static int32_t configBuild( TlsCredentials_t * pxCredentials,
+                            mbedtls_ssl_config * pxConfig,
+                            int lAuthMode,
+                            const NetworkCredentials_t * pxNetworkCredentials );
+
+/**
+ * @brief Passes TLS credentials to the mbed TLS library.
  *
  * Provides the root CA certificate, client certificate, and private key to the
- * OpenSSL library. If the client certificate or private key is not NULL, mutual
+ * mbed TLS library. If the client certificate or private key is not NULL, mutual
  * authentication is used when performing the TLS handshake.
  *
- * @param[out] pxSslContext SSL context to which the credentials are to be imported.
- * @param[in] pxNetworkCredentials TLS credentials to be imported.
+ * @param[in] pxCredentials Parsed credentials to be imported.
+ * @param[out] pxConfig SSL configuration to which the credentials are to be imported.
+ * @param[in] lAuthMode Server certificate verification mode.
  *
  * @return 0 on success; otherwise, failure;
  */
-static int32_t setCredentials( MbedSSLContext_t * pxSslContext,
-                               const NetworkCredentials_t * pxNetworkCredentials );
+static int32_t setCredentials( TlsCredentials_t * pxCredentials,
+                               mbedtls_ssl_config * pxConfig,
+                               int lAuthMode );
+
+/**
+ * @brief Get the profile selected in the credentials, resolving the build
+ * default.
+ *
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ *
+ * @return The profile to use.
+ */
+static TlsTransportProfile_t credentialsProfile( const NetworkCredentials_t * pxNetworkCredentials );
+
+/**
+ * @brief Get the highest TLS version selected in the credentials, resolving
+ * the build default.
+ *
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ *
+ * @return The highest TLS version to offer.
+ */
+static TlsTransportVersion_t credentialsMaxVersion( const NetworkCredentials_t * pxNetworkCredentials );
+
+/**
+ * @brief Restrict the TLS parameters to the profile selected in the credentials.
+ *
+ * @param[in] pxCredentials Parsed credentials, whose certificate profile is set.
+ * @param[out] pxConfig SSL configuration to restrict.
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ */
+static void setProfile( TlsCredentials_t * pxCredentials,
+                        mbedtls_ssl_config * pxConfig,
+                        const NetworkCredentials_t * pxNetworkCredentials );
+
+/**
+ * @brief Limit the TLS version to the one selected in the credentials.
+ *
+ * @param[out] pxConfig SSL configuration to limit.
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ */
+static void setVersion( mbedtls_ssl_config * pxConfig,
+                        const NetworkCredentials_t * pxNetworkCredentials );
 
 /**
  * @brief Set optional configurations for the TLS connection.
  *
- * This function is used to set SNI and ALPN protocols.
+ * This function is used to set ALPN protocols, the maximum fragment length
+ * and session tickets.
  *
- * @param[in] pxSslContext SSL context to which the optional configurations are to be set.
- * @param[in] pcHostName Remote host name, used for server name indication.
+ * @param[out] pxConfig SSL configuration to which the optional configurations are to be set.
  * @param[in] pxNetworkCredentials TLS setup parameters.
  */
-static void setOptionalConfigurations( MbedSSLContext_t * pxSslContext,
-                                       const char * pcHostName,
+static void setOptionalConfigurations( mbedtls_ssl_config * pxConfig,
                                        const NetworkCredentials_t * pxNetworkCredentials );
 
+/**
+ * @brief Set the server name for a connection, used for server name
+ * indication and to verify the server certificate.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] pcHostName Remote host name.
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ */
+static void setServerName( MbedSSLContext_t * pxSslContext,
+                           const char * pcHostName,
+                           const NetworkCredentials_t * pxNetworkCredentials );
+
 /**
  * @brief Setup TLS by initializing contexts and setting configurations.
  *
@@ -210,97 +655,478 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
                                       const NetworkCredentials_t * pxNetworkCredentials );
 
 /**
- * @brief Perform the TLS handshake on a TCP connection.
+ * @brief Prepare the TLS handshake on a TCP connection.
+ *
+ * A session cached for the same host and port is offered to the server so
+ * the handshake can be abbreviated.
  *
  * @param[in] pxNetworkContext Network context.
- * @param[in] pxNetworkCredentials TLS setup parameters.
+ * @param[in] pcHostName Remote host name, used as session cache key.
+ * @param[in] usPort Remote port, used as session cache key.
  *
- * @return #eTLSTransportSuccess, #eTLSTransportHandshakeFailed, or #eTLSTransportInternalError.
+ * @return #eTLSTransportSuccess, or #eTLSTransportInternalError.
  */
-static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext,
-                                          const NetworkCredentials_t * pxNetworkCredentials );
+static TlsTransportStatus_t tlsHandshakeStart( NetworkContext_t * pxNetworkContext,
+                                               const char * pcHostName,
+                                               uint16_t usPort );
 
 /**
- * @brief Initialize mbedTLS.
+ * @brief Advance the TLS handshake as far as the data received allows.
  *
- * @param[out] entropyContext mbed TLS entropy context for generation of random numbers.
- * @param[out] ctrDrgbContext mbed TLS CTR DRBG context for generation of random numbers.
+ * @param[in] pxNetworkContext Network context.
  *
- * @return #eTLSTransportSuccess, or #eTLSTransportInternalError.
+ * @return #eTLSTransportSuccess once the handshake completed,
+ * #eTLSTransportInProgress while waiting for the server, or
+ * #eTLSTransportHandshakeFailed.
  */
-static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pxEntropyContext,
-                                         mbedtls_ctr_drbg_context * pxCtrDrgbContext );
-
-/*-----------------------------------------------------------*/
+static TlsTransportStatus_t tlsHandshakeStep( NetworkContext_t * pxNetworkContext );
 
-static void sslContextInit( MbedSSLContext_t * pxSslContext )
-{
-    configASSERT( pxSslContext != NULL );
+/**
+ * @brief Send callback used during the handshake.
+ *
+ * @param[in] pvContext The #MbedSSLContext_t of the connection.
+ * @param[in] pucBuffer Data to send.
+ * @param[in] xLength Length of the data.
+ *
+ * @return Number of bytes sent, or a negative error code.
+ */
+static int sslConnectSend( void * pvContext,
+                           const unsigned char * pucBuffer,
+                           size_t xLength );
 
-    mbedtls_ssl_config_init( &( pxSslContext->config ) );
-    mbedtls_x509_crt_init( &( pxSslContext->rootCa ) );
-    mbedtls_pk_init( &( pxSslContext->privKey ) );
-    mbedtls_x509_crt_init( &( pxSslContext->clientCert ) );
-    mbedtls_ssl_init( &( pxSslContext->context ) );
-}
-/*-----------------------------------------------------------*/
+/**
+ * @brief Receive callback used during the handshake.
+ *
+ * The socket receive timeout is short while connecting, and a timeout is
+ * reported as MBEDTLS_ERR_SSL_WANT_READ so the handshake can be resumed by
+ * the next TLS_Socket_ConnectPoll call.
+ *
+ * @param[in] pvContext The #MbedSSLContext_t of the connection.
+ * @param[out] pucBuffer Buffer to receive data into.
+ * @param[in] xLength Length of the buffer.
+ *
+ * @return Number of bytes received, MBEDTLS_ERR_SSL_WANT_READ, or a negative
+ * error code.
+ */
+static int sslConnectRecv( void * pvContext,
+                           unsigned char * pucBuffer,
+                           size_t xLength );
 
-static void sslContextFree( MbedSSLContext_t * pxSslContext )
-{
-    configASSERT( pxSslContext != NULL );
+/**
+ * @brief Add the setup times of a connection attempt to the histograms.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] xConnected pdTRUE if the connection was established.
+ */
+static void connectMetricsRecord( MbedSSLContext_t * pxSslContext,
+                                  BaseType_t xConnected );
 
-    mbedtls_ssl_free( &( pxSslContext->context ) );
-    mbedtls_x509_crt_free( &( pxSslContext->rootCa ) );
-    mbedtls_x509_crt_free( &( pxSslContext->clientCert ) );
-    mbedtls_pk_free( &( pxSslContext->privKey ) );
-    mbedtls_entropy_free( &( pxSslContext->entropyContext ) );
-    mbedtls_ctr_drbg_free( &( pxSslContext->ctrDrgbContext ) );
-    mbedtls_ssl_config_free( &( pxSslContext->config ) );
-}
-/*-----------------------------------------------------------*/
+/**
+ * @brief Count a duration in the histogram bucket it falls in.
+ *
+ * @param[in,out] pulBuckets Histogram of #TLS_TRANSPORT_HISTOGRAM_BUCKETS buckets.
+ * @param[in] ulMs Duration in milliseconds.
+ */
+static void histogramAdd( uint32_t * pulBuckets,
+                          uint32_t ulMs );
 
-static int32_t setRootCa( MbedSSLContext_t * pxSslContext,
-                          const uint8_t * pucRootCa,
-                          size_t xRootCaSize )
-{
-    int32_t lMbedtlsError = -1;
+/**
+ * @brief Time spent in one handshake state.
+ *
+ * @param[in] pxMetrics Metrics of the connection.
+ * @param[in] lState mbed TLS handshake state.
+ *
+ * @return Time in milliseconds, or 0 for a state beyond
+ * #TLS_TRANSPORT_HANDSHAKE_STATES, which is not timed.
+ */
+static uint32_t handshakeStateMs( const TlsConnectMetrics_t * pxMetrics,
+                                  int32_t lState );
 
-    configASSERT( pxSslContext != NULL );
-    configASSERT( pucRootCa != NULL );
+/**
+ * @brief Release everything held by a connection that failed to set up.
+ *
+ * @param[in] pxNetworkContext Network context.
+ */
+static void connectAbort( NetworkContext_t * pxNetworkContext );
 
-    /* Parse the server root CA certificate into the SSL context. */
-    lMbedtlsError = mbedtls_x509_crt_parse( &( pxSslContext->rootCa ),
-                                            pucRootCa,
-                                            xRootCaSize );
+/**
+ * @brief Set up TLS and start the handshake once the TCP connection is
+ * established.
+ *
+ * @param[in] pxNetworkContext Network context.
+ *
+ * @return #eTLSTransportInProgress, or an error code.
+ */
+static TlsTransportStatus_t connectTcpEstablished( NetworkContext_t * pxNetworkContext );
 
-    if( lMbedtlsError != 0 )
-    {
-        LogError( ( "Failed to parse server root CA certificate: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-    }
-    else
-    {
-        mbedtls_ssl_conf_ca_chain( &( pxSslContext->config ),
-                                   &( pxSslContext->rootCa ),
-                                   NULL );
-    }
+#if ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
 
-    return lMbedtlsError;
-}
-/*-----------------------------------------------------------*/
+/**
+ * @brief Find the session cache entry for a host and port.
+ *
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ * @param[in] pucCredentialsDigest Digest of the credentials of the connection,
+ * so a session is never resumed with another client identity or settings.
+ * @param[in] xAllocate If pdTRUE, return the least recently used entry when no entry matches.
+ *
+ * @return The matching entry, a reclaimed entry or NULL. Must be called with the mutex held.
+ */
+    static TlsSessionCacheEntry_t * sessionCacheFind( const char * pcHostName,
+                                                      uint16_t usPort,
+                                                      const uint8_t * pucCredentialsDigest,
+                                                      BaseType_t xAllocate );
 
-static int32_t setClientCertificate( MbedSSLContext_t * pxSslContext,
-                                     const uint8_t * pucClientCert,
-                                     size_t xClientCertSize )
-{
-    int32_t lMbedtlsError = -1;
+/**
+ * @brief Offer a cached session for resumption on a new SSL context.
+ *
+ * @param[in] pxSslContext SSL context that is about to start the handshake.
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ *
+ * @return pdTRUE if a session was offered; otherwise, pdFALSE.
+ */
+    static BaseType_t sessionCacheRestore( MbedSSLContext_t * pxSslContext,
+                                           const char * pcHostName,
+                                           uint16_t usPort );
 
+/**
+ * @brief Save the session of a completed handshake.
+ *
+ * @param[in] pxSslContext SSL context that completed the handshake.
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ */
+    static void sessionCacheStore( MbedSSLContext_t * pxSslContext,
+                                   const char * pcHostName,
+                                   uint16_t usPort );
+
+/**
+ * @brief Drop the cached session for a host and port.
+ *
+ * @param[in] pxSslContext SSL context whose handshake failed.
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ */
+    static void sessionCacheInvalidate( MbedSSLContext_t * pxSslContext,
+                                        const char * pcHostName,
+                                        uint16_t usPort );
+
+#endif /* TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 */
+
+#if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+
+/**
+ * @brief Find the pinned key for a host and port.
+ *
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ * @param[in] xAllocate If pdTRUE, return the least recently used entry when no entry matches.
+ *
+ * @return The matching entry, a reclaimed entry or NULL. Must be called with the mutex held.
+ */
+    static TlsCertPin_t * certPinFind( const char * pcHostName,
+                                       uint16_t usPort,
+                                       BaseType_t xAllocate );
+
+/**
+ * @brief Hash the public key of a certificate.
+ *
+ * @param[in] pxCertificate Certificate to hash the SubjectPublicKeyInfo of.
+ * @param[out] pucDigest SHA-256 digest, 32 bytes.
+ *
+ * @return 0 on success; otherwise, a negative mbed TLS error code.
+ */
+    static int32_t certPinHash( const mbedtls_x509_crt * pxCertificate,
+                                uint8_t * pucDigest );
+
+/**
+ * @brief Check whether the server of a new SSL context has a pinned key, in
+ * which case the handshake uses the configuration that skips chain
+ * verification.
+ *
+ * @param[in] pxSslContext SSL context that is about to start the handshake.
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ */
+    static void certPinLookup( MbedSSLContext_t * pxSslContext,
+                               const char * pcHostName,
+                               uint16_t usPort );
+
+/**
+ * @brief Check the server certificate against the pinned key, verifying the
+ * chain in full if the key changed.
+ *
+ * @param[in] pxSslContext SSL context that has just received the server certificate.
+ *
+ * @return 0 if the certificate is trusted; otherwise, a negative mbed TLS error code.
+ */
+    static int32_t certPinCheck( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Pin the key of the server of a completed handshake.
+ *
+ * @param[in] pxSslContext SSL context that completed the handshake.
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ */
+    static void certPinStore( MbedSSLContext_t * pxSslContext,
+                              const char * pcHostName,
+                              uint16_t usPort );
+
+/**
+ * @brief Drop the pinned key for a host and port.
+ *
+ * @param[in] pcHostName Remote host name.
+ * @param[in] usPort Remote port.
+ */
+    static void certPinInvalidate( const char * pcHostName,
+                                   uint16_t usPort );
+
+#endif /* TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 */
+
+/**
+ * @brief Read application data from the TLS layer.
+ *
+ * @param[in] pxSslContext SSL context to read from.
+ * @param[out] pucBuffer Buffer used for receiving data.
+ * @param[in] xBytesToRecv Size of the buffer.
+ *
+ * @return Number of bytes read, 0 if the read can be retried, or a negative
+ * mbed TLS error code.
+ */
+static int32_t sslRead( MbedSSLContext_t * pxSslContext,
+                        uint8_t * pucBuffer,
+                        size_t xBytesToRecv );
+
+/**
+ * @brief Write application data to the TLS layer.
+ *
+ * @param[in] pxSslContext SSL context to write to.
+ * @param[in] pucBuffer Buffer that contains data to be sent.
+ * @param[in] xBytesToSend Length of the data to be sent.
+ *
+ * @return Number of bytes written, 0 if the write can be retried, or a
+ * negative mbed TLS error code.
+ */
+static int32_t sslWrite( MbedSSLContext_t * pxSslContext,
+                         const uint8_t * pucBuffer,
+                         size_t xBytesToSend );
+
+/**
+ * @brief Write all application data to the TLS layer, in as many records as
+ * needed.
+ *
+ * @param[in] pxSslContext SSL context to write to.
+ * @param[in] pucBuffer Buffer that contains data to be sent.
+ * @param[in] xBytesToSend Length of the data to be sent.
+ *
+ * @return Number of bytes written, less than xBytesToSend on timeout, or a
+ * negative mbed TLS error code if nothing was written.
+ */
+static int32_t sslWriteAll( MbedSSLContext_t * pxSslContext,
+                            const uint8_t * pucBuffer,
+                            size_t xBytesToSend );
+
+/**
+ * @brief Write the data held in the send buffer to the TLS layer.
+ *
+ * Data that could not be written before a timeout stays buffered.
+ *
+ * @param[in] pxSslContext SSL context to write to.
+ *
+ * @return Number of bytes written, or a negative mbed TLS error code.
+ */
+static int32_t sendBufferFlush( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Write data through the send buffer, packing small buffers into
+ * as few records as possible.
+ *
+ * Without write coalescing the buffer only packs the buffers of one call:
+ * data left by earlier calls is written first, and bytes of this call that
+ * were not written by the time it returns are dropped from the buffer and
+ * not counted, so the caller sends them again.
+ *
+ * @param[in] pxSslContext SSL context to write to.
+ * @param[in] pxIoVec Array of buffers that contain data to be sent.
+ * @param[in] xIoVecCount Number of buffers in pxIoVec.
+ *
+ * @return Number of bytes accepted, or a negative mbed TLS error code if no
+ * byte was.
+ */
+static int32_t bufferedSend( MbedSSLContext_t * pxSslContext,
+                             const SocketsIoVec_t * pxIoVec,
+                             size_t xIoVecCount );
+
+/**
+ * @brief Initialize mbedTLS, once for all connections.
+ *
+ * Installs the thread safety functions and seeds the shared CTR DRBG.
+ *
+ * @return #eTLSTransportSuccess, or #eTLSTransportInternalError.
+ */
+static TlsTransportStatus_t initMbedtls( void );
+
+/**
+ * @brief Random number callback for mbed TLS, backed by the shared CTR DRBG.
+ *
+ * Reseeds the CTR DRBG first when #TLS_TRANSPORT_DRBG_RESEED_INTERVAL_MS has
+ * passed since the last seed.
+ *
+ * @param[in] pvContext The #TlsRuntime_t.
+ * @param[out] pucOutput Buffer that receives the random bytes.
+ * @param[in] xOutputLength Number of random bytes requested.
+ *
+ * @return 0 on success; otherwise, an mbed TLS error code.
+ */
+static int runtimeRandom( void * pvContext,
+                          unsigned char * pucOutput,
+                          size_t xOutputLength );
+
+/*-----------------------------------------------------------*/
+
+static void sslContextInit( MbedSSLContext_t * pxSslContext )
+{
+    configASSERT( pxSslContext != NULL );
+
+    pxSslContext->pxCredentials = NULL;
+    pxSslContext->pucSendBuffer = NULL;
+    pxSslContext->xSendBufferSize = 0;
+    pxSslContext->xSendBuffered = 0;
+    pxSslContext->xCoalesce = pdFALSE;
+    mbedtls_ssl_init( &( pxSslContext->context ) );
+}
+/*-----------------------------------------------------------*/
+
+static void sslContextFree( MbedSSLContext_t * pxSslContext )
+{
+    configASSERT( pxSslContext != NULL );
+
+    mbedtls_ssl_free( &( pxSslContext->context ) );
+
+    #if ( tlsTLS13_AVAILABLE == 1 ) && ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+        if( pxSslContext->pcTicketHostName != NULL )
+        {
+            vPortFree( pxSslContext->pcTicketHostName );
+            pxSslContext->pcTicketHostName = NULL;
+        }
+    #endif
+
+    if( pxSslContext->pxCredentials != NULL )
+    {
+        credentialStoreRelease( pxSslContext->pxCredentials );
+        pxSslContext->pxCredentials = NULL;
+    }
+
+    if( pxSslContext->pucSendBuffer != NULL )
+    {
+        vPortFree( pxSslContext->pucSendBuffer );
+        pxSslContext->pucSendBuffer = NULL;
+        pxSslContext->xSendBufferSize = 0;
+        pxSslContext->xSendBuffered = 0;
+    }
+
+    #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+        mbedtls_platform_heap_stats_close( pxSslContext->lHeapAccount );
+        pxSslContext->lHeapAccount = -1;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static MbedSSLContext_t * sslContextAlloc( void )
+{
+    MbedSSLContext_t * pxSslContext = NULL;
+
+    #if ( TLS_TRANSPORT_CONTEXT_POOL_ENTRIES > 0 )
+        uint32_t ulIndex;
+
+        if( transportLock() == pdTRUE )
+        {
+            for( ulIndex = 0; ulIndex < TLS_TRANSPORT_CONTEXT_POOL_ENTRIES; ulIndex++ )
+            {
+                if( xContextPoolInUse[ ulIndex ] == pdFALSE )
+                {
+                    xContextPoolInUse[ ulIndex ] = pdTRUE;
+                    pxSslContext = &( xContextPool[ ulIndex ] );
+                    break;
+                }
+            }
+
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+
+        if( pxSslContext == NULL )
+        {
+            LogError( ( "All %d TLS connection contexts are in use.",
+                        TLS_TRANSPORT_CONTEXT_POOL_ENTRIES ) );
+        }
+    #else /* if ( TLS_TRANSPORT_CONTEXT_POOL_ENTRIES > 0 ) */
+        pxSslContext = pvPortMalloc( sizeof( MbedSSLContext_t ) );
+    #endif /* if ( TLS_TRANSPORT_CONTEXT_POOL_ENTRIES > 0 ) */
+
+    return pxSslContext;
+}
+/*-----------------------------------------------------------*/
+
+static void sslContextRelease( MbedSSLContext_t * pxSslContext )
+{
     configASSERT( pxSslContext != NULL );
+
+    #if ( TLS_TRANSPORT_CONTEXT_POOL_ENTRIES > 0 )
+        configASSERT( ( pxSslContext >= &( xContextPool[ 0 ] ) ) &&
+                      ( pxSslContext < &( xContextPool[ TLS_TRANSPORT_CONTEXT_POOL_ENTRIES ] ) ) );
+
+        /* The mutex was created by sslContextAlloc, so this only fails if
+         * the scheduler state is broken. */
+        if( transportLock() == pdTRUE )
+        {
+            xContextPoolInUse[ pxSslContext - xContextPool ] = pdFALSE;
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+    #else
+        vPortFree( pxSslContext );
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static int32_t setRootCa( TlsCredentials_t * pxCredentials,
+                          const uint8_t * pucRootCa,
+                          size_t xRootCaSize )
+{
+    int32_t lMbedtlsError = -1;
+
+    configASSERT( pxCredentials != NULL );
+    configASSERT( pucRootCa != NULL );
+
+    /* Parse the server root CA certificate. DER input skips the base64
+     * decoding that PEM input needs. */
+    lMbedtlsError = mbedtls_x509_crt_parse( &( pxCredentials->rootCa ),
+                                            pucRootCa,
+                                            xRootCaSize );
+
+    if( lMbedtlsError != 0 )
+    {
+        LogError( ( "Failed to parse server root CA certificate: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t setClientCertificate( TlsCredentials_t * pxCredentials,
+                                     const uint8_t * pucClientCert,
+                                     size_t xClientCertSize )
+{
+    int32_t lMbedtlsError = -1;
+
+    configASSERT( pxCredentials != NULL );
     configASSERT( pucClientCert != NULL );
 
     /* Setup the client certificate. */
-    lMbedtlsError = mbedtls_x509_crt_parse( &( pxSslContext->clientCert ),
+    lMbedtlsError = mbedtls_x509_crt_parse( &( pxCredentials->clientCert ),
                                             pucClientCert,
                                             xClientCertSize );
 
@@ -311,590 +1137,2794 @@ static int32_t setClientCertificate( MbedSSLContext_t * pxSslContext,
                     mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
     }
 
-    return lMbedtlsError;
-}
-/*-----------------------------------------------------------*/
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t setPrivateKey( TlsCredentials_t * pxCredentials,
+                              const uint8_t * pucPrivateKey,
+                              size_t xPrivateKeySize )
+{
+    int32_t lMbedtlsError = -1;
+
+    configASSERT( pxCredentials != NULL );
+    configASSERT( pucPrivateKey != NULL );
+
+    /* Setup the client private key. */
+    #if ( MBEDTLS_VERSION_MAJOR >= 3 )
+        lMbedtlsError = mbedtls_pk_parse_key( &( pxCredentials->privKey ),
+                                              pucPrivateKey,
+                                              xPrivateKeySize,
+                                              NULL,
+                                              0,
+                                              runtimeRandom,
+                                              &xTlsRuntime );
+    #else
+        lMbedtlsError = mbedtls_pk_parse_key( &( pxCredentials->privKey ),
+                                              pucPrivateKey,
+                                              xPrivateKeySize,
+                                              NULL,
+                                              0 );
+    #endif
+
+    if( lMbedtlsError != 0 )
+    {
+        LogError( ( "Failed to parse the client key: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t transportLock( void )
+{
+    BaseType_t xRetVal = pdFALSE;
+
+    if( xTransportMutex == NULL )
+    {
+        /* Keep two connecting tasks from both creating the mutex. */
+        vTaskSuspendAll();
+        {
+            if( xTransportMutex == NULL )
+            {
+                xTransportMutex = xSemaphoreCreateMutex();
+            }
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+    if( xTransportMutex == NULL )
+    {
+        LogError( ( "Failed to create TLS transport mutex." ) );
+    }
+    else
+    {
+        xRetVal = xSemaphoreTake( xTransportMutex, portMAX_DELAY );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static void credentialsFree( TlsCredentials_t * pxCredentials )
+{
+    configASSERT( pxCredentials != NULL );
+
+    mbedtls_ssl_config_free( &( pxCredentials->config ) );
+    #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+        mbedtls_ssl_config_free( &( pxCredentials->pinnedConfig ) );
+    #endif
+    mbedtls_x509_crt_free( &( pxCredentials->rootCa ) );
+    mbedtls_x509_crt_free( &( pxCredentials->clientCert ) );
+    mbedtls_pk_free( &( pxCredentials->privKey ) );
+    vPortFree( pxCredentials );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t credentialsDigest( const NetworkCredentials_t * pxNetworkCredentials,
+                                  uint8_t * pucDigest )
+{
+    mbedtls_sha256_context xSha256Context;
+    int32_t lMbedtlsError = 0;
+    TlsTransportProfile_t xProfile = credentialsProfile( pxNetworkCredentials );
+    TlsTransportVersion_t xMaxVersion = credentialsMaxVersion( pxNetworkCredentials );
+    const char ** ppcAlpnProto;
+
+    mbedtls_sha256_init( &xSha256Context );
+
+    lMbedtlsError = mbedtls_sha256_starts_ret( &xSha256Context, 0 );
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_sha256_update_ret( &xSha256Context, pxNetworkCredentials->pucRootCa,
+                                                   pxNetworkCredentials->xRootCaSize );
+    }
+
+    if( ( lMbedtlsError == 0 ) &&
+        ( pxNetworkCredentials->pucClientCert != NULL ) &&
+        ( pxNetworkCredentials->pucPrivateKey != NULL ) )
+    {
+        lMbedtlsError = mbedtls_sha256_update_ret( &xSha256Context, pxNetworkCredentials->pucClientCert,
+                                                   pxNetworkCredentials->xClientCertSize );
+
+        if( lMbedtlsError == 0 )
+        {
+            lMbedtlsError = mbedtls_sha256_update_ret( &xSha256Context, pxNetworkCredentials->pucPrivateKey,
+                                                       pxNetworkCredentials->xPrivateKeySize );
+        }
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_sha256_update_ret( &xSha256Context, ( const uint8_t * ) &xProfile,
+                                                   sizeof( xProfile ) );
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_sha256_update_ret( &xSha256Context, ( const uint8_t * ) &xMaxVersion,
+                                                   sizeof( xMaxVersion ) );
+    }
+
+    /* The configuration keeps the caller's ALPN list, so the list itself is
+     * part of the key along with its contents. */
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_sha256_update_ret( &xSha256Context,
+                                                   ( const uint8_t * ) &( pxNetworkCredentials->ppcAlpnProtos ),
+                                                   sizeof( pxNetworkCredentials->ppcAlpnProtos ) );
+    }
+
+    for( ppcAlpnProto = pxNetworkCredentials->ppcAlpnProtos;
+         ( lMbedtlsError == 0 ) && ( ppcAlpnProto != NULL ) && ( *ppcAlpnProto != NULL );
+         ppcAlpnProto++ )
+    {
+        lMbedtlsError = mbedtls_sha256_update_ret( &xSha256Context, ( const uint8_t * ) *ppcAlpnProto,
+                                                   strlen( *ppcAlpnProto ) + 1U );
+    }
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_sha256_finish_ret( &xSha256Context, pucDigest );
+    }
+
+    mbedtls_sha256_free( &xSha256Context );
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static TlsCredentials_t * credentialStoreFind( const uint8_t * pucDigest,
+                                               uint32_t * pulFreeIndex )
+{
+    TlsCredentials_t * pxCredentials = NULL;
+    uint32_t ulIndex;
+
+    *pulFreeIndex = TLS_TRANSPORT_CREDENTIAL_STORE_ENTRIES;
+
+    for( ulIndex = 0; ulIndex < TLS_TRANSPORT_CREDENTIAL_STORE_ENTRIES; ulIndex++ )
+    {
+        if( pxCredentialStore[ ulIndex ] == NULL )
+        {
+            *pulFreeIndex = ulIndex;
+        }
+        else if( memcmp( pxCredentialStore[ ulIndex ]->ucDigest, pucDigest,
+                         sizeof( pxCredentialStore[ ulIndex ]->ucDigest ) ) == 0 )
+        {
+            pxCredentials = pxCredentialStore[ ulIndex ];
+            break;
+        }
+        else if( ( pxCredentialStore[ ulIndex ]->ulRefCount == 0 ) &&
+                 ( *pulFreeIndex == TLS_TRANSPORT_CREDENTIAL_STORE_ENTRIES ) )
+        {
+            /* Unused credentials can make room for new ones. */
+            *pulFreeIndex = ulIndex;
+        }
+    }
+
+    return pxCredentials;
+}
+/*-----------------------------------------------------------*/
+
+static TlsCredentials_t * credentialsParse( const NetworkCredentials_t * pxNetworkCredentials,
+                                            const uint8_t * pucDigest )
+{
+    TlsCredentials_t * pxCredentials;
+    BaseType_t xHasClientCert;
+    int32_t lMbedtlsError = 0;
+
+    xHasClientCert = ( ( pxNetworkCredentials->pucClientCert != NULL ) &&
+                       ( pxNetworkCredentials->pucPrivateKey != NULL ) ) ? pdTRUE : pdFALSE;
+
+    if( ( pxCredentials = pvPortMalloc( sizeof( TlsCredentials_t ) ) ) == NULL )
+    {
+        LogError( ( "Failed to allocate TLS credentials." ) );
+    }
+    else
+    {
+        ( void ) memcpy( pxCredentials->ucDigest, pucDigest, sizeof( pxCredentials->ucDigest ) );
+        pxCredentials->ulRefCount = 0;
+        pxCredentials->xCached = pdFALSE;
+        pxCredentials->xHasClientCert = xHasClientCert;
+        mbedtls_x509_crt_init( &( pxCredentials->rootCa ) );
+        mbedtls_x509_crt_init( &( pxCredentials->clientCert ) );
+        mbedtls_pk_init( &( pxCredentials->privKey ) );
+        mbedtls_ssl_config_init( &( pxCredentials->config ) );
+        #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+            mbedtls_ssl_config_init( &( pxCredentials->pinnedConfig ) );
+        #endif
+
+        lMbedtlsError = setRootCa( pxCredentials,
+                                   pxNetworkCredentials->pucRootCa,
+                                   pxNetworkCredentials->xRootCaSize );
+
+        if( ( lMbedtlsError == 0 ) && ( xHasClientCert == pdTRUE ) )
+        {
+            lMbedtlsError = setClientCertificate( pxCredentials,
+                                                  pxNetworkCredentials->pucClientCert,
+                                                  pxNetworkCredentials->xClientCertSize );
+        }
+
+        if( ( lMbedtlsError == 0 ) && ( xHasClientCert == pdTRUE ) )
+        {
+            lMbedtlsError = setPrivateKey( pxCredentials,
+                                           pxNetworkCredentials->pucPrivateKey,
+                                           pxNetworkCredentials->xPrivateKeySize );
+        }
+
+        if( lMbedtlsError == 0 )
+        {
+            lMbedtlsError = configBuild( pxCredentials, &( pxCredentials->config ),
+                                         MBEDTLS_SSL_VERIFY_REQUIRED, pxNetworkCredentials );
+        }
+
+        /* mbed TLS still parses the certificate of a pinned server and
+         * checks the key exchange signature with it; certPinCheck vets
+         * the key. */
+        #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+            if( lMbedtlsError == 0 )
+            {
+                lMbedtlsError = configBuild( pxCredentials, &( pxCredentials->pinnedConfig ),
+                                             MBEDTLS_SSL_VERIFY_NONE, pxNetworkCredentials );
+            }
+        #endif
+
+        if( lMbedtlsError != 0 )
+        {
+            credentialsFree( pxCredentials );
+            pxCredentials = NULL;
+        }
+    }
+
+    return pxCredentials;
+}
+/*-----------------------------------------------------------*/
+
+static TlsCredentials_t * credentialStoreAcquire( const NetworkCredentials_t * pxNetworkCredentials )
+{
+    TlsCredentials_t * pxCredentials = NULL;
+    TlsCredentials_t * pxParsed = NULL;
+    uint8_t ucDigest[ 32 ];
+    uint32_t ulFreeIndex;
+
+    configASSERT( pxNetworkCredentials != NULL );
+
+    /* Hashing the encoded credentials is far cheaper than parsing them. */
+    if( credentialsDigest( pxNetworkCredentials, ucDigest ) != 0 )
+    {
+        LogError( ( "Failed to hash TLS credentials." ) );
+    }
+    else if( transportLock() == pdTRUE )
+    {
+        pxCredentials = credentialStoreFind( ucDigest, &ulFreeIndex );
+
+        if( pxCredentials != NULL )
+        {
+            pxCredentials->ulRefCount++;
+        }
+
+        ( void ) xSemaphoreGive( xTransportMutex );
+
+        if( pxCredentials != NULL )
+        {
+            LogDebug( ( "Reusing parsed TLS credentials and configuration." ) );
+        }
+        else
+        {
+            /* Parsing takes long, so connections that only use the store
+             * do not wait for it. */
+            pxParsed = credentialsParse( pxNetworkCredentials, ucDigest );
+        }
+
+        if( ( pxParsed != NULL ) && ( transportLock() == pdTRUE ) )
+        {
+            /* Another connection may have stored the same credentials while
+             * these were parsed. */
+            pxCredentials = credentialStoreFind( ucDigest, &ulFreeIndex );
+
+            if( pxCredentials == NULL )
+            {
+                pxCredentials = pxParsed;
+                pxParsed = NULL;
+
+                if( ulFreeIndex < TLS_TRANSPORT_CREDENTIAL_STORE_ENTRIES )
+                {
+                    if( pxCredentialStore[ ulFreeIndex ] != NULL )
+                    {
+                        credentialsFree( pxCredentialStore[ ulFreeIndex ] );
+                    }
+
+                    pxCredentials->xCached = pdTRUE;
+                    pxCredentialStore[ ulFreeIndex ] = pxCredentials;
+                }
+                else
+                {
+                    /* Store is full of credentials in use, this connection
+                     * keeps its own copy. */
+                }
+            }
+
+            pxCredentials->ulRefCount++;
+
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+
+        /* Credentials parsed twice, or that could not be stored. */
+        if( pxParsed != NULL )
+        {
+            credentialsFree( pxParsed );
+        }
+    }
+
+    return pxCredentials;
+}
+/*-----------------------------------------------------------*/
+
+static void credentialStoreRelease( TlsCredentials_t * pxCredentials )
+{
+    configASSERT( pxCredentials != NULL );
+
+    if( transportLock() == pdTRUE )
+    {
+        configASSERT( pxCredentials->ulRefCount > 0 );
+        pxCredentials->ulRefCount--;
+
+        /* Stored credentials stay parsed for the next connection. */
+        if( ( pxCredentials->ulRefCount == 0 ) && ( pxCredentials->xCached == pdFALSE ) )
+        {
+            credentialsFree( pxCredentials );
+        }
+
+        ( void ) xSemaphoreGive( xTransportMutex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static int32_t configBuild( TlsCredentials_t * pxCredentials,
+                            mbedtls_ssl_config * pxConfig,
+                            int lAuthMode,
+                            const NetworkCredentials_t * pxNetworkCredentials )
+{
+    int32_t lMbedtlsError = 0;
+
+    lMbedtlsError = mbedtls_ssl_config_defaults( pxConfig,
+                                                 MBEDTLS_SSL_IS_CLIENT,
+                                                 MBEDTLS_SSL_TRANSPORT_STREAM,
+                                                 MBEDTLS_SSL_PRESET_DEFAULT );
+
+    if( lMbedtlsError != 0 )
+    {
+        LogError( ( "Failed to set default SSL configuration: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+    }
+    else if( ( lMbedtlsError = setCredentials( pxCredentials, pxConfig, lAuthMode ) ) != 0 )
+    {
+        LogError( ( "Failed to configure TLS credentials: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+    }
+    else
+    {
+        setProfile( pxCredentials, pxConfig, pxNetworkCredentials );
+        setVersion( pxConfig, pxNetworkCredentials );
+
+        /* Optionally set ALPN protocols. */
+        setOptionalConfigurations( pxConfig, pxNetworkCredentials );
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t setCredentials( TlsCredentials_t * pxCredentials,
+                               mbedtls_ssl_config * pxConfig,
+                               int lAuthMode )
+{
+    int32_t lMbedtlsError = 0;
+
+    configASSERT( pxCredentials != NULL );
+    configASSERT( pxConfig != NULL );
+
+    /* Set up the certificate security profile, starting from the default value. */
+    pxCredentials->certProfile = mbedtls_x509_crt_profile_default;
+
+    /* Set SSL authmode and the RNG context. */
+    mbedtls_ssl_conf_authmode( pxConfig, lAuthMode );
+    mbedtls_ssl_conf_rng( pxConfig,
+                          runtimeRandom,
+                          &xTlsRuntime );
+    mbedtls_ssl_conf_cert_profile( pxConfig,
+                                   &( pxCredentials->certProfile ) );
+    mbedtls_ssl_conf_ca_chain( pxConfig,
+                               &( pxCredentials->rootCa ),
+                               NULL );
+
+    if( pxCredentials->xHasClientCert == pdTRUE )
+    {
+        lMbedtlsError = mbedtls_ssl_conf_own_cert( pxConfig,
+                                                   &( pxCredentials->clientCert ),
+                                                   &( pxCredentials->privKey ) );
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportProfile_t credentialsProfile( const NetworkCredentials_t * pxNetworkCredentials )
+{
+    TlsTransportProfile_t xProfile = pxNetworkCredentials->xProfile;
+
+    if( xProfile == eTLSTransportProfileBuildDefault )
+    {
+        xProfile = ( TLS_TRANSPORT_CONSTRAINED_PROFILE == 1 ) ?
+                   eTLSTransportProfileConstrained : eTLSTransportProfileStandard;
+    }
+
+    return xProfile;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportVersion_t credentialsMaxVersion( const NetworkCredentials_t * pxNetworkCredentials )
+{
+    TlsTransportVersion_t xMaxVersion = pxNetworkCredentials->xMaxVersion;
+
+    if( xMaxVersion == eTLSTransportVersionBuildDefault )
+    {
+        xMaxVersion = ( TLS_TRANSPORT_TLS13 == 1 ) ?
+                      eTLSTransportVersionTls13 : eTLSTransportVersionTls12;
+    }
+
+    return xMaxVersion;
+}
+/*-----------------------------------------------------------*/
+
+static void setProfile( TlsCredentials_t * pxCredentials,
+                        mbedtls_ssl_config * pxConfig,
+                        const NetworkCredentials_t * pxNetworkCredentials )
+{
+    if( credentialsProfile( pxNetworkCredentials ) == eTLSTransportProfileConstrained )
+    {
+        /* Offer only what a small device computes cheaply: ECDHE on P-256
+         * with AES-128, so the server cannot pick RSA or DHE key exchange. */
+        mbedtls_ssl_conf_ciphersuites( pxConfig, lConstrainedCiphersuites );
+        #if ( MBEDTLS_VERSION_MAJOR >= 3 )
+            mbedtls_ssl_conf_groups( pxConfig, usConstrainedGroups );
+            mbedtls_ssl_conf_sig_algs( pxConfig, usConstrainedSigAlgs );
+            mbedtls_ssl_conf_min_tls_version( pxConfig,
+                                              MBEDTLS_SSL_VERSION_TLS1_2 );
+        #else
+            mbedtls_ssl_conf_curves( pxConfig, xConstrainedCurves );
+            #if defined( MBEDTLS_KEY_EXCHANGE__WITH_CERT__ENABLED )
+                mbedtls_ssl_conf_sig_hashes( pxConfig, lConstrainedSigHashes );
+            #endif
+            mbedtls_ssl_conf_min_version( pxConfig,
+                                          MBEDTLS_SSL_MAJOR_VERSION_3,
+                                          MBEDTLS_SSL_MINOR_VERSION_3 );
+        #endif
+
+        /* The chain up to the root may use P-384 and SHA-384. */
+        pxCredentials->certProfile.allowed_mds = MBEDTLS_X509_ID_FLAG( MBEDTLS_MD_SHA256 ) |
+                                                 MBEDTLS_X509_ID_FLAG( MBEDTLS_MD_SHA384 );
+        pxCredentials->certProfile.allowed_pks = MBEDTLS_X509_ID_FLAG( MBEDTLS_PK_ECKEY ) |
+                                                 MBEDTLS_X509_ID_FLAG( MBEDTLS_PK_ECDSA );
+        pxCredentials->certProfile.allowed_curves = MBEDTLS_X509_ID_FLAG( MBEDTLS_ECP_DP_SECP256R1 ) |
+                                                    MBEDTLS_X509_ID_FLAG( MBEDTLS_ECP_DP_SECP384R1 );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void setVersion( mbedtls_ssl_config * pxConfig,
+                        const NetworkCredentials_t * pxNetworkCredentials )
+{
+    TlsTransportVersion_t xMaxVersion = credentialsMaxVersion( pxNetworkCredentials );
+
+    #if ( tlsTLS13_AVAILABLE == 1 )
+        /* mbed TLS offers TLS 1.3 by default when it is built in. */
+        mbedtls_ssl_conf_max_tls_version( pxConfig,
+                                          ( xMaxVersion == eTLSTransportVersionTls13 ) ?
+                                          MBEDTLS_SSL_VERSION_TLS1_3 : MBEDTLS_SSL_VERSION_TLS1_2 );
+    #else
+        ( void ) pxConfig;
+
+        if( xMaxVersion == eTLSTransportVersionTls13 )
+        {
+            LogWarn( ( "TLS 1.3 needs mbed TLS 3.x with MBEDTLS_SSL_PROTO_TLS1_3, using TLS 1.2." ) );
+        }
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static void setOptionalConfigurations( mbedtls_ssl_config * pxConfig,
+                                       const NetworkCredentials_t * pxNetworkCredentials )
+{
+    int32_t lMbedtlsError = -1;
+
+    configASSERT( pxConfig != NULL );
+    configASSERT( pxNetworkCredentials != NULL );
+
+    if( pxNetworkCredentials->ppcAlpnProtos != NULL )
+    {
+        /* Include an application protocol list in the TLS ClientHello
+         * message. */
+        lMbedtlsError = mbedtls_ssl_conf_alpn_protocols( pxConfig,
+                                                         pxNetworkCredentials->ppcAlpnProtos );
+
+        if( lMbedtlsError != 0 )
+        {
+            LogError( ( "Failed to configure ALPN protocol in mbed TLS: lMbedtlsError[%d]= %s : %s.",
+                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+        }
+    }
+
+    /* Set Maximum Fragment Length if enabled. */
+    #if defined( MBEDTLS_SSL_MAX_FRAGMENT_LENGTH ) && ( TLS_TRANSPORT_MAX_FRAGMENT_LENGTH > 0 )
+
+        /* Enable the max fragment extension. 4096 bytes is currently the largest fragment size permitted.
+         * See RFC 8449 https://tools.ietf.org/html/rfc8449 for more information.
+         *
+         * Smaller fragments let the record buffers shrink further after the
+         * handshake, see TLS_TRANSPORT_MAX_FRAGMENT_LENGTH.
+         */
+        lMbedtlsError = mbedtls_ssl_conf_max_frag_len( pxConfig, tlsMAX_FRAG_LEN_CODE );
+
+        if( lMbedtlsError != 0 )
+        {
+            LogError( ( "Failed to maximum fragment length extension: lMbedtlsError[%d]= %s : %s.",
+                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+        }
+    #endif /* if defined( MBEDTLS_SSL_MAX_FRAGMENT_LENGTH ) && ( TLS_TRANSPORT_MAX_FRAGMENT_LENGTH > 0 ) */
+
+    /* Ask the server for a session ticket, so reconnects can resume the
+     * session without keeping server side state. */
+    #if defined( MBEDTLS_SSL_SESSION_TICKETS ) && ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+        mbedtls_ssl_conf_session_tickets( pxConfig,
+                                          MBEDTLS_SSL_SESSION_TICKETS_ENABLED );
+
+        /* TLS 1.3 tickets arrive after the handshake. Have mbedtls_ssl_read
+         * report them so they can be cached. */
+        #if defined( MBEDTLS_SSL_TLS1_3_SIGNAL_NEW_SESSION_TICKETS_ENABLED )
+            mbedtls_ssl_conf_tls13_enable_signal_new_session_tickets( pxConfig,
+                                                                      MBEDTLS_SSL_TLS1_3_SIGNAL_NEW_SESSION_TICKETS_ENABLED );
+        #endif
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static void setServerName( MbedSSLContext_t * pxSslContext,
+                           const char * pcHostName,
+                           const NetworkCredentials_t * pxNetworkCredentials )
+{
+    int32_t lMbedtlsError = -1;
+
+    configASSERT( pxSslContext != NULL );
+    configASSERT( pcHostName != NULL );
+    configASSERT( pxNetworkCredentials != NULL );
+
+    /* Enable SNI if requested. */
+    if( pxNetworkCredentials->xDisableSni == pdFALSE )
+    {
+        lMbedtlsError = mbedtls_ssl_set_hostname( &( pxSslContext->context ),
+                                                  pcHostName );
+
+        if( lMbedtlsError != 0 )
+        {
+            LogError( ( "Failed to set server name: lMbedtlsError[%d]= %s : %s.",
+                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
+                                      const char * pcHostName,
+                                      const NetworkCredentials_t * pxNetworkCredentials )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    MbedSSLContext_t * pxSSLContext = NULL;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pxNetworkContext->pParams != NULL );
+    configASSERT( pxNetworkContext->pParams->xSSLContext != NULL );
+    configASSERT( pcHostName != NULL );
+    configASSERT( pxNetworkCredentials != NULL );
+    configASSERT( pxNetworkCredentials->pucRootCa != NULL );
+
+    pxTlsTransportParams = pxNetworkContext->pParams;
+    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+
+    /* Initialize the mbed TLS context structures. */
+    sslContextInit( pxSSLContext );
+
+    /* The configuration is shared with every connection using the same
+     * credentials and settings, and only built by the first, whose heap
+     * figures include the parsing. */
+    tlsHEAP_STATS_ATTACH( pxSSLContext );
+    pxSSLContext->pxCredentials = credentialStoreAcquire( pxNetworkCredentials );
+    tlsHEAP_STATS_DETACH();
+
+    if( pxSSLContext->pxCredentials == NULL )
+    {
+        xRetVal = eTLSTransportInvalidCredentials;
+    }
+    else
+    {
+        /* Optionally set SNI. */
+        setServerName( pxSSLContext,
+                       pcHostName,
+                       pxNetworkCredentials );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsHandshakeStart( NetworkContext_t * pxNetworkContext,
+                                               const char * pcHostName,
+                                               uint16_t usPort )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    int32_t lMbedtlsError = 0;
+    MbedSSLContext_t * pxSSLContext = NULL;
+    const mbedtls_ssl_config * pxConfig;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pxNetworkContext->pParams != NULL );
+    configASSERT( pxNetworkContext->pParams->xSSLContext != NULL );
+    configASSERT( pcHostName != NULL );
+
+    pxTlsTransportParams = pxNetworkContext->pParams;
+    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+
+    pxConfig = &( pxSSLContext->pxCredentials->config );
+
+    #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+        certPinLookup( pxSSLContext, pcHostName, usPort );
+
+        if( pxSSLContext->xPinned == pdTRUE )
+        {
+            pxConfig = &( pxSSLContext->pxCredentials->pinnedConfig );
+        }
+    #endif
+
+    /* Initialize the mbed TLS secured connection context. */
+    tlsHEAP_STATS_ATTACH( pxSSLContext );
+    lMbedtlsError = mbedtls_ssl_setup( &( pxSSLContext->context ),
+                                       pxConfig );
+    tlsHEAP_STATS_DETACH();
+
+    if( lMbedtlsError != 0 )
+    {
+        LogError( ( "Failed to set up mbed TLS SSL context: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+
+        xRetVal = eTLSTransportInternalError;
+    }
+    else
+    {
+        /* Set the underlying IO for the handshake. The socket callbacks are
+         * installed once the handshake completes. */
+        mbedtls_ssl_set_bio( &( pxSSLContext->context ),
+                             ( void * ) pxSSLContext,
+                             sslConnectSend,
+                             sslConnectRecv,
+                             NULL );
+
+        #if ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+            ( void ) sessionCacheRestore( pxSSLContext, pcHostName, usPort );
+        #endif
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsHandshakeStep( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    int32_t lMbedtlsError = 0;
+    MbedSSLContext_t * pxSSLContext = NULL;
+    TlsConnectState_t * pxConnect;
+    TlsConnectMetrics_t * pxMetrics;
+    int lState;
+    TickType_t xNow;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pxNetworkContext->pParams != NULL );
+    configASSERT( pxNetworkContext->pParams->xSSLContext != NULL );
+
+    pxTlsTransportParams = pxNetworkContext->pParams;
+    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+    pxConnect = &( pxSSLContext->xConnect );
+    pxMetrics = &( pxSSLContext->xConnectMetrics );
+
+    /* Step through the handshake as mbedtls_ssl_handshake does, timing each
+     * state, until it needs data the server has not sent yet. */
+    tlsHEAP_STATS_ATTACH( pxSSLContext );
+
+    do
+    {
+        lState = tlsSSL_STATE( &( pxSSLContext->context ) );
+        lMbedtlsError = mbedtls_ssl_handshake_step( &( pxSSLContext->context ) );
+
+        if( tlsSSL_STATE( &( pxSSLContext->context ) ) != lState )
+        {
+            xNow = xTaskGetTickCount();
+
+            if( ( lState >= 0 ) && ( lState < TLS_TRANSPORT_HANDSHAKE_STATES ) )
+            {
+                pxMetrics->ulStateMs[ lState ] += tlsTICKS_TO_MS( xNow - pxConnect->xStateStart );
+            }
+
+            /* The server accepted the session if it skips to the Finished
+             * messages right after its hello. */
+            if( ( lState == MBEDTLS_SSL_SERVER_HELLO ) &&
+                ( tlsSSL_STATE( &( pxSSLContext->context ) ) == MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC ) )
+            {
+                pxMetrics->xResumed = pdTRUE;
+            }
+
+            /* A TLS 1.3 server that accepted the ticket sends no certificate. */
+            #if ( tlsTLS13_AVAILABLE == 1 )
+                if( ( lState == MBEDTLS_SSL_ENCRYPTED_EXTENSIONS ) &&
+                    ( tlsSSL_STATE( &( pxSSLContext->context ) ) == MBEDTLS_SSL_SERVER_FINISHED ) )
+                {
+                    pxMetrics->xResumed = pdTRUE;
+                }
+            #endif
+
+            /* Vet the server certificate before its key is used. */
+            #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+                if( ( lMbedtlsError == 0 ) &&
+                    ( lState == MBEDTLS_SSL_SERVER_CERTIFICATE ) &&
+                    ( pxSSLContext->xPinned == pdTRUE ) )
+                {
+                    lMbedtlsError = certPinCheck( pxSSLContext );
+                }
+            #endif
+
+            pxConnect->xStateStart = xNow;
+        }
+    } while( ( lMbedtlsError == 0 ) &&
+             ( tlsSSL_STATE( &( pxSSLContext->context ) ) != MBEDTLS_SSL_HANDSHAKE_OVER ) );
+
+    tlsHEAP_STATS_DETACH();
+
+    if( ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+    {
+        /* A receive timeout of 0 waits forever, as for the socket. */
+        if( ( pxConnect->xRecvTimeout != 0U ) &&
+            ( ( xTaskGetTickCount() - pxConnect->xLastProgress ) >= pxConnect->xRecvTimeout ) )
+        {
+            LogError( ( "Timed out waiting for the TLS handshake with %s.",
+                        pxConnect->pcHostName ) );
+            xRetVal = eTLSTransportHandshakeFailed;
+        }
+        else
+        {
+            xRetVal = eTLSTransportInProgress;
+        }
+    }
+    else if( lMbedtlsError != 0 )
+    {
+        LogError( ( "Failed to perform TLS handshake: lMbedtlsError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+
+        xRetVal = eTLSTransportHandshakeFailed;
+    }
+    else
+    {
+        LogInfo( ( "(Network connection %p) TLS handshake successful, ciphersuite %s.",
+                   pxNetworkContext,
+                   mbedtls_ssl_get_ciphersuite( &( pxSSLContext->context ) ) ) );
+
+        pxMetrics->ulHandshakeMs = tlsTICKS_TO_MS( xTaskGetTickCount() - pxConnect->xHandshakeStart );
+
+        #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+            if( pxSSLContext->lHeapAccount >= 0 )
+            {
+                size_t xPeakHeap;
+
+                /* The handshake buffers are freed and the record buffers
+                 * resized by now. */
+                mbedtls_platform_heap_stats_get( pxSSLContext->lHeapAccount,
+                                                 &( pxSSLContext->xSteadyHeap ),
+                                                 &xPeakHeap );
+                LogInfo( ( "(Network connection %p) mbed TLS heap: peak=%u, steady=%u bytes.",
+                           pxNetworkContext, ( unsigned ) xPeakHeap,
+                           ( unsigned ) pxSSLContext->xSteadyHeap ) );
+            }
+        #endif
+        pxMetrics->ulCertificateMs = handshakeStateMs( pxMetrics, MBEDTLS_SSL_SERVER_CERTIFICATE );
+        pxMetrics->ulKeyExchangeMs = handshakeStateMs( pxMetrics, MBEDTLS_SSL_SERVER_KEY_EXCHANGE ) +
+                                     handshakeStateMs( pxMetrics, MBEDTLS_SSL_CLIENT_KEY_EXCHANGE );
+
+        #if ( tlsTLS13_AVAILABLE == 1 )
+            if( mbedtls_ssl_get_version_number( &( pxSSLContext->context ) ) == MBEDTLS_SSL_VERSION_TLS1_3 )
+            {
+                /* TLS 1.3 agrees on the key in the hellos and signs the
+                 * handshake in CertificateVerify. */
+                pxMetrics->xTls13 = pdTRUE;
+                pxMetrics->ulKeyExchangeMs = handshakeStateMs( pxMetrics, MBEDTLS_SSL_SERVER_HELLO ) +
+                                             handshakeStateMs( pxMetrics, MBEDTLS_SSL_CERTIFICATE_VERIFY );
+            }
+        #endif
+
+        /* MISRA Rule 11.2 flags the following line for casting the second
+         * parameter to void *. This rule is suppressed because
+         * #mbedtls_ssl_set_bio requires the second parameter as void *.
+         */
+        /* coverity[misra_c_2012_rule_11_2_violation] */
+        mbedtls_ssl_set_bio( &( pxSSLContext->context ),
+                             ( void * ) pxTlsTransportParams->xTCPSocket,
+                             mbedtls_platform_send,
+                             mbedtls_platform_recv,
+                             NULL );
+
+        #if ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+            if( pxMetrics->xTls13 == pdFALSE )
+            {
+                sessionCacheStore( pxSSLContext, pxConnect->pcHostName, pxConnect->usPort );
+            }
+
+            #if ( tlsTLS13_AVAILABLE == 1 )
+                else if( ( pxSSLContext->pcTicketHostName = pvPortMalloc( strlen( pxConnect->pcHostName ) + 1U ) ) != NULL )
+                {
+                    /* TLS 1.3 tickets arrive after the handshake, see sslRead. */
+                    ( void ) strcpy( pxSSLContext->pcTicketHostName, pxConnect->pcHostName );
+                    pxSSLContext->usTicketPort = pxConnect->usPort;
+                }
+            #endif
+        #endif
+
+        #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+            certPinStore( pxSSLContext, pxConnect->pcHostName, pxConnect->usPort );
+        #endif
+    }
+
+    if( xRetVal == eTLSTransportHandshakeFailed )
+    {
+        /* Do not offer a session that may be the cause of the failure. */
+        #if ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+            sessionCacheInvalidate( pxSSLContext, pxConnect->pcHostName, pxConnect->usPort );
+        #endif
+
+        #if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+            certPinInvalidate( pxConnect->pcHostName, pxConnect->usPort );
+        #endif
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static int sslConnectSend( void * pvContext,
+                           const unsigned char * pucBuffer,
+                           size_t xLength )
+{
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
+
+    return mbedtls_platform_send( ( void * ) pxSslContext->xConnect.xSocket,
+                                  pucBuffer,
+                                  xLength );
+}
+/*-----------------------------------------------------------*/
+
+static int sslConnectRecv( void * pvContext,
+                           unsigned char * pucBuffer,
+                           size_t xLength )
+{
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
+    int lReceived;
+
+    lReceived = mbedtls_platform_recv( ( void * ) pxSslContext->xConnect.xSocket,
+                                       pucBuffer,
+                                       xLength );
+
+    if( lReceived == 0 )
+    {
+        /* The sockets wrappers report a receive timeout as 0 bytes. */
+        lReceived = MBEDTLS_ERR_SSL_WANT_READ;
+    }
+    else if( lReceived > 0 )
+    {
+        pxSslContext->xConnect.xLastProgress = xTaskGetTickCount();
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return lReceived;
+}
+/*-----------------------------------------------------------*/
+
+#if ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+
+    static TlsSessionCacheEntry_t * sessionCacheFind( const char * pcHostName,
+                                                      uint16_t usPort,
+                                                      const uint8_t * pucCredentialsDigest,
+                                                      BaseType_t xAllocate )
+    {
+        TlsSessionCacheEntry_t * pxEntry = NULL;
+        TlsSessionCacheEntry_t * pxOldest = &xSessionCache[ 0 ];
+        TickType_t xNow = xTaskGetTickCount();
+        uint32_t ulIndex;
+
+        for( ulIndex = 0; ulIndex < TLS_TRANSPORT_SESSION_CACHE_ENTRIES; ulIndex++ )
+        {
+            if( ( xSessionCache[ ulIndex ].usPort == usPort ) &&
+                ( strncmp( xSessionCache[ ulIndex ].cHostName, pcHostName,
+                           sizeof( xSessionCache[ ulIndex ].cHostName ) ) == 0 ) &&
+                ( memcmp( xSessionCache[ ulIndex ].ucCredentialsDigest, pucCredentialsDigest,
+                          sizeof( xSessionCache[ ulIndex ].ucCredentialsDigest ) ) == 0 ) )
+            {
+                pxEntry = &xSessionCache[ ulIndex ];
+                break;
+            }
+            else if( ( pxOldest->xValid == pdTRUE ) &&
+                     ( ( xSessionCache[ ulIndex ].xValid == pdFALSE ) ||
+                       ( ( xNow - xSessionCache[ ulIndex ].xLastUsed ) > ( xNow - pxOldest->xLastUsed ) ) ) )
+            {
+                /* Prefer an unused entry, then the least recently used one. */
+                pxOldest = &xSessionCache[ ulIndex ];
+            }
+        }
+
+        if( ( pxEntry == NULL ) && ( xAllocate == pdTRUE ) &&
+            ( strlen( pcHostName ) < sizeof( pxOldest->cHostName ) ) )
+        {
+            if( pxOldest->xValid == pdTRUE )
+            {
+                mbedtls_ssl_session_free( &( pxOldest->xSession ) );
+            }
+
+            pxOldest->xValid = pdFALSE;
+            pxOldest->usPort = usPort;
+            ( void ) strcpy( pxOldest->cHostName, pcHostName );
+            ( void ) memcpy( pxOldest->ucCredentialsDigest, pucCredentialsDigest,
+                             sizeof( pxOldest->ucCredentialsDigest ) );
+            mbedtls_ssl_session_init( &( pxOldest->xSession ) );
+            pxEntry = pxOldest;
+        }
+
+        return pxEntry;
+    }
+/*-----------------------------------------------------------*/
+
+    static BaseType_t sessionCacheRestore( MbedSSLContext_t * pxSslContext,
+                                           const char * pcHostName,
+                                           uint16_t usPort )
+    {
+        TlsSessionCacheEntry_t * pxEntry;
+        BaseType_t xRetVal = pdFALSE;
+        BaseType_t xCached = pdFALSE;
+        int32_t lMbedtlsError;
+
+        #if ( TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 )
+            mbedtls_ssl_session xSession;
+            uint8_t * pucBuffer;
+            size_t xLength = 0;
+            BaseType_t xLoaded = pdFALSE;
+        #endif
+
+        if( transportLock() == pdTRUE )
+        {
+            pxEntry = sessionCacheFind( pcHostName, usPort, pxSslContext->pxCredentials->ucDigest, pdFALSE );
+
+            if( ( pxEntry != NULL ) && ( pxEntry->xValid == pdTRUE ) )
+            {
+                xCached = pdTRUE;
+                tlsHEAP_STATS_ATTACH( pxSslContext );
+                lMbedtlsError = mbedtls_ssl_set_session( &( pxSslContext->context ),
+                                                         &( pxEntry->xSession ) );
+                tlsHEAP_STATS_DETACH();
+
+                if( lMbedtlsError != 0 )
+                {
+                    LogError( ( "Failed to set cached TLS session: lMbedtlsError[%d]= %s : %s.",
+                                lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                                mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+                }
+                else
+                {
+                    LogDebug( ( "Resuming cached TLS session for %s:%u.", pcHostName, usPort ) );
+                    pxEntry->xLastUsed = xTaskGetTickCount();
+                    xRetVal = pdTRUE;
+                }
+            }
+
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+
+        #if ( TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 )
+            /* Fall back to the application store after a reboot. The store
+             * may do file I/O, so it is read without the mutex, and a cache
+             * entry is only taken once a session was loaded. The stored
+             * session starts with the digest of its credentials. */
+            if( ( xCached == pdFALSE ) &&
+                ( ( pucBuffer = pvPortMalloc( TLS_TRANSPORT_SESSION_CACHE_PERSIST_MAX_SIZE ) ) != NULL ) )
+            {
+                mbedtls_ssl_session_init( &xSession );
+
+                if( ( xApplicationTlsSessionLoad( pcHostName, usPort, pucBuffer,
+                                                  TLS_TRANSPORT_SESSION_CACHE_PERSIST_MAX_SIZE,
+                                                  &xLength ) == pdPASS ) &&
+                    ( xLength > sizeof( pxSslContext->pxCredentials->ucDigest ) ) &&
+                    ( memcmp( pucBuffer, pxSslContext->pxCredentials->ucDigest,
+                              sizeof( pxSslContext->pxCredentials->ucDigest ) ) == 0 ) &&
+                    ( mbedtls_ssl_session_load( &xSession,
+                                                &( pucBuffer[ sizeof( pxSslContext->pxCredentials->ucDigest ) ] ),
+                                                xLength - sizeof( pxSslContext->pxCredentials->ucDigest ) ) == 0 ) )
+                {
+                    LogDebug( ( "Loaded persisted TLS session for %s:%u.", pcHostName, usPort ) );
+                    xLoaded = pdTRUE;
+                }
+
+                mbedtls_platform_zeroize( pucBuffer, TLS_TRANSPORT_SESSION_CACHE_PERSIST_MAX_SIZE );
+                vPortFree( pucBuffer );
+
+                if( xLoaded == pdTRUE )
+                {
+                    tlsHEAP_STATS_ATTACH( pxSslContext );
+                    lMbedtlsError = mbedtls_ssl_set_session( &( pxSslContext->context ), &xSession );
+                    tlsHEAP_STATS_DETACH();
+
+                    if( lMbedtlsError != 0 )
+                    {
+                        LogError( ( "Failed to set persisted TLS session: lMbedtlsError[%d]= %s : %s.",
+                                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+                    }
+                    else
+                    {
+                        xRetVal = pdTRUE;
+
+                        /* Hand the session to the cache, unless another
+                         * connection cached one in the meantime. */
+                        if( transportLock() == pdTRUE )
+                        {
+                            pxEntry = sessionCacheFind( pcHostName, usPort, pxSslContext->pxCredentials->ucDigest, pdTRUE );
+
+                            if( ( pxEntry != NULL ) && ( pxEntry->xValid == pdFALSE ) )
+                            {
+                                pxEntry->xSession = xSession;
+                                pxEntry->xValid = pdTRUE;
+                                pxEntry->xLastUsed = xTaskGetTickCount();
+                                mbedtls_ssl_session_init( &xSession );
+                            }
+
+                            ( void ) xSemaphoreGive( xTransportMutex );
+                        }
+                    }
+                }
+
+                /* A failed load may also leave a partly populated session. */
+                mbedtls_ssl_session_free( &xSession );
+            }
+        #else /* if ( TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 ) */
+            ( void ) xCached;
+        #endif /* TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 */
+
+        return xRetVal;
+    }
+/*-----------------------------------------------------------*/
+
+    static void sessionCacheStore( MbedSSLContext_t * pxSslContext,
+                                   const char * pcHostName,
+                                   uint16_t usPort )
+    {
+        TlsSessionCacheEntry_t * pxEntry;
+        int32_t lMbedtlsError;
+
+        #if ( TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 )
+            uint8_t * pucBuffer = NULL;
+            size_t xLength = 0;
+        #endif
+
+        if( transportLock() == pdTRUE )
+        {
+            if( ( pxEntry = sessionCacheFind( pcHostName, usPort, pxSslContext->pxCredentials->ucDigest, pdTRUE ) ) == NULL )
+            {
+                LogWarn( ( "Host name too long to cache TLS session." ) );
+            }
+            else
+            {
+                if( pxEntry->xValid == pdTRUE )
+                {
+                    mbedtls_ssl_session_free( &( pxEntry->xSession ) );
+                    mbedtls_ssl_session_init( &( pxEntry->xSession ) );
+                    pxEntry->xValid = pdFALSE;
+                }
+
+                lMbedtlsError = mbedtls_ssl_get_session( &( pxSslContext->context ),
+                                                         &( pxEntry->xSession ) );
+
+                if( lMbedtlsError != 0 )
+                {
+                    LogError( ( "Failed to save TLS session: lMbedtlsError[%d]= %s : %s.",
+                                lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                                mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+                    mbedtls_ssl_session_free( &( pxEntry->xSession ) );
+                    mbedtls_ssl_session_init( &( pxEntry->xSession ) );
+                }
+                else
+                {
+                    pxEntry->xValid = pdTRUE;
+                    pxEntry->xLastUsed = xTaskGetTickCount();
+
+                    #if ( TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 )
+                        /* Serialize under the mutex, but leave the file I/O
+                         * of the application store until it is released. */
+                        if( ( pucBuffer = pvPortMalloc( TLS_TRANSPORT_SESSION_CACHE_PERSIST_MAX_SIZE ) ) != NULL )
+                        {
+                            ( void ) memcpy( pucBuffer, pxEntry->ucCredentialsDigest,
+                                             sizeof( pxEntry->ucCredentialsDigest ) );
+
+                            if( mbedtls_ssl_session_save( &( pxEntry->xSession ),
+                                                          &( pucBuffer[ sizeof( pxEntry->ucCredentialsDigest ) ] ),
+                                                          TLS_TRANSPORT_SESSION_CACHE_PERSIST_MAX_SIZE -
+                                                          sizeof( pxEntry->ucCredentialsDigest ),
+                                                          &xLength ) == 0 )
+                            {
+                                xLength += sizeof( pxEntry->ucCredentialsDigest );
+                            }
+                            else
+                            {
+                                xLength = 0;
+                            }
+                        }
+                    #endif /* TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 */
+                }
+            }
+
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+
+        #if ( TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 )
+            if( pucBuffer != NULL )
+            {
+                if( ( xLength == 0 ) ||
+                    ( xApplicationTlsSessionSave( pcHostName, usPort, pucBuffer, xLength ) != pdPASS ) )
+                {
+                    LogWarn( ( "Failed to persist TLS session for %s:%u.", pcHostName, usPort ) );
+                }
+
+                mbedtls_platform_zeroize( pucBuffer, TLS_TRANSPORT_SESSION_CACHE_PERSIST_MAX_SIZE );
+                vPortFree( pucBuffer );
+            }
+        #endif /* TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 */
+    }
+/*-----------------------------------------------------------*/
+
+    static void sessionCacheInvalidate( MbedSSLContext_t * pxSslContext,
+                                        const char * pcHostName,
+                                        uint16_t usPort )
+    {
+        TlsSessionCacheEntry_t * pxEntry;
+
+        if( transportLock() == pdTRUE )
+        {
+            pxEntry = sessionCacheFind( pcHostName, usPort, pxSslContext->pxCredentials->ucDigest, pdFALSE );
+
+            if( ( pxEntry != NULL ) && ( pxEntry->xValid == pdTRUE ) )
+            {
+                mbedtls_ssl_session_free( &( pxEntry->xSession ) );
+                pxEntry->xValid = pdFALSE;
+            }
+
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 */
+
+#if ( TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 )
+
+    static TlsCertPin_t * certPinFind( const char * pcHostName,
+                                       uint16_t usPort,
+                                       BaseType_t xAllocate )
+    {
+        TlsCertPin_t * pxEntry = NULL;
+        TlsCertPin_t * pxOldest = &xCertPins[ 0 ];
+        TickType_t xNow = xTaskGetTickCount();
+        uint32_t ulIndex;
+
+        for( ulIndex = 0; ulIndex < TLS_TRANSPORT_CERT_PIN_ENTRIES; ulIndex++ )
+        {
+            if( ( xCertPins[ ulIndex ].usPort == usPort ) &&
+                ( strncmp( xCertPins[ ulIndex ].cHostName, pcHostName,
+                           sizeof( xCertPins[ ulIndex ].cHostName ) ) == 0 ) )
+            {
+                pxEntry = &xCertPins[ ulIndex ];
+                break;
+            }
+            else if( ( pxOldest->xValid == pdTRUE ) &&
+                     ( ( xCertPins[ ulIndex ].xValid == pdFALSE ) ||
+                       ( ( xNow - xCertPins[ ulIndex ].xLastUsed ) > ( xNow - pxOldest->xLastUsed ) ) ) )
+            {
+                /* Prefer an unused entry, then the least recently used one. */
+                pxOldest = &xCertPins[ ulIndex ];
+            }
+        }
+
+        if( ( pxEntry == NULL ) && ( xAllocate == pdTRUE ) &&
+            ( strlen( pcHostName ) < sizeof( pxOldest->cHostName ) ) )
+        {
+            pxOldest->xValid = pdFALSE;
+            pxOldest->usPort = usPort;
+            ( void ) strcpy( pxOldest->cHostName, pcHostName );
+            pxEntry = pxOldest;
+        }
+
+        return pxEntry;
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t certPinHash( const mbedtls_x509_crt * pxCertificate,
+                                uint8_t * pucDigest )
+    {
+        return mbedtls_sha256_ret( pxCertificate->pk_raw.p,
+                                   pxCertificate->pk_raw.len,
+                                   pucDigest,
+                                   0 );
+    }
+/*-----------------------------------------------------------*/
+
+    static void certPinLookup( MbedSSLContext_t * pxSslContext,
+                               const char * pcHostName,
+                               uint16_t usPort )
+    {
+        TlsCertPin_t * pxEntry;
+
+        pxSslContext->xPinned = pdFALSE;
+
+        if( transportLock() == pdTRUE )
+        {
+            pxEntry = certPinFind( pcHostName, usPort, pdFALSE );
+
+            /* The pin only stands for a chain verified against the same root CA. */
+            if( ( pxEntry != NULL ) && ( pxEntry->xValid == pdTRUE ) &&
+                ( memcmp( pxEntry->ucCredentialsDigest, pxSslContext->pxCredentials->ucDigest,
+                          sizeof( pxEntry->ucCredentialsDigest ) ) == 0 ) )
+            {
+                ( void ) memcpy( pxSslContext->ucPinnedKey, pxEntry->ucKeyDigest,
+                                 sizeof( pxSslContext->ucPinnedKey ) );
+                pxEntry->xLastUsed = xTaskGetTickCount();
+                pxSslContext->xPinned = pdTRUE;
+            }
+
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t certPinCheck( MbedSSLContext_t * pxSslContext )
+    {
+        const mbedtls_x509_crt * pxPeerCert = tlsSSL_NEGOTIATED_PEER_CERT( &( pxSslContext->context ) );
+        const NetworkCredentials_t * pxNetworkCredentials = pxSslContext->xConnect.pxNetworkCredentials;
+        int32_t lMbedtlsError = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+        uint8_t ucDigest[ 32 ];
+        uint32_t ulFlags = 0;
+
+        if( pxPeerCert == NULL )
+        {
+            LogError( ( "Server sent no certificate." ) );
+        }
+        else if( ( certPinHash( pxPeerCert, ucDigest ) == 0 ) &&
+                 ( memcmp( ucDigest, pxSslContext->ucPinnedKey, sizeof( ucDigest ) ) == 0 ) )
+        {
+            LogDebug( ( "Server key matches the pin, skipped certificate chain verification." ) );
+            lMbedtlsError = 0;
+        }
+        else
+        {
+            LogInfo( ( "Server key changed, verifying the certificate chain." ) );
+
+            lMbedtlsError = mbedtls_x509_crt_verify_with_profile( ( mbedtls_x509_crt * ) pxPeerCert,
+                                                                  &( pxSslContext->pxCredentials->rootCa ),
+                                                                  NULL,
+                                                                  &( pxSslContext->pxCredentials->certProfile ),
+                                                                  ( pxNetworkCredentials->xDisableSni == pdFALSE ) ?
+                                                                  pxSslContext->xConnect.pcHostName : NULL,
+                                                                  &ulFlags,
+                                                                  NULL,
+                                                                  NULL );
+
+            if( lMbedtlsError != 0 )
+            {
+                LogError( ( "Failed to verify the server certificate: flags 0x%08x.",
+                            ( unsigned int ) ulFlags ) );
+                lMbedtlsError = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+            }
+        }
+
+        return lMbedtlsError;
+    }
+/*-----------------------------------------------------------*/
+
+    static void certPinStore( MbedSSLContext_t * pxSslContext,
+                              const char * pcHostName,
+                              uint16_t usPort )
+    {
+        const mbedtls_x509_crt * pxPeerCert = mbedtls_ssl_get_peer_cert( &( pxSslContext->context ) );
+        TlsCertPin_t * pxEntry;
+        uint8_t ucDigest[ 32 ];
+
+        if( ( pxPeerCert != NULL ) && ( certPinHash( pxPeerCert, ucDigest ) == 0 ) &&
+            ( transportLock() == pdTRUE ) )
+        {
+            if( ( pxEntry = certPinFind( pcHostName, usPort, pdTRUE ) ) == NULL )
+            {
+                LogWarn( ( "Host name too long to pin server key." ) );
+            }
+            else
+            {
+                ( void ) memcpy( pxEntry->ucKeyDigest, ucDigest, sizeof( pxEntry->ucKeyDigest ) );
+                ( void ) memcpy( pxEntry->ucCredentialsDigest, pxSslContext->pxCredentials->ucDigest,
+                                 sizeof( pxEntry->ucCredentialsDigest ) );
+                pxEntry->xLastUsed = xTaskGetTickCount();
+                pxEntry->xValid = pdTRUE;
+            }
+
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static void certPinInvalidate( const char * pcHostName,
+                                   uint16_t usPort )
+    {
+        TlsCertPin_t * pxEntry;
+
+        if( transportLock() == pdTRUE )
+        {
+            pxEntry = certPinFind( pcHostName, usPort, pdFALSE );
+
+            if( pxEntry != NULL )
+            {
+                pxEntry->xValid = pdFALSE;
+            }
+
+            ( void ) xSemaphoreGive( xTransportMutex );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* TLS_TRANSPORT_CERT_PIN_ENTRIES > 0 */
+
+static TlsTransportStatus_t initMbedtls( void )
+{
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    int32_t lMbedtlsError = 0;
+
+    if( transportLock() != pdTRUE )
+    {
+        xRetVal = eTLSTransportInternalError;
+    }
+    else
+    {
+        if( xTlsRuntime.xInitialized == pdFALSE )
+        {
+            /* Set the mutex functions for mbed TLS thread safety. These stay
+             * installed for the lifetime of the application, as other
+             * connections may be using mbed TLS at any time. */
+            mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
+                                       mbedtls_platform_mutex_free,
+                                       mbedtls_platform_mutex_lock,
+                                       mbedtls_platform_mutex_unlock );
+
+            if( ( xTlsRuntime.xRandomMutex == NULL ) &&
+                ( ( xTlsRuntime.xRandomMutex = xSemaphoreCreateMutex() ) == NULL ) )
+            {
+                LogError( ( "Failed to create random number generator mutex." ) );
+                xRetVal = eTLSTransportInSufficientMemory;
+            }
+
+            if( xRetVal == eTLSTransportSuccess )
+            {
+                /* Initialize contexts for random number generation. */
+                mbedtls_entropy_init( &( xTlsRuntime.entropyContext ) );
+                mbedtls_ctr_drbg_init( &( xTlsRuntime.ctrDrgbContext ) );
+
+                /* Add a strong entropy source. At least one is required. */
+                lMbedtlsError = mbedtls_entropy_add_source( &( xTlsRuntime.entropyContext ),
+                                                            mbedtls_platform_entropy_poll,
+                                                            NULL,
+                                                            32,
+                                                            MBEDTLS_ENTROPY_SOURCE_STRONG );
+
+                if( lMbedtlsError != 0 )
+                {
+                    LogError( ( "Failed to add entropy source: lMbedtlsError[%d]= %s : %s.",
+                                lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                                mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+                    xRetVal = eTLSTransportInternalError;
+                }
+            }
+
+            if( xRetVal == eTLSTransportSuccess )
+            {
+                /* Seed the random number generator. */
+                lMbedtlsError = mbedtls_ctr_drbg_seed( &( xTlsRuntime.ctrDrgbContext ),
+                                                       mbedtls_entropy_func,
+                                                       &( xTlsRuntime.entropyContext ),
+                                                       NULL,
+                                                       0 );
+
+                if( lMbedtlsError != 0 )
+                {
+                    LogError( ( "Failed to seed PRNG: lMbedtlsError[%d]= %s : %s.",
+                                lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                                mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+                    xRetVal = eTLSTransportInternalError;
+                }
+            }
+
+            #if ( MBEDTLS_VERSION_MAJOR >= 3 ) && defined( MBEDTLS_PSA_CRYPTO_C )
+                /* TLS 1.3 and the PSA backed ciphers of mbed TLS 3.x need the
+                 * PSA crypto core, which seeds its own random generator. */
+                if( ( xRetVal == eTLSTransportSuccess ) && ( psa_crypto_init() != PSA_SUCCESS ) )
+                {
+                    LogError( ( "Failed to initialize PSA crypto." ) );
+                    xRetVal = eTLSTransportInternalError;
+                }
+            #endif
+
+            #if defined( MBEDTLS_ECDH_GEN_PUBLIC_ALT )
+                /* Generate ECDHE keys while idle, so that reconnects find one
+                 * ready. Handshakes generate their own if this fails. */
+                if( ( xRetVal == eTLSTransportSuccess ) &&
+                    ( mbedtls_platform_ecdhe_start( runtimeRandom, &xTlsRuntime ) != 0 ) )
+                {
+                    LogWarn( ( "Failed to start ECDHE key precomputation." ) );
+                }
+            #endif
+
+            if( xRetVal == eTLSTransportSuccess )
+            {
+                xTlsRuntime.xLastReseed = xTaskGetTickCount();
+                xTlsRuntime.xInitialized = pdTRUE;
+                LogDebug( ( "Successfully initialized mbedTLS." ) );
+            }
+            else if( xTlsRuntime.xRandomMutex != NULL )
+            {
+                /* Leave the runtime ready for the next connection to retry. */
+                mbedtls_ctr_drbg_free( &( xTlsRuntime.ctrDrgbContext ) );
+                mbedtls_entropy_free( &( xTlsRuntime.entropyContext ) );
+            }
+        }
+
+        ( void ) xSemaphoreGive( xTransportMutex );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+static int runtimeRandom( void * pvContext,
+                          unsigned char * pucOutput,
+                          size_t xOutputLength )
+{
+    TlsRuntime_t * pxRuntime = ( TlsRuntime_t * ) pvContext;
+    int lMbedtlsError = MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+
+    configASSERT( pxRuntime != NULL );
+
+    if( xSemaphoreTake( pxRuntime->xRandomMutex, portMAX_DELAY ) == pdTRUE )
+    {
+        if( ( xTaskGetTickCount() - pxRuntime->xLastReseed ) >=
+            pdMS_TO_TICKS( TLS_TRANSPORT_DRBG_RESEED_INTERVAL_MS ) )
+        {
+            lMbedtlsError = mbedtls_ctr_drbg_reseed( &( pxRuntime->ctrDrgbContext ), NULL, 0 );
+
+            if( lMbedtlsError != 0 )
+            {
+                /* Keep using the current seed, mbed TLS still enforces its
+                 * own reseed interval. */
+                LogWarn( ( "Failed to reseed PRNG: lMbedtlsError[%d]= %s : %s.",
+                           lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                           mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+            }
+            else
+            {
+                pxRuntime->xLastReseed = xTaskGetTickCount();
+            }
+        }
+
+        lMbedtlsError = mbedtls_ctr_drbg_random( &( pxRuntime->ctrDrgbContext ),
+                                                 pucOutput,
+                                                 xOutputLength );
+
+        ( void ) xSemaphoreGive( pxRuntime->xRandomMutex );
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static void histogramAdd( uint32_t * pulBuckets,
+                          uint32_t ulMs )
+{
+    uint32_t ulBucket = 0;
+    uint32_t ulBound = TLS_TRANSPORT_HISTOGRAM_FIRST_BUCKET_MS;
+
+    while( ( ulBucket < ( TLS_TRANSPORT_HISTOGRAM_BUCKETS - 1 ) ) && ( ulMs >= ulBound ) )
+    {
+        ulBucket++;
+        ulBound <<= 1;
+    }
+
+    pulBuckets[ ulBucket ]++;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t handshakeStateMs( const TlsConnectMetrics_t * pxMetrics,
+                                  int32_t lState )
+{
+    uint32_t ulMs = 0;
+
+    if( ( lState >= 0 ) && ( lState < TLS_TRANSPORT_HANDSHAKE_STATES ) )
+    {
+        ulMs = pxMetrics->ulStateMs[ lState ];
+    }
+
+    return ulMs;
+}
+/*-----------------------------------------------------------*/
+
+static void connectMetricsRecord( MbedSSLContext_t * pxSslContext,
+                                  BaseType_t xConnected )
+{
+    TlsConnectMetrics_t * pxMetrics = &( pxSslContext->xConnectMetrics );
+
+    LogInfo( ( "TLS connection to %s %s: dns=%u ms, tcp=%u ms, handshake=%u ms, "
+               "certificate=%u ms, key exchange=%u ms, resumed=%d, tls13=%d.",
+               pxSslContext->xConnect.pcHostName,
+               ( xConnected == pdTRUE ) ? "established" : "failed",
+               ( unsigned ) pxMetrics->ulDnsMs, ( unsigned ) pxMetrics->ulTcpConnectMs,
+               ( unsigned ) pxMetrics->ulHandshakeMs, ( unsigned ) pxMetrics->ulCertificateMs,
+               ( unsigned ) pxMetrics->ulKeyExchangeMs, ( int ) pxMetrics->xResumed,
+               ( int ) pxMetrics->xTls13 ) );
+
+    if( transportLock() == pdTRUE )
+    {
+        if( xConnected == pdTRUE )
+        {
+            xConnectHistogram.ulConnects++;
+            histogramAdd( xConnectHistogram.ulDnsMs, pxMetrics->ulDnsMs );
+            histogramAdd( xConnectHistogram.ulTcpConnectMs, pxMetrics->ulTcpConnectMs );
+            histogramAdd( xConnectHistogram.ulHandshakeMs, pxMetrics->ulHandshakeMs );
+            histogramAdd( xConnectHistogram.ulTotalMs, pxMetrics->ulTotalMs );
+        }
+        else
+        {
+            xConnectHistogram.ulFailures++;
+        }
+
+        ( void ) xSemaphoreGive( xTransportMutex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void connectAbort( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams = pxNetworkContext->pParams;
+    MbedSSLContext_t * pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+
+    sslContextFree( pxSSLContext );
+    sslContextRelease( pxSSLContext );
+    pxTlsTransportParams->xSSLContext = NULL;
+
+    if( pxTlsTransportParams->xTCPSocket != SOCKETS_INVALID_SOCKET )
+    {
+        ( void ) Sockets_Disconnect( pxTlsTransportParams->xTCPSocket );
+        ( void ) Sockets_Close( pxTlsTransportParams->xTCPSocket );
+        pxTlsTransportParams->xTCPSocket = SOCKETS_INVALID_SOCKET;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t connectTcpEstablished( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams = pxNetworkContext->pParams;
+    MbedSSLContext_t * pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+    TlsConnectState_t * pxConnect = &( pxSSLContext->xConnect );
+    TlsTransportStatus_t xRetVal;
+    BaseType_t xSocketStatus;
+    TickType_t xPollTimeout = TLS_TRANSPORT_CONNECT_POLL_TICKS;
+
+    /* TLS_Socket_Connect has nothing else to do while the server answers. */
+    if( pxConnect->xBlocking == pdTRUE )
+    {
+        xPollTimeout = pxConnect->xRecvTimeout;
+    }
+
+    pxSSLContext->xConnectMetrics.ulTcpConnectMs = tlsTICKS_TO_MS( xTaskGetTickCount() - pxConnect->xTcpStart );
+
+    if( ( xRetVal = initMbedtls() ) != eTLSTransportSuccess )
+    {
+        LogError( ( "Failed to initialize Mbedtls %d.", xRetVal ) );
+    }
+    else if( ( xRetVal = tlsSetup( pxNetworkContext, pxConnect->pcHostName,
+                                   pxConnect->pxNetworkCredentials ) ) != eTLSTransportSuccess )
+    {
+        LogError( ( "Failed to setup Mbedtls %d.", xRetVal ) );
+    }
+    else if( ( xRetVal = tlsHandshakeStart( pxNetworkContext, pxConnect->pcHostName,
+                                            pxConnect->usPort ) ) != eTLSTransportSuccess )
+    {
+        LogError( ( "Failed to start TLS handshake %d.", xRetVal ) );
+    }
+    else if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
+                                                   SOCKETS_SO_RCVTIMEO,
+                                                   &xPollTimeout,
+                                                   sizeof( xPollTimeout ) ) ) != 0 )
+    {
+        LogError( ( "Failed to set receive timeout on socket %d.", xSocketStatus ) );
+        xRetVal = eTLSTransportInternalError;
+    }
+    else
+    {
+        pxConnect->xLastProgress = xTaskGetTickCount();
+        pxConnect->xHandshakeStart = pxConnect->xLastProgress;
+        pxConnect->xStateStart = pxConnect->xLastProgress;
+        pxConnect->xStep = eTlsConnectHandshake;
+        xRetVal = eTLSTransportInProgress;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_ConnectStart( NetworkContext_t * pxNetworkContext,
+                                              const char * pcHostName,
+                                              uint16_t usPort,
+                                              const NetworkCredentials_t * pxNetworkCredentials,
+                                              uint32_t ulReceiveTimeoutMs,
+                                              uint32_t ulSendTimeoutMs )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    BaseType_t xSocketStatus = 0;
+    MbedSSLContext_t * pxSSLContext;
+    TickType_t xRecvTimeout = pdMS_TO_TICKS( ulReceiveTimeoutMs );
+    TickType_t xSendTimeout = pdMS_TO_TICKS( ulSendTimeoutMs );
+
+    #if ( TLS_TRANSPORT_TCP_NODELAY == 1 )
+        uint32_t ulNoDelay = 1;
+    #endif
+
+    if( ( pxNetworkContext == NULL ) ||
+        ( pxNetworkContext->pParams == NULL ) ||
+        ( pcHostName == NULL ) ||
+        ( pxNetworkCredentials == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pxNetworkContext=%p, "
+                    "pcHostName=%p, pxNetworkCredentials=%p.",
+                    pxNetworkContext,
+                    pcHostName,
+                    pxNetworkCredentials ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else if( ( pxNetworkCredentials->pucRootCa == NULL ) )
+    {
+        LogError( ( "pucRootCa cannot be NULL." ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else if( ( pxSSLContext = sslContextAlloc() ) == NULL )
+    {
+        LogError( ( "Failed to allocate mbed ssl context memory." ) );
+        xRetVal = eTLSTransportInSufficientMemory;
+    }
+    else
+    {
+        /* Zeroed mbed TLS contexts are safe to free if setup fails early. */
+        ( void ) memset( pxSSLContext, 0, sizeof( MbedSSLContext_t ) );
+
+        #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+            if( ( pxSSLContext->lHeapAccount = mbedtls_platform_heap_stats_open() ) < 0 )
+            {
+                LogWarn( ( "No heap account free, heap of this connection is not counted." ) );
+            }
+        #endif
+
+        pxTlsTransportParams = pxNetworkContext->pParams;
+        pxTlsTransportParams->xSSLContext = ( SSLContextHandle ) pxSSLContext;
+
+        if( ( pxTlsTransportParams->xTCPSocket = Sockets_Open() ) == SOCKETS_INVALID_SOCKET )
+        {
+            LogError( ( "Failed to open socket." ) );
+            xRetVal = eTLSTransportConnectFailure;
+        }
+        else if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
+                                                       SOCKETS_SO_RCVTIMEO,
+                                                       &xRecvTimeout,
+                                                       sizeof( xRecvTimeout ) ) != 0 ) )
+        {
+            LogError( ( "Failed to set receive timeout on socket %d.", xSocketStatus ) );
+            xRetVal = eTLSTransportInternalError;
+        }
+        else if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
+                                                       SOCKETS_SO_SNDTIMEO,
+                                                       &xSendTimeout,
+                                                       sizeof( xSendTimeout ) ) != 0 ) )
+        {
+            LogError( ( "Failed to set send timeout on socket %d.", xSocketStatus ) );
+            xRetVal = eTLSTransportInternalError;
+        }
+        else
+        {
+            #if ( TLS_TRANSPORT_TCP_NODELAY == 1 )
+                /* Stacks that never delay small segments do not know the
+                 * option, which is fine. */
+                if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
+                                                          SOCKETS_SO_NODELAY,
+                                                          &ulNoDelay,
+                                                          sizeof( ulNoDelay ) ) ) != 0 )
+                {
+                    LogDebug( ( "TCP_NODELAY not set on socket %d.", xSocketStatus ) );
+                }
+            #endif
+
+            pxSSLContext->xConnect.xStep = eTlsConnectTcp;
+            pxSSLContext->xConnect.pcHostName = pcHostName;
+            pxSSLContext->xConnect.usPort = usPort;
+            pxSSLContext->xConnect.pxNetworkCredentials = pxNetworkCredentials;
+            pxSSLContext->xConnect.xSocket = pxTlsTransportParams->xTCPSocket;
+            pxSSLContext->xConnect.xRecvTimeout = xRecvTimeout;
+            pxSSLContext->xConnect.xStart = xTaskGetTickCount();
+        }
+
+        /* Clean up on failure. */
+        if( xRetVal != eTLSTransportSuccess )
+        {
+            connectAbort( pxNetworkContext );
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_ConnectPoll( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    BaseType_t xSocketStatus = 0;
+    MbedSSLContext_t * pxSSLContext;
+    TlsConnectState_t * pxConnect;
+    SocketsConnectTimes_t xConnectTimes = { 0 };
+    TickType_t xElapsed;
+    TickType_t xWait;
+
+    if( ( pxNetworkContext == NULL ) ||
+        ( pxNetworkContext->pParams == NULL ) ||
+        ( pxNetworkContext->pParams->xSSLContext == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): pxNetworkContext=%p.", pxNetworkContext ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else
+    {
+        pxTlsTransportParams = pxNetworkContext->pParams;
+        pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+        pxConnect = &( pxSSLContext->xConnect );
+
+        switch( pxConnect->xStep )
+        {
+            case eTlsConnectTcp:
+
+                /* Only the host name lookup may block here, the server is
+                 * waited for in the next step. */
+                xSocketStatus = Sockets_ConnectStart( pxTlsTransportParams->xTCPSocket,
+                                                      pxConnect->pcHostName,
+                                                      pxConnect->usPort,
+                                                      &xConnectTimes );
+                pxSSLContext->xConnectMetrics.ulDnsMs = tlsTICKS_TO_MS( xConnectTimes.xResolveTicks );
+                pxConnect->xTcpStart = xTaskGetTickCount() - xConnectTimes.xConnectTicks;
+
+                if( xSocketStatus == SOCKETS_EWOULDBLOCK )
+                {
+                    pxConnect->xStep = eTlsConnectTcpWait;
+                    xRetVal = eTLSTransportInProgress;
+                }
+                else if( xSocketStatus != 0 )
+                {
+                    LogError( ( "Failed to connect to %s with error %d.",
+                                pxConnect->pcHostName,
+                                xSocketStatus ) );
+                    xRetVal = eTLSTransportConnectFailure;
+                }
+                else
+                {
+                    xRetVal = connectTcpEstablished( pxNetworkContext );
+                }
+
+                break;
+
+            case eTlsConnectTcpWait:
+                xElapsed = xTaskGetTickCount() - pxConnect->xTcpStart;
+
+                if( pxConnect->xBlocking == pdTRUE )
+                {
+                    xWait = ( xElapsed < SOCKETS_CONNECT_TIMEOUT_TICKS ) ? ( SOCKETS_CONNECT_TIMEOUT_TICKS - xElapsed ) : 0U;
+                }
+                else
+                {
+                    xWait = TLS_TRANSPORT_CONNECT_POLL_TICKS;
+                }
+
+                xSocketStatus = Sockets_ConnectPoll( pxTlsTransportParams->xTCPSocket, xWait );
+
+                if( xSocketStatus == 0 )
+                {
+                    xRetVal = connectTcpEstablished( pxNetworkContext );
+                }
+                else if( ( xSocketStatus == SOCKETS_EWOULDBLOCK ) &&
+                         ( ( xTaskGetTickCount() - pxConnect->xTcpStart ) < SOCKETS_CONNECT_TIMEOUT_TICKS ) )
+                {
+                    xRetVal = eTLSTransportInProgress;
+                }
+                else
+                {
+                    LogError( ( "Failed to connect to %s with error %d.",
+                                pxConnect->pcHostName,
+                                xSocketStatus ) );
+
+                    /* The next attempt resolves the name again, which may
+                     * give a front end that answers. */
+                    SocketsDnsCache_Invalidate( pxConnect->pcHostName );
+                    pxSSLContext->xConnectMetrics.ulTcpConnectMs = tlsTICKS_TO_MS( xTaskGetTickCount() - pxConnect->xTcpStart );
+                    xRetVal = eTLSTransportConnectFailure;
+                }
+
+                break;
+
+            case eTlsConnectHandshake:
+
+                if( ( xRetVal = tlsHandshakeStep( pxNetworkContext ) ) != eTLSTransportSuccess )
+                {
+                    if( xRetVal != eTLSTransportInProgress )
+                    {
+                        LogError( ( "Failed to do TLS handshake %d.", xRetVal ) );
+                    }
+                }
+                else if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
+                                                               SOCKETS_SO_RCVTIMEO,
+                                                               &( pxConnect->xRecvTimeout ),
+                                                               sizeof( pxConnect->xRecvTimeout ) ) ) != 0 )
+                {
+                    LogError( ( "Failed to set receive timeout on socket %d.", xSocketStatus ) );
+                    xRetVal = eTLSTransportInternalError;
+                }
+                else
+                {
+                    LogInfo( ( "(Network connection %p) Connection to %s established.",
+                               pxNetworkContext,
+                               pxConnect->pcHostName ) );
+
+                    pxSSLContext->xConnectMetrics.ulTotalMs = tlsTICKS_TO_MS( xTaskGetTickCount() - pxConnect->xStart );
+                    connectMetricsRecord( pxSSLContext, pdTRUE );
+
+                    /* The caller's buffers are no longer needed. */
+                    pxConnect->pcHostName = NULL;
+                    pxConnect->pxNetworkCredentials = NULL;
+                    pxConnect->xStep = eTlsConnectDone;
+                }
+
+                break;
+
+            default:
+                /* Already connected. */
+                break;
+        }
+
+        /* Clean up on failure. */
+        if( ( xRetVal != eTLSTransportSuccess ) && ( xRetVal != eTLSTransportInProgress ) )
+        {
+            connectMetricsRecord( pxSSLContext, pdFALSE );
+            connectAbort( pxNetworkContext );
+        }
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pxNetworkContext,
+                                         const char * pcHostName,
+                                         uint16_t usPort,
+                                         const NetworkCredentials_t * pxNetworkCredentials,
+                                         uint32_t ulReceiveTimeoutMs,
+                                         uint32_t ulSendTimeoutMs )
+{
+    TlsTransportStatus_t xRetVal;
+
+    xRetVal = TLS_Socket_ConnectStart( pxNetworkContext, pcHostName, usPort,
+                                       pxNetworkCredentials,
+                                       ulReceiveTimeoutMs, ulSendTimeoutMs );
+
+    /* Each poll waits for the server for the rest of the connect timeout, or
+     * for the receive timeout during the handshake, rather than the
+     * #TLS_TRANSPORT_CONNECT_POLL_TICKS of a caller that polls. */
+    if( xRetVal == eTLSTransportSuccess )
+    {
+        ( ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext )->xConnect.xBlocking = pdTRUE;
+
+        do
+        {
+            xRetVal = TLS_Socket_ConnectPoll( pxNetworkContext );
+        } while( xRetVal == eTLSTransportInProgress );
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_Socket_Disconnect( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams = NULL;
+    int32_t lMbedtlsError = 0;
+    MbedSSLContext_t * pxSSLContext;
+
+    if( ( pxNetworkContext != NULL ) && ( pxNetworkContext->pParams != NULL ) &&
+        ( pxNetworkContext->pParams->xSSLContext != NULL ) )
+    {
+        pxTlsTransportParams = pxNetworkContext->pParams;
+        pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
+
+        /* A connection abandoned during setup has no TLS session to close. */
+        if( pxSSLContext->xConnect.xStep == eTlsConnectDone )
+        {
+            /* Best effort to send coalesced writes before closing. */
+            ( void ) sendBufferFlush( pxSSLContext );
+
+            /* Attempting to terminate TLS connection. */
+            lMbedtlsError = mbedtls_ssl_close_notify( &( pxSSLContext->context ) );
+
+            /* Ignore the WANT_READ and WANT_WRITE return values. */
+            if( ( lMbedtlsError != MBEDTLS_ERR_SSL_WANT_READ ) &&
+                ( lMbedtlsError != MBEDTLS_ERR_SSL_WANT_WRITE ) )
+            {
+                if( lMbedtlsError == 0 )
+                {
+                    LogInfo( ( "(Network connection %p) TLS close-notify sent.",
+                               pxNetworkContext ) );
+                }
+                else
+                {
+                    LogError( ( "(Network connection %p) Failed to send TLS close-notify: mbedTLSError[%d]= %s : %s.",
+                                pxNetworkContext, lMbedtlsError,
+                                mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                                mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+                }
+            }
+            else
+            {
+                /* WANT_READ and WANT_WRITE can be ignored. Logging for debugging purposes. */
+                LogInfo( ( "(Network connection %p) TLS close-notify sent; "
+                           "received %s as the TLS status can be ignored for close-notify.",
+                           pxNetworkContext,
+                           ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ? "WANT_READ" : "WANT_WRITE" ) );
+            }
+        }
+
+        /* Call socket shutdown function to close connection. */
+        Sockets_Disconnect( pxTlsTransportParams->xTCPSocket );
+        Sockets_Close( pxTlsTransportParams->xTCPSocket );
+        pxTlsTransportParams->xTCPSocket = SOCKETS_INVALID_SOCKET;
+
+        /* Free mbed TLS contexts. The pool slot may be handed to another
+         * connection, so the context must not be reached from here again. */
+        sslContextFree( pxSSLContext );
+        sslContextRelease( pxSSLContext );
+        pxTlsTransportParams->xSSLContext = NULL;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static int32_t sslRead( MbedSSLContext_t * pxSslContext,
+                        uint8_t * pucBuffer,
+                        size_t xBytesToRecv )
+{
+    int32_t lMbedtlsError = 0;
+
+    pxSslContext->xRecvStats.ulTlsReads++;
+    tlsHEAP_STATS_ATTACH( pxSslContext );
+    lMbedtlsError = ( int32_t ) mbedtls_ssl_read( &( pxSslContext->context ),
+                                                  pucBuffer,
+                                                  xBytesToRecv );
+    tlsHEAP_STATS_DETACH();
+
+    if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
+        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+    {
+        LogDebug( ( "Failed to read data. However, a read can be retried on this error. "
+                    "mbedTLSError[%d]= %s : %s.", lMbedtlsError,
+                    mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+
+        /* Mark these set of errors as a timeout. The libraries may retry read
+         * on these errors. */
+        lMbedtlsError = 0;
+    }
+
+    #if defined( MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET )
+        else if( lMbedtlsError == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET )
+        {
+            #if ( tlsTLS13_AVAILABLE == 1 ) && ( TLS_TRANSPORT_SESSION_CACHE_ENTRIES > 0 )
+                if( pxSslContext->pcTicketHostName != NULL )
+                {
+                    sessionCacheStore( pxSslContext, pxSslContext->pcTicketHostName,
+                                       pxSslContext->usTicketPort );
+                }
+            #endif
+
+            /* No application data, the read can be retried. */
+            lMbedtlsError = 0;
+        }
+    #endif
+    else if( lMbedtlsError < 0 )
+    {
+        LogError( ( "Failed to read data: mbedTLSError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
+                         void * pvBuffer,
+                         size_t xBytesToRecv )
+{
+    int32_t lMbedtlsError = 0;
+    MbedSSLContext_t * pxSSLContext;
+
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) &&
+                  ( pxNetworkContext->pParams->xSSLContext != NULL ) );
+
+    pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
+    configASSERT( pxSSLContext->pucBorrowed == NULL );
+    pxSSLContext->xRecvStats.ulRecvCalls++;
 
-static int32_t setPrivateKey( MbedSSLContext_t * pxSslContext,
-                              const uint8_t * pucPrivateKey,
-                              size_t xPrivateKeySize )
-{
-    int32_t lMbedtlsError = -1;
+    /* The peer cannot answer data it has not received, so coalesced
+     * writes go out before waiting for a read. */
+    lMbedtlsError = sendBufferFlush( pxSSLContext );
 
-    configASSERT( pxSslContext != NULL );
-    configASSERT( pucPrivateKey != NULL );
+    if( lMbedtlsError >= 0 )
+    {
+        #if ( TLS_TRANSPORT_READ_AHEAD_SIZE > 0 )
+            if( pxSSLContext->xReadAheadLength > 0 )
+            {
+                pxSSLContext->xRecvStats.ulBufferedReads++;
+            }
+            else if( xBytesToRecv < sizeof( pxSSLContext->ucReadAhead ) )
+            {
+                /* Decrypt as much as fits, so the following small reads do not
+                 * go through the TLS layer. */
+                lMbedtlsError = sslRead( pxSSLContext,
+                                         pxSSLContext->ucReadAhead,
+                                         sizeof( pxSSLContext->ucReadAhead ) );
 
-    /* Setup the client private key. */
-    lMbedtlsError = mbedtls_pk_parse_key( &( pxSslContext->privKey ),
-                                          pucPrivateKey,
-                                          xPrivateKeySize,
-                                          NULL,
-                                          0 );
+                if( lMbedtlsError > 0 )
+                {
+                    pxSSLContext->xReadAheadOffset = 0;
+                    pxSSLContext->xReadAheadLength = ( size_t ) lMbedtlsError;
+                }
+            }
+            else
+            {
+                /* Large reads bypass the buffer to avoid a second copy. */
+                lMbedtlsError = sslRead( pxSSLContext, pvBuffer, xBytesToRecv );
+            }
 
-    if( lMbedtlsError != 0 )
+            if( pxSSLContext->xReadAheadLength > 0 )
+            {
+                lMbedtlsError = ( int32_t ) ( ( xBytesToRecv < pxSSLContext->xReadAheadLength ) ?
+                                              xBytesToRecv : pxSSLContext->xReadAheadLength );
+                ( void ) memcpy( pvBuffer,
+                                 &( pxSSLContext->ucReadAhead[ pxSSLContext->xReadAheadOffset ] ),
+                                 ( size_t ) lMbedtlsError );
+                pxSSLContext->xReadAheadOffset += ( size_t ) lMbedtlsError;
+                pxSSLContext->xReadAheadLength -= ( size_t ) lMbedtlsError;
+            }
+        #else /* if ( TLS_TRANSPORT_READ_AHEAD_SIZE > 0 ) */
+            lMbedtlsError = sslRead( pxSSLContext, pvBuffer, xBytesToRecv );
+        #endif /* if ( TLS_TRANSPORT_READ_AHEAD_SIZE > 0 ) */
+    }
+
+    if( lMbedtlsError > 0 )
     {
-        LogError( ( "Failed to parse the client key: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+        pxSSLContext->xRecvStats.ulBytesReceived += ( uint32_t ) lMbedtlsError;
     }
 
     return lMbedtlsError;
 }
 /*-----------------------------------------------------------*/
 
-static int32_t setCredentials( MbedSSLContext_t * pxSslContext,
-                               const NetworkCredentials_t * pxNetworkCredentials )
+int32_t TLS_Socket_RecvBorrow( NetworkContext_t * pxNetworkContext,
+                               const uint8_t ** ppucData )
 {
-    int32_t lMbedtlsError = -1;
+    int32_t lMbedtlsError = 0;
+    MbedSSLContext_t * pxSSLContext;
+    mbedtls_ssl_context * pxContext;
+    uint8_t ucUnused = 0;
 
-    configASSERT( pxSslContext != NULL );
-    configASSERT( pxNetworkCredentials != NULL );
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) &&
+                  ( pxNetworkContext->pParams->xSSLContext != NULL ) &&
+                  ( ppucData != NULL ) );
 
-    /* Set up the certificate security profile, starting from the default value. */
-    pxSslContext->certProfile = mbedtls_x509_crt_profile_default;
+    pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
+    pxContext = &( pxSSLContext->context );
 
-    /* Set SSL authmode and the RNG context. */
-    mbedtls_ssl_conf_authmode( &( pxSslContext->config ),
-                               MBEDTLS_SSL_VERIFY_REQUIRED );
-    mbedtls_ssl_conf_rng( &( pxSslContext->config ),
-                          mbedtls_ctr_drbg_random,
-                          &( pxSslContext->ctrDrgbContext ) );
-    mbedtls_ssl_conf_cert_profile( &( pxSslContext->config ),
-                                   &( pxSslContext->certProfile ) );
-
-    lMbedtlsError = setRootCa( pxSslContext,
-                               pxNetworkCredentials->pucRootCa,
-                               pxNetworkCredentials->xRootCaSize );
-
-    if( ( pxNetworkCredentials->pucClientCert != NULL ) &&
-        ( pxNetworkCredentials->pucPrivateKey != NULL ) )
+    if( pxSSLContext->pucBorrowed == NULL )
     {
-        if( lMbedtlsError == 0 )
-        {
-            lMbedtlsError = setClientCertificate( pxSslContext,
-                                                  pxNetworkCredentials->pucClientCert,
-                                                  pxNetworkCredentials->xClientCertSize );
-        }
+        pxSSLContext->xRecvStats.ulRecvCalls++;
+        lMbedtlsError = sendBufferFlush( pxSSLContext );
 
-        if( lMbedtlsError == 0 )
-        {
-            lMbedtlsError = setPrivateKey( pxSslContext,
-                                           pxNetworkCredentials->pucPrivateKey,
-                                           pxNetworkCredentials->xPrivateKeySize );
-        }
+        #if ( TLS_TRANSPORT_READ_AHEAD_SIZE > 0 )
+            if( ( lMbedtlsError >= 0 ) && ( pxSSLContext->xReadAheadLength > 0 ) )
+            {
+                /* Data decrypted by an earlier TLS_Socket_Recv comes first. */
+                pxSSLContext->xRecvStats.ulBufferedReads++;
+                pxSSLContext->pucBorrowed = &( pxSSLContext->ucReadAhead[ pxSSLContext->xReadAheadOffset ] );
+                pxSSLContext->xBorrowedLength = pxSSLContext->xReadAheadLength;
+            }
+        #endif
 
-        if( lMbedtlsError == 0 )
+        if( ( lMbedtlsError >= 0 ) && ( pxSSLContext->pucBorrowed == NULL ) )
         {
-            lMbedtlsError = mbedtls_ssl_conf_own_cert( &( pxSslContext->config ),
-                                                       &( pxSslContext->clientCert ),
-                                                       &( pxSslContext->privKey ) );
+            /* A zero length read decrypts the next record in place without
+             * consuming any of it. */
+            lMbedtlsError = sslRead( pxSSLContext, &ucUnused, 0 );
+
+            if( ( lMbedtlsError == 0 ) && ( tlsSSL_IN_OFFT( pxContext ) != NULL ) )
+            {
+                pxSSLContext->pucBorrowed = tlsSSL_IN_OFFT( pxContext );
+                pxSSLContext->xBorrowedLength = tlsSSL_IN_MSGLEN( pxContext );
+            }
         }
     }
 
+    if( ( lMbedtlsError >= 0 ) && ( pxSSLContext->pucBorrowed != NULL ) )
+    {
+        *ppucData = pxSSLContext->pucBorrowed;
+        lMbedtlsError = ( int32_t ) pxSSLContext->xBorrowedLength;
+    }
+
     return lMbedtlsError;
 }
 /*-----------------------------------------------------------*/
 
-static void setOptionalConfigurations( MbedSSLContext_t * pxSslContext,
-                                       const char * pcHostName,
-                                       const NetworkCredentials_t * pxNetworkCredentials )
+TlsTransportStatus_t TLS_Socket_RecvRelease( NetworkContext_t * pxNetworkContext,
+                                             size_t xBytesConsumed )
 {
-    int32_t lMbedtlsError = -1;
-
-    configASSERT( pxSslContext != NULL );
-    configASSERT( pcHostName != NULL );
-    configASSERT( pxNetworkCredentials != NULL );
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    MbedSSLContext_t * pxSSLContext = NULL;
+    mbedtls_ssl_context * pxContext;
+    BaseType_t xFromRecord = pdTRUE;
 
-    if( pxNetworkCredentials->ppcAlpnProtos != NULL )
+    if( ( pxNetworkContext != NULL ) && ( pxNetworkContext->pParams != NULL ) )
     {
-        /* Include an application protocol list in the TLS ClientHello
-         * message. */
-        lMbedtlsError = mbedtls_ssl_conf_alpn_protocols( &( pxSslContext->config ),
-                                                         pxNetworkCredentials->ppcAlpnProtos );
-
-        if( lMbedtlsError != 0 )
-        {
-            LogError( ( "Failed to configure ALPN protocol in mbed TLS: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-        }
+        pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
     }
 
-    /* Enable SNI if requested. */
-    if( pxNetworkCredentials->xDisableSni == pdFALSE )
+    if( ( pxSSLContext == NULL ) || ( pxSSLContext->pucBorrowed == NULL ) ||
+        ( xBytesConsumed > pxSSLContext->xBorrowedLength ) )
     {
-        lMbedtlsError = mbedtls_ssl_set_hostname( &( pxSslContext->context ),
-                                                  pcHostName );
-
-        if( lMbedtlsError != 0 )
-        {
-            LogError( ( "Failed to set server name: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-        }
+        LogError( ( "Invalid input parameter(s): pxNetworkContext=%p, xBytesConsumed=%u.",
+                    pxNetworkContext, ( unsigned int ) xBytesConsumed ) );
+        xRetVal = eTLSTransportInvalidParameter;
     }
+    else
+    {
+        pxContext = &( pxSSLContext->context );
 
-    /* Set Maximum Fragment Length if enabled. */
-    #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
-
-        /* Enable the max fragment extension. 4096 bytes is currently the largest fragment size permitted.
-         * See RFC 8449 https://tools.ietf.org/html/rfc8449 for more information.
-         *
-         * Smaller values can be found in "mbedtls/include/ssl.h".
-         */
-        lMbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pxSslContext->config ), MBEDTLS_SSL_MAX_FRAG_LEN_4096 );
+        #if ( TLS_TRANSPORT_READ_AHEAD_SIZE > 0 )
+            if( pxSSLContext->pucBorrowed == &( pxSSLContext->ucReadAhead[ pxSSLContext->xReadAheadOffset ] ) )
+            {
+                pxSSLContext->xReadAheadOffset += xBytesConsumed;
+                pxSSLContext->xReadAheadLength -= xBytesConsumed;
+                xFromRecord = pdFALSE;
+            }
+        #endif
 
-        if( lMbedtlsError != 0 )
+        if( xFromRecord == pdTRUE )
         {
-            LogError( ( "Failed to maximum fragment length extension: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+            /* Consume the data the way mbedtls_ssl_read does, so the next
+             * read continues after it or moves on to the next record. */
+            mbedtls_platform_zeroize( tlsSSL_IN_OFFT( pxContext ), xBytesConsumed );
+            tlsSSL_IN_MSGLEN( pxContext ) -= xBytesConsumed;
+
+            if( tlsSSL_IN_MSGLEN( pxContext ) == 0 )
+            {
+                tlsSSL_IN_OFFT( pxContext ) = NULL;
+                tlsSSL_KEEP_CURRENT_MESSAGE( pxContext ) = 0;
+            }
+            else
+            {
+                tlsSSL_IN_OFFT( pxContext ) += xBytesConsumed;
+            }
         }
-    #endif /* ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
+
+        pxSSLContext->xRecvStats.ulBytesReceived += ( uint32_t ) xBytesConsumed;
+        pxSSLContext->pucBorrowed = NULL;
+        pxSSLContext->xBorrowedLength = 0;
+    }
+
+    return xRetVal;
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
-                                      const char * pcHostName,
-                                      const NetworkCredentials_t * pxNetworkCredentials )
+TlsTransportStatus_t TLS_Socket_GetRecvStats( NetworkContext_t * pxNetworkContext,
+                                              TlsTransportRecvStats_t * pxStats )
 {
-    TlsTransportParams_t * pxTlsTransportParams = NULL;
     TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
-    int32_t lMbedtlsError = 0;
-    MbedSSLContext_t * pxSSLContext = NULL;
 
-    configASSERT( pxNetworkContext != NULL );
-    configASSERT( pxNetworkContext->pParams != NULL );
-    configASSERT( pxNetworkContext->pParams->xSSLContext != NULL );
-    configASSERT( pcHostName != NULL );
-    configASSERT( pxNetworkCredentials != NULL );
-    configASSERT( pxNetworkCredentials->pucRootCa != NULL );
+    if( ( pxNetworkContext == NULL ) || ( pxNetworkContext->pParams == NULL ) ||
+        ( pxNetworkContext->pParams->xSSLContext == NULL ) || ( pxStats == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): pxNetworkContext=%p, pxStats=%p.",
+                    pxNetworkContext, pxStats ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else
+    {
+        *pxStats = ( ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext )->xRecvStats;
+    }
 
-    pxTlsTransportParams = pxNetworkContext->pParams;
-    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
 
-    /* Initialize the mbed TLS context structures. */
-    sslContextInit( pxSSLContext );
+int32_t TLS_Socket_Poll( NetworkContext_t * pxNetworkContext,
+                         TickType_t xTimeoutTicks )
+{
+    int32_t lRetVal = 0;
+    MbedSSLContext_t * pxSSLContext;
+    mbedtls_ssl_context * pxContext;
+    BaseType_t xPending;
 
-    lMbedtlsError = mbedtls_ssl_config_defaults( &( pxSSLContext->config ),
-                                                 MBEDTLS_SSL_IS_CLIENT,
-                                                 MBEDTLS_SSL_TRANSPORT_STREAM,
-                                                 MBEDTLS_SSL_PRESET_DEFAULT );
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) &&
+                  ( pxNetworkContext->pParams->xSSLContext != NULL ) );
 
-    if( lMbedtlsError != 0 )
-    {
-        LogError( ( "Failed to set default SSL configuration: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+    pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
+    pxContext = &( pxSSLContext->context );
 
-        /* Per mbed TLS docs, mbedtls_ssl_config_defaults only fails on memory allocation. */
-        xRetVal = eTLSTransportInSufficientMemory;
-    }
+    lRetVal = sendBufferFlush( pxSSLContext );
 
-    if( xRetVal == eTLSTransportSuccess )
+    if( lRetVal >= 0 )
     {
-        lMbedtlsError = setCredentials( pxSSLContext,
-                                        pxNetworkCredentials );
+        /* Borrowed data not yet released, data in the read-ahead buffer, the
+         * rest of a decrypted record, and records mbed TLS read from the
+         * socket but has not decrypted yet are all there without the socket
+         * becoming readable. */
+        xPending = ( pxSSLContext->pucBorrowed != NULL ) ? pdTRUE : pdFALSE;
+
+        #if ( TLS_TRANSPORT_READ_AHEAD_SIZE > 0 )
+            if( pxSSLContext->xReadAheadLength > 0 )
+            {
+                xPending = pdTRUE;
+            }
+        #endif
 
-        if( lMbedtlsError != 0 )
+        if( ( mbedtls_ssl_get_bytes_avail( pxContext ) > 0 ) ||
+            ( mbedtls_ssl_check_pending( pxContext ) != 0 ) )
+        {
+            xPending = pdTRUE;
+        }
+
+        if( xPending == pdTRUE )
         {
-            xRetVal = eTLSTransportInvalidCredentials;
+            lRetVal = 1;
         }
         else
         {
-            /* Optionally set SNI and ALPN protocols. */
-            setOptionalConfigurations( pxSSLContext,
-                                       pcHostName,
-                                       pxNetworkCredentials );
+            lRetVal = ( int32_t ) Sockets_Poll( pxNetworkContext->pParams->xTCPSocket,
+                                                xTimeoutTicks );
         }
     }
 
-    return xRetVal;
+    return lRetVal;
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext,
-                                          const NetworkCredentials_t * pxNetworkCredentials )
+TlsTransportStatus_t TLS_Socket_GetHeapStats( NetworkContext_t * pxNetworkContext,
+                                              TlsTransportHeapStats_t * pxStats )
 {
-    TlsTransportParams_t * pxTlsTransportParams = NULL;
     TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
-    int32_t lMbedtlsError = 0;
-    MbedSSLContext_t * pxSSLContext = NULL;
-
-    configASSERT( pxNetworkContext != NULL );
-    configASSERT( pxNetworkContext->pParams != NULL );
-    configASSERT( pxNetworkContext->pParams->xSSLContext != NULL );
-    configASSERT( pxNetworkCredentials != NULL );
-
-    pxTlsTransportParams = pxNetworkContext->pParams;
-    pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
-
-    /* Initialize the mbed TLS secured connection context. */
-    lMbedtlsError = mbedtls_ssl_setup( &( pxSSLContext->context ),
-                                       &( pxSSLContext->config ) );
+    MbedSSLContext_t * pxSSLContext;
 
-    if( lMbedtlsError != 0 )
+    if( ( pxNetworkContext == NULL ) || ( pxNetworkContext->pParams == NULL ) ||
+        ( pxNetworkContext->pParams->xSSLContext == NULL ) || ( pxStats == NULL ) )
     {
-        LogError( ( "Failed to set up mbed TLS SSL context: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-
-        xRetVal = eTLSTransportInternalError;
+        LogError( ( "Invalid input parameter(s): pxNetworkContext=%p, pxStats=%p.",
+                    pxNetworkContext, pxStats ) );
+        xRetVal = eTLSTransportInvalidParameter;
     }
     else
     {
-        /* Set the underlying IO for the TLS connection. */
-
-        /* MISRA Rule 11.2 flags the following line for casting the second
-         * parameter to void *. This rule is suppressed because
-         * #mbedtls_ssl_set_bio requires the second parameter as void *.
-         */
-        /* coverity[misra_c_2012_rule_11_2_violation] */
-        mbedtls_ssl_set_bio( &( pxSSLContext->context ),
-                             ( void * ) pxTlsTransportParams->xTCPSocket,
-                             mbedtls_platform_send,
-                             mbedtls_platform_recv,
-                             NULL );
-    }
+        pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
 
-    if( xRetVal == eTLSTransportSuccess )
-    {
-        /* Perform the TLS handshake. */
-        do
-        {
-            lMbedtlsError = mbedtls_ssl_handshake( &( pxSSLContext->context ) );
-        } while( ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
-                 ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+        #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+            if( pxSSLContext->lHeapAccount < 0 )
+            {
+                LogError( ( "Heap of this connection is not counted." ) );
+                xRetVal = eTLSTransportInternalError;
+            }
+            else
+            {
+                mbedtls_platform_heap_stats_get( pxSSLContext->lHeapAccount,
+                                                 &( pxStats->xCurrentBytes ),
+                                                 &( pxStats->xPeakBytes ) );
 
-        if( lMbedtlsError != 0 )
-        {
-            LogError( ( "Failed to perform TLS handshake: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+                /* Add what the transport allocated itself. */
+                pxStats->xPeakBytes += sizeof( MbedSSLContext_t );
+                pxStats->xSteadyBytes = pxSSLContext->xSteadyHeap + sizeof( MbedSSLContext_t );
+                pxStats->xCurrentBytes += sizeof( MbedSSLContext_t ) + pxSSLContext->xSendBufferSize;
 
-            xRetVal = eTLSTransportHandshakeFailed;
-        }
-        else
-        {
-            LogInfo( ( "(Network connection %p) TLS handshake successful.",
-                       pxNetworkContext ) );
-        }
+                if( pxStats->xCurrentBytes > pxStats->xPeakBytes )
+                {
+                    pxStats->xPeakBytes = pxStats->xCurrentBytes;
+                }
+            }
+        #else
+            ( void ) pxSSLContext;
+            LogError( ( "Heap statistics need MBEDTLS_FREERTOS_HEAP_STATS set to 1." ) );
+            xRetVal = eTLSTransportInternalError;
+        #endif
     }
 
     return xRetVal;
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pxEntropyContext,
-                                         mbedtls_ctr_drbg_context * pxCtrDrgbContext )
+TlsTransportStatus_t TLS_Socket_GetConnectMetrics( NetworkContext_t * pxNetworkContext,
+                                                   TlsConnectMetrics_t * pxMetrics )
 {
     TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
-    int32_t lMbedtlsError = 0;
 
-    /* Set the mutex functions for mbed TLS thread safety. */
-    mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
-                               mbedtls_platform_mutex_free,
-                               mbedtls_platform_mutex_lock,
-                               mbedtls_platform_mutex_unlock );
+    if( ( pxNetworkContext == NULL ) || ( pxNetworkContext->pParams == NULL ) ||
+        ( pxNetworkContext->pParams->xSSLContext == NULL ) || ( pxMetrics == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): pxNetworkContext=%p, pxMetrics=%p.",
+                    pxNetworkContext, pxMetrics ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else
+    {
+        *pxMetrics = ( ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext )->xConnectMetrics;
+    }
 
-    /* Initialize contexts for random number generation. */
-    mbedtls_entropy_init( pxEntropyContext );
-    mbedtls_ctr_drbg_init( pxCtrDrgbContext );
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
 
-    /* Add a strong entropy source. At least one is required. */
-    lMbedtlsError = mbedtls_entropy_add_source( pxEntropyContext,
-                                                mbedtls_platform_entropy_poll,
-                                                NULL,
-                                                32,
-                                                MBEDTLS_ENTROPY_SOURCE_STRONG );
+const char * TLS_Socket_GetCiphersuite( NetworkContext_t * pxNetworkContext )
+{
+    const char * pcCiphersuite = NULL;
+    MbedSSLContext_t * pxSSLContext;
 
-    if( lMbedtlsError != 0 )
+    if( ( pxNetworkContext == NULL ) || ( pxNetworkContext->pParams == NULL ) ||
+        ( pxNetworkContext->pParams->xSSLContext == NULL ) )
     {
-        LogError( ( "Failed to add entropy source: lMbedtlsError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-        xRetVal = eTLSTransportInternalError;
+        LogError( ( "Invalid input parameter(s): pxNetworkContext=%p.", pxNetworkContext ) );
     }
-
-    if( xRetVal == eTLSTransportSuccess )
+    else
     {
-        /* Seed the random number generator. */
-        lMbedtlsError = mbedtls_ctr_drbg_seed( pxCtrDrgbContext,
-                                               mbedtls_entropy_func,
-                                               pxEntropyContext,
-                                               NULL,
-                                               0 );
+        pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
 
-        if( lMbedtlsError != 0 )
+        if( pxSSLContext->xConnect.xStep == eTlsConnectDone )
         {
-            LogError( ( "Failed to seed PRNG: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-            xRetVal = eTLSTransportInternalError;
+            pcCiphersuite = mbedtls_ssl_get_ciphersuite( &( pxSSLContext->context ) );
         }
     }
-
-    if( xRetVal == eTLSTransportSuccess )
+
+    return pcCiphersuite;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_GetConnectHistogram( TlsConnectHistogram_t * pxHistogram )
+{
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+
+    if( pxHistogram == NULL )
+    {
+        LogError( ( "Invalid input parameter(s): pxHistogram=%p.", pxHistogram ) );
+        xRetVal = eTLSTransportInvalidParameter;
+    }
+    else if( transportLock() != pdTRUE )
+    {
+        xRetVal = eTLSTransportInternalError;
+    }
+    else
     {
-        LogDebug( ( "Successfully initialized mbedTLS." ) );
+        *pxHistogram = xConnectHistogram;
+        ( void ) xSemaphoreGive( xTransportMutex );
     }
 
     return xRetVal;
 }
 /*-----------------------------------------------------------*/
 
-TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pxNetworkContext,
-                                         const char * pcHostName,
-                                         uint16_t usPort,
-                                         const NetworkCredentials_t * pxNetworkCredentials,
-                                         uint32_t ulReceiveTimeoutMs,
-                                         uint32_t ulSendTimeoutMs )
+static int32_t sslWrite( MbedSSLContext_t * pxSslContext,
+                         const uint8_t * pucBuffer,
+                         size_t xBytesToSend )
 {
-    TlsTransportParams_t * pxTlsTransportParams = NULL;
-    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
-    BaseType_t xSocketStatus = 0;
-    MbedSSLContext_t * pxSSLContext;
-    TickType_t xRecvTimeout = pdMS_TO_TICKS( ulReceiveTimeoutMs );
-    TickType_t xSendTimeout = pdMS_TO_TICKS( ulSendTimeoutMs );
+    int32_t lMbedtlsError = 0;
 
-    if( ( pxNetworkContext == NULL ) ||
-        ( pxNetworkContext->pParams == NULL ) ||
-        ( pcHostName == NULL ) ||
-        ( pxNetworkCredentials == NULL ) )
+    tlsHEAP_STATS_ATTACH( pxSslContext );
+    lMbedtlsError = ( int32_t ) mbedtls_ssl_write( &( pxSslContext->context ),
+                                                   pucBuffer,
+                                                   xBytesToSend );
+    tlsHEAP_STATS_DETACH();
+
+    if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
+        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) )
     {
-        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pxNetworkContext=%p, "
-                    "pcHostName=%p, pxNetworkCredentials=%p.",
-                    pxNetworkCredentials,
-                    pcHostName,
-                    pxNetworkCredentials ) );
-        xRetVal = eTLSTransportInvalidParameter;
+        LogDebug( ( "Failed to send data. However, send can be retried on this error. "
+                    "mbedTLSError[%d]= %s : %s.", lMbedtlsError,
+                    mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+
+        /* Mark these set of errors as a timeout. The libraries may retry send
+         * on these errors. */
+        lMbedtlsError = 0;
     }
-    else if( ( pxNetworkCredentials->pucRootCa == NULL ) )
+    else if( lMbedtlsError < 0 )
     {
-        LogError( ( "pucRootCa cannot be NULL." ) );
-        xRetVal = eTLSTransportInvalidParameter;
+        LogError( ( "Failed to send data:  mbedTLSError[%d]= %s : %s.",
+                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
     }
-    else if( ( pxSSLContext = pvPortMalloc( sizeof( MbedSSLContext_t ) ) ) == NULL )
+    else
     {
-        LogError( ( "Failed to allocate mbed ssl context memmory ." ) );
-        xRetVal = eTLSTransportInSufficientMemory;
+        /* Empty else marker. */
     }
-    else
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t sslWriteAll( MbedSSLContext_t * pxSslContext,
+                            const uint8_t * pucBuffer,
+                            size_t xBytesToSend )
+{
+    int32_t lMbedtlsError = 0;
+    size_t xBytesSent = 0;
+
+    /* mbedtls_ssl_write sends at most one record per call. */
+    do
     {
-        pxTlsTransportParams = pxNetworkContext->pParams;
-        pxTlsTransportParams->xSSLContext = ( SSLContextHandle ) pxSSLContext;
+        lMbedtlsError = sslWrite( pxSslContext,
+                                  &( pucBuffer[ xBytesSent ] ),
+                                  xBytesToSend - xBytesSent );
 
-        if( ( pxTlsTransportParams->xTCPSocket = Sockets_Open() ) == SOCKETS_INVALID_SOCKET )
+        if( lMbedtlsError > 0 )
         {
-            LogError( ( "Failed to open socket." ) );
-            xRetVal = eTLSTransportConnectFailure;
-        }
-        else if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
-                                                       SOCKETS_SO_RCVTIMEO,
-                                                       &xRecvTimeout,
-                                                       sizeof( xRecvTimeout ) ) != 0 ) )
-        {
-            LogError( ( "Failed to set receive timeout on socket %d.", xSocketStatus ) );
-            xRetVal = eTLSTransportInternalError;
-        }
-        else if( ( xSocketStatus = Sockets_SetSockOpt( pxTlsTransportParams->xTCPSocket,
-                                                       SOCKETS_SO_SNDTIMEO,
-                                                       &xSendTimeout,
-                                                       sizeof( xSendTimeout ) ) != 0 ) )
-        {
-            LogError( ( "Failed to set send timeout on socket %d.", xSocketStatus ) );
-            xRetVal = eTLSTransportInternalError;
-        }
-        else if( ( xSocketStatus = Sockets_Connect( pxTlsTransportParams->xTCPSocket,
-                                                    pcHostName,
-                                                    usPort ) ) != 0 )
-        {
-            LogError( ( "Failed to connect to %s with error %d.",
-                        pcHostName,
-                        xSocketStatus ) );
-            xRetVal = eTLSTransportConnectFailure;
-        }
-        else if( ( xRetVal = initMbedtls( &( pxSSLContext->entropyContext ),
-                                          &( pxSSLContext->ctrDrgbContext ) ) ) != eTLSTransportSuccess )
-        {
-            LogError( ( "Failed to initialize Mbedtls %d.", xRetVal ) );
-        }
-        else if( ( xRetVal = tlsSetup( pxNetworkContext, pcHostName,
-                                       pxNetworkCredentials ) ) != eTLSTransportSuccess )
-        {
-            LogError( ( "Failed to setup Mbedtls %d.", xRetVal ) );
-        }
-        else if( ( xRetVal = tlsHandshake( pxNetworkContext, pxNetworkCredentials ) ) != eTLSTransportSuccess )
-        {
-            LogError( ( "Failed to do TLS handshake %d.", xRetVal ) );
-        }
-        else
-        {
-            LogInfo( ( "(Network connection %p) Connection to %s established.",
-                       pxNetworkContext,
-                       pcHostName ) );
+            xBytesSent += ( size_t ) lMbedtlsError;
         }
+    } while( ( lMbedtlsError > 0 ) && ( xBytesSent < xBytesToSend ) );
 
-        /* Clean up on failure. */
-        if( xRetVal != eTLSTransportSuccess )
-        {
-            if( ( pxNetworkContext != NULL ) && ( pxNetworkContext->pParams != NULL ) )
-            {
-                sslContextFree( pxSSLContext );
-                vPortFree( pxSSLContext );
-                pxTlsTransportParams->xSSLContext = NULL;
+    return ( ( xBytesSent > 0 ) || ( lMbedtlsError >= 0 ) ) ? ( int32_t ) xBytesSent : lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
 
-                if( pxTlsTransportParams->xTCPSocket != SOCKETS_INVALID_SOCKET )
-                {
-                    ( void ) Sockets_Disconnect( pxTlsTransportParams->xTCPSocket );
-                    ( void ) Sockets_Close( pxTlsTransportParams->xTCPSocket );
-                }
-            }
+static int32_t sendBufferFlush( MbedSSLContext_t * pxSslContext )
+{
+    int32_t lMbedtlsError = 0;
+
+    if( pxSslContext->xSendBuffered > 0 )
+    {
+        lMbedtlsError = sslWriteAll( pxSslContext,
+                                     pxSslContext->pucSendBuffer,
+                                     pxSslContext->xSendBuffered );
+
+        if( lMbedtlsError > 0 )
+        {
+            /* Keep what timed out for the next flush. */
+            pxSslContext->xSendBuffered -= ( size_t ) lMbedtlsError;
+            ( void ) memmove( pxSslContext->pucSendBuffer,
+                              &( pxSslContext->pucSendBuffer[ lMbedtlsError ] ),
+                              pxSslContext->xSendBuffered );
         }
     }
 
-    return xRetVal;
+    return lMbedtlsError;
 }
 /*-----------------------------------------------------------*/
 
-void TLS_Socket_Disconnect( NetworkContext_t * pxNetworkContext )
+static int32_t bufferedSend( MbedSSLContext_t * pxSslContext,
+                             const SocketsIoVec_t * pxIoVec,
+                             size_t xIoVecCount )
 {
-    TlsTransportParams_t * pxTlsTransportParams = NULL;
     int32_t lMbedtlsError = 0;
-    MbedSSLContext_t * pxSSLContext;
+    int32_t lBytesSent = 0;
+    size_t xIndex;
+    size_t xOffset;
+    size_t xLength;
+    BaseType_t xDone = pdFALSE;
+
+    /* Data buffered before coalescing was turned off goes out first. */
+    if( ( pxSslContext->xCoalesce == pdFALSE ) && ( pxSslContext->xSendBuffered > 0 ) )
+    {
+        lMbedtlsError = sendBufferFlush( pxSslContext );
+        xDone = ( pxSslContext->xSendBuffered == 0 ) ? pdFALSE : pdTRUE;
+    }
 
-    if( ( pxNetworkContext != NULL ) && ( pxNetworkContext->pParams != NULL ) &&
-        ( pxNetworkContext->pParams->xSSLContext != NULL ) )
+    for( xIndex = 0; ( xIndex < xIoVecCount ) && ( xDone == pdFALSE ); xIndex++ )
     {
-        pxTlsTransportParams = pxNetworkContext->pParams;
-        pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
-        /* Attempting to terminate TLS connection. */
-        lMbedtlsError = mbedtls_ssl_close_notify( &( pxSSLContext->context ) );
+        xOffset = 0;
 
-        /* Ignore the WANT_READ and WANT_WRITE return values. */
-        if( ( lMbedtlsError != MBEDTLS_ERR_SSL_WANT_READ ) &&
-            ( lMbedtlsError != MBEDTLS_ERR_SSL_WANT_WRITE ) )
+        while( ( xOffset < pxIoVec[ xIndex ].xDataLength ) && ( xDone == pdFALSE ) )
         {
-            if( lMbedtlsError == 0 )
+            xLength = pxIoVec[ xIndex ].xDataLength - xOffset;
+
+            if( ( pxSslContext->xSendBuffered == 0 ) &&
+                ( ( xLength >= pxSslContext->xSendBufferSize ) ||
+                  ( pxSslContext->pucSendBuffer == NULL ) ) )
             {
-                LogInfo( ( "(Network connection %p) TLS close-notify sent.",
-                           pxNetworkContext ) );
+                /* Nothing to pack this buffer with, write it in place. */
+                lMbedtlsError = sslWriteAll( pxSslContext,
+                                             &( pxIoVec[ xIndex ].pucData[ xOffset ] ),
+                                             xLength );
+
+                if( lMbedtlsError > 0 )
+                {
+                    lBytesSent += lMbedtlsError;
+                    xOffset += ( size_t ) lMbedtlsError;
+                }
+
+                /* Report what made it out, the caller resends the rest. */
+                xDone = ( lMbedtlsError == ( int32_t ) xLength ) ? pdFALSE : pdTRUE;
             }
             else
             {
-                LogError( ( "(Network connection %p) Failed to send TLS close-notify: mbedTLSError[%d]= %s : %s.",
-                            pxNetworkContext, lMbedtlsError,
-                            mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                            mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+                if( xLength > ( pxSslContext->xSendBufferSize - pxSslContext->xSendBuffered ) )
+                {
+                    xLength = pxSslContext->xSendBufferSize - pxSslContext->xSendBuffered;
+                }
+
+                if( pxSslContext->xSendBuffered == 0 )
+                {
+                    pxSslContext->xFirstBuffered = xTaskGetTickCount();
+                }
+
+                ( void ) memcpy( &( pxSslContext->pucSendBuffer[ pxSslContext->xSendBuffered ] ),
+                                 &( pxIoVec[ xIndex ].pucData[ xOffset ] ),
+                                 xLength );
+                pxSslContext->xSendBuffered += xLength;
+                xOffset += xLength;
+                lBytesSent += ( int32_t ) xLength;
+
+                if( pxSslContext->xSendBuffered == pxSslContext->xSendBufferSize )
+                {
+                    lMbedtlsError = sendBufferFlush( pxSslContext );
+
+                    /* Stop taking data while the buffer cannot drain. */
+                    xDone = ( pxSslContext->xSendBuffered == 0 ) ? pdFALSE : pdTRUE;
+                }
             }
         }
-        else
+    }
+
+    if( pxSslContext->xCoalesce == pdTRUE )
+    {
+        if( ( xDone == pdFALSE ) &&
+            ( ( xTaskGetTickCount() - pxSslContext->xFirstBuffered ) >= pxSslContext->xFlushDelay ) )
         {
-            /* WANT_READ and WANT_WRITE can be ignored. Logging for debugging purposes. */
-            LogInfo( ( "(Network connection %p) TLS close-notify sent; ",
-                       "received %s as the TLS status can be ignored for close-notify."
-                       ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ? "WANT_READ" : "WANT_WRITE",
-                       pxNetworkContext ) );
+            lMbedtlsError = sendBufferFlush( pxSslContext );
+        }
+    }
+    else if( lBytesSent > 0 )
+    {
+        /* Only bytes of this call are buffered here. */
+        if( xDone == pdFALSE )
+        {
+            lMbedtlsError = sendBufferFlush( pxSslContext );
         }
 
-        /* Call socket shutdown function to close connection. */
-        Sockets_Disconnect( pxTlsTransportParams->xTCPSocket );
-        Sockets_Close( pxTlsTransportParams->xTCPSocket );
-
-        /* Free mbed TLS contexts. */
-        sslContextFree( pxSSLContext );
-        vPortFree( pxSSLContext );
+        /* Keep nothing queued, the caller resends what was not written. */
+        lBytesSent -= ( int32_t ) pxSslContext->xSendBuffered;
+        pxSslContext->xSendBuffered = 0;
+    }
+    else
+    {
+        /* Nothing was taken from this call. */
     }
 
-    /* Clear the mutex functions for mbed TLS thread safety. */
-    mbedtls_threading_free_alt();
+    /* Bytes taken are reported even if a later write failed, so the caller
+     * does not send them twice; the failure shows on the next call. */
+    return ( ( lBytesSent == 0 ) && ( lMbedtlsError < 0 ) ) ? lMbedtlsError : lBytesSent;
 }
 /*-----------------------------------------------------------*/
 
-int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
-                         void * pvBuffer,
-                         size_t xBytesToRecv )
+int32_t TLS_Socket_Send( NetworkContext_t * pxNetworkContext,
+                         const void * pvBuffer,
+                         size_t xBytesToSend )
 {
-    int32_t lMbedtlsError = 0;
     MbedSSLContext_t * pxSSLContext;
+    SocketsIoVec_t xIoVec;
+    int32_t lMbedtlsError = 0;
 
     configASSERT( ( pxNetworkContext != NULL ) &&
                   ( pxNetworkContext->pParams != NULL ) &&
                   ( pxNetworkContext->pParams->xSSLContext != NULL ) );
 
     pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
-    lMbedtlsError = ( int32_t ) mbedtls_ssl_read( &( pxSSLContext->context ),
-                                                  pvBuffer,
-                                                  xBytesToRecv );
-
-    if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
-        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
-        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) )
-    {
-        LogDebug( ( "Failed to read data. However, a read can be retried on this error. "
-                    "mbedTLSError[%d]= %s : %s.", lMbedtlsError,
-                    mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
 
-        /* Mark these set of errors as a timeout. The libraries may retry read
-         * on these errors. */
-        lMbedtlsError = 0;
-    }
-    else if( lMbedtlsError < 0 )
+    if( ( pxSSLContext->xCoalesce == pdTRUE ) || ( pxSSLContext->xSendBuffered > 0 ) )
     {
-        LogError( ( "Failed to read data: mbedTLSError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+        /* Queue behind buffered data to keep the byte order. */
+        xIoVec.pucData = ( const uint8_t * ) pvBuffer;
+        xIoVec.xDataLength = xBytesToSend;
+        lMbedtlsError = bufferedSend( pxSSLContext, &xIoVec, 1 );
     }
     else
     {
-        /* Empty else marker. */
+        lMbedtlsError = sslWrite( pxSSLContext, pvBuffer, xBytesToSend );
     }
 
     return lMbedtlsError;
 }
 /*-----------------------------------------------------------*/
 
-int32_t TLS_Socket_Send( NetworkContext_t * pxNetworkContext,
-                         const void * pvBuffer,
-                         size_t xBytesToSend )
+int32_t TLS_Socket_SendV( NetworkContext_t * pxNetworkContext,
+                          const SocketsIoVec_t * pxIoVec,
+                          size_t xIoVecCount )
 {
-    int32_t lMbedtlsError = 0;
     MbedSSLContext_t * pxSSLContext;
 
     configASSERT( ( pxNetworkContext != NULL ) &&
                   ( pxNetworkContext->pParams != NULL ) &&
                   ( pxNetworkContext->pParams->xSSLContext != NULL ) );
+    configASSERT( ( pxIoVec != NULL ) || ( xIoVecCount == 0 ) );
 
     pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
-    lMbedtlsError = ( int32_t ) mbedtls_ssl_write( &( pxSSLContext->context ),
-                                                   pvBuffer,
-                                                   xBytesToSend );
 
-    if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
-        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
-        ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+    /* A single buffer gains nothing from packing. */
+    if( ( xIoVecCount > 1 ) && ( pxSSLContext->pucSendBuffer == NULL ) )
     {
-        LogDebug( ( "Failed to send data. However, send can be retried on this error. "
-                    "mbedTLSError[%d]= %s : %s.", lMbedtlsError,
-                    mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
-
-        /* Mark these set of errors as a timeout. The libraries may retry send
-         * on these errors. */
-        lMbedtlsError = 0;
+        if( ( pxSSLContext->pucSendBuffer = pvPortMalloc( TLS_TRANSPORT_SEND_BUFFER_SIZE ) ) == NULL )
+        {
+            LogWarn( ( "Failed to allocate TLS send buffer, sending each buffer in its own record." ) );
+        }
+        else
+        {
+            pxSSLContext->xSendBufferSize = TLS_TRANSPORT_SEND_BUFFER_SIZE;
+        }
     }
-    else if( lMbedtlsError < 0 )
+
+    return bufferedSend( pxSSLContext, pxIoVec, xIoVecCount );
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_SetWriteCoalescing( NetworkContext_t * pxNetworkContext,
+                                                    uint32_t ulFlushDelayUs )
+{
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    MbedSSLContext_t * pxSSLContext;
+    uint8_t * pucBuffer;
+    size_t xSize;
+
+    if( ( pxNetworkContext == NULL ) || ( pxNetworkContext->pParams == NULL ) ||
+        ( pxNetworkContext->pParams->xSSLContext == NULL ) )
     {
-        LogError( ( "Failed to send data:  mbedTLSError[%d]= %s : %s.",
-                    lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+        LogError( ( "Invalid input parameter(s): pxNetworkContext=%p.", pxNetworkContext ) );
+        xRetVal = eTLSTransportInvalidParameter;
     }
     else
     {
-        /* Empty else marker. */
+        pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
+
+        if( ulFlushDelayUs == 0 )
+        {
+            pxSSLContext->xCoalesce = pdFALSE;
+
+            if( sendBufferFlush( pxSSLContext ) < 0 )
+            {
+                xRetVal = eTLSTransportInternalError;
+            }
+        }
+        else
+        {
+            /* Coalesce up to one full record. */
+            xSize = ( size_t ) mbedtls_ssl_get_max_out_record_payload( &( pxSSLContext->context ) );
+
+            if( xSize > TLS_TRANSPORT_COALESCE_BUFFER_MAX_SIZE )
+            {
+                xSize = TLS_TRANSPORT_COALESCE_BUFFER_MAX_SIZE;
+            }
+
+            /* Grow the buffer only while it is empty. */
+            if( ( pxSSLContext->xSendBufferSize < xSize ) &&
+                ( pxSSLContext->xSendBuffered == 0 ) &&
+                ( ( pucBuffer = pvPortMalloc( xSize ) ) != NULL ) )
+            {
+                vPortFree( pxSSLContext->pucSendBuffer );
+                pxSSLContext->pucSendBuffer = pucBuffer;
+                pxSSLContext->xSendBufferSize = xSize;
+            }
+
+            if( pxSSLContext->pucSendBuffer == NULL )
+            {
+                LogError( ( "Failed to allocate TLS write coalescing buffer." ) );
+                xRetVal = eTLSTransportInSufficientMemory;
+            }
+            else
+            {
+                /* Round up to whole ticks, the finest timing available. */
+                pxSSLContext->xFlushDelay = ( TickType_t ) ( ( ( ( uint64_t ) ulFlushDelayUs * configTICK_RATE_HZ ) +
+                                                              999999U ) / 1000000U );
+                pxSSLContext->xCoalesce = pdTRUE;
+            }
+        }
     }
 
-    return lMbedtlsError;
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_Socket_Flush( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
+    MbedSSLContext_t * pxSSLContext;
+
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) &&
+                  ( pxNetworkContext->pParams->xSSLContext != NULL ) );
+
+    pxSSLContext = ( MbedSSLContext_t * ) pxNetworkContext->pParams->xSSLContext;
+
+    if( ( sendBufferFlush( pxSSLContext ) < 0 ) || ( pxSSLContext->xSendBuffered > 0 ) )
+    {
+        xRetVal = eTLSTransportInternalError;
+    }
+
+    return xRetVal;
 }
 /*-----------------------------------------------------------*/
@@ -0,0 +1,209 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file event_loop.c
+ * @brief Application loop that sleeps until there is work to do.
+ */
+
+#include "event_loop.h"
+
+/* Standard includes. */
+#include <string.h>
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Ticks left before a timer expires, 0 if it has.
+ */
+static TickType_t prvTicksLeft( const EventLoopTimer_t * pxTimer,
+                                TickType_t xNow )
+{
+    TickType_t xElapsed = xNow - pxTimer->xStart;
+
+    return ( xElapsed < pxTimer->xPeriod ) ? ( pxTimer->xPeriod - xElapsed ) : 0;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Run the handlers of the expired timers.
+ *
+ * @return pdFAIL if a handler failed, else pdPASS.
+ */
+static BaseType_t prvRunTimers( EventLoop_t * pxLoop )
+{
+    BaseType_t xResult = pdPASS;
+    EventLoopTimer_t * pxTimer;
+    TickType_t xNow;
+    size_t xIndex;
+
+    for( xIndex = 0; ( xIndex < EVENT_LOOP_MAX_TIMERS ) && ( xResult == pdPASS ); xIndex++ )
+    {
+        pxTimer = &( pxLoop->xTimers[ xIndex ] );
+        xNow = xTaskGetTickCount();
+
+        if( ( pxTimer->xHandler != NULL ) && ( prvTicksLeft( pxTimer, xNow ) == 0 ) )
+        {
+            /* Periods missed while the task was busy are skipped, rather
+             * than run back to back. */
+            pxTimer->xStart += pxTimer->xPeriod * ( ( xNow - pxTimer->xStart ) / pxTimer->xPeriod );
+            xResult = pxTimer->xHandler( pxTimer->pvContext );
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Ticks the loop can wait on the connection before it has other work.
+ */
+static TickType_t prvTicksToWait( const EventLoop_t * pxLoop )
+{
+    TickType_t xWait = portMAX_DELAY;
+    TickType_t xNow = xTaskGetTickCount();
+    TickType_t xLeft;
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < EVENT_LOOP_MAX_TIMERS; xIndex++ )
+    {
+        if( pxLoop->xTimers[ xIndex ].xHandler != NULL )
+        {
+            xLeft = prvTicksLeft( &( pxLoop->xTimers[ xIndex ] ), xNow );
+
+            if( xLeft < xWait )
+            {
+                xWait = xLeft;
+            }
+        }
+    }
+
+    if( ( pxLoop->xEventHandler != NULL ) && ( xWait > EVENT_LOOP_EVENT_LATENCY_TICKS ) )
+    {
+        xWait = EVENT_LOOP_EVENT_LATENCY_TICKS;
+    }
+
+    return xWait;
+}
+/*-----------------------------------------------------------*/
+
+void EventLoop_Init( EventLoop_t * pxLoop,
+                     NetworkContext_t * pxNetworkContext,
+                     EventLoopHandler_t xReadHandler,
+                     void * pvReadContext )
+{
+    configASSERT( ( pxLoop != NULL ) && ( pxNetworkContext != NULL ) && ( xReadHandler != NULL ) );
+
+    ( void ) memset( pxLoop, 0, sizeof( EventLoop_t ) );
+    pxLoop->pxNetworkContext = pxNetworkContext;
+    pxLoop->xReadHandler = xReadHandler;
+    pxLoop->pvReadContext = pvReadContext;
+    pxLoop->xTask = xTaskGetCurrentTaskHandle();
+    pxLoop->xStopped = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+void EventLoop_SetEventHandler( EventLoop_t * pxLoop,
+                                EventLoopEventHandler_t xEventHandler,
+                                void * pvEventContext )
+{
+    pxLoop->xEventHandler = xEventHandler;
+    pxLoop->pvEventContext = pvEventContext;
+}
+/*-----------------------------------------------------------*/
+
+EventLoopTimer_t * EventLoop_AddTimer( EventLoop_t * pxLoop,
+                                       TickType_t xPeriod,
+                                       EventLoopHandler_t xHandler,
+                                       void * pvContext )
+{
+    EventLoopTimer_t * pxTimer = NULL;
+    size_t xIndex;
+
+    configASSERT( xHandler != NULL );
+
+    for( xIndex = 0; ( xIndex < EVENT_LOOP_MAX_TIMERS ) && ( pxTimer == NULL ); xIndex++ )
+    {
+        if( pxLoop->xTimers[ xIndex ].xHandler == NULL )
+        {
+            pxTimer = &( pxLoop->xTimers[ xIndex ] );
+            pxTimer->xHandler = xHandler;
+            pxTimer->pvContext = pvContext;
+            EventLoop_SetTimerPeriod( pxTimer, xPeriod );
+        }
+    }
+
+    return pxTimer;
+}
+/*-----------------------------------------------------------*/
+
+void EventLoop_SetTimerPeriod( EventLoopTimer_t * pxTimer,
+                               TickType_t xPeriod )
+{
+    configASSERT( xPeriod > 0 );
+
+    pxTimer->xPeriod = xPeriod;
+    pxTimer->xStart = xTaskGetTickCount();
+}
+/*-----------------------------------------------------------*/
+
+void EventLoop_Post( EventLoop_t * pxLoop,
+                     uint32_t ulEvents )
+{
+    ( void ) xTaskNotify( pxLoop->xTask, ulEvents, eSetBits );
+}
+/*-----------------------------------------------------------*/
+
+void EventLoop_PostFromISR( EventLoop_t * pxLoop,
+                            uint32_t ulEvents,
+                            BaseType_t * pxHigherPriorityTaskWoken )
+{
+    ( void ) xTaskNotifyFromISR( pxLoop->xTask, ulEvents, eSetBits, pxHigherPriorityTaskWoken );
+}
+/*-----------------------------------------------------------*/
+
+void EventLoop_Stop( EventLoop_t * pxLoop )
+{
+    pxLoop->xStopped = pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t EventLoop_Run( EventLoop_t * pxLoop )
+{
+    BaseType_t xResult = pdPASS;
+    int32_t lPollResult;
+    uint32_t ulEvents;
+
+    configASSERT( pxLoop->xTask == xTaskGetCurrentTaskHandle() );
+
+    pxLoop->xStopped = pdFALSE;
+
+    while( ( xResult == pdPASS ) && ( pxLoop->xStopped == pdFALSE ) )
+    {
+        lPollResult = TLS_Socket_Poll( pxLoop->pxNetworkContext, prvTicksToWait( pxLoop ) );
+
+        if( lPollResult < 0 )
+        {
+            xResult = pdFAIL;
+        }
+        else if( lPollResult > 0 )
+        {
+            xResult = pxLoop->xReadHandler( pxLoop->pvReadContext );
+        }
+
+        if( ( xResult == pdPASS ) && ( pxLoop->xStopped == pdFALSE ) &&
+            ( pxLoop->xEventHandler != NULL ) &&
+            ( xTaskNotifyWait( 0, 0xFFFFFFFFUL, &ulEvents, 0 ) == pdTRUE ) &&
+            ( ulEvents != 0 ) )
+        {
+            xResult = pxLoop->xEventHandler( ulEvents, pxLoop->pvEventContext );
+        }
+
+        if( ( xResult == pdPASS ) && ( pxLoop->xStopped == pdFALSE ) )
+        {
+            xResult = prvRunTimers( pxLoop );
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,180 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file event_loop.h
+ * @brief Application loop that sleeps until there is work to do.
+ *
+ * The loop blocks on the TLS connection until data arrives or the next timer
+ * is due, so received messages are handled as soon as they arrive while the
+ * task sleeps the rest of the time. Other tasks and interrupts wake it with
+ * events, delivered as task notification bits.
+ *
+ * All handlers run in the task that called #EventLoop_Init.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "transport_tls_socket.h"
+
+/**
+ * @brief Number of timers a loop can run.
+ */
+#ifndef EVENT_LOOP_MAX_TIMERS
+    #define EVENT_LOOP_MAX_TIMERS    ( 4 )
+#endif
+
+/**
+ * @brief Longest time, in ticks, a posted event waits while the loop blocks
+ * on the connection.
+ *
+ * A task cannot block on a socket and its notifications at the same time, so
+ * a loop with an event handler wakes at least this often to check. Loops
+ * without an event handler only wake for data and timers.
+ */
+#ifndef EVENT_LOOP_EVENT_LATENCY_TICKS
+    #define EVENT_LOOP_EVENT_LATENCY_TICKS    ( pdMS_TO_TICKS( 50U ) )
+#endif
+
+/**
+ * @brief Handle data on the connection or an expired timer.
+ *
+ * @param[in] pvContext Context given with the handler.
+ * @return pdPASS to keep the loop running, pdFAIL to make #EventLoop_Run
+ * return pdFAIL.
+ */
+typedef BaseType_t ( * EventLoopHandler_t )( void * pvContext );
+
+/**
+ * @brief Handle events posted with #EventLoop_Post.
+ *
+ * @param[in] ulEvents Event bits posted since the last call.
+ * @param[in] pvContext Context given with the handler.
+ * @return pdPASS to keep the loop running, pdFAIL to make #EventLoop_Run
+ * return pdFAIL.
+ */
+typedef BaseType_t ( * EventLoopEventHandler_t )( uint32_t ulEvents,
+                                                  void * pvContext );
+
+/**
+ * @brief A periodic timer, see #EventLoop_AddTimer.
+ */
+typedef struct EventLoopTimer
+{
+    EventLoopHandler_t xHandler; /**< Called when the timer expires, NULL if the timer is free. */
+    void * pvContext;            /**< Passed to the handler. */
+    TickType_t xPeriod;          /**< Ticks between two expiries. */
+    TickType_t xStart;           /**< Tick count the current period started at. */
+} EventLoopTimer_t;
+
+/**
+ * @brief An event loop. Fields are private to the implementation.
+ */
+typedef struct EventLoop
+{
+    NetworkContext_t * pxNetworkContext;   /**< Connection the loop waits on. */
+    EventLoopHandler_t xReadHandler;       /**< Called when the connection has data. */
+    void * pvReadContext;                  /**< Passed to the read handler. */
+    EventLoopEventHandler_t xEventHandler; /**< Called for posted events, may be NULL. */
+    void * pvEventContext;                 /**< Passed to the event handler. */
+    TaskHandle_t xTask;                    /**< Task running the loop. */
+    BaseType_t xStopped;                   /**< Set by #EventLoop_Stop. */
+    EventLoopTimer_t xTimers[ EVENT_LOOP_MAX_TIMERS ];
+} EventLoop_t;
+
+/**
+ * @brief Initialize an event loop, to be run by the calling task.
+ *
+ * @param[out] pxLoop The loop.
+ * @param[in] pxNetworkContext Connection to wait on.
+ * @param[in] xReadHandler Called when the connection has data to receive,
+ * or was closed.
+ * @param[in] pvReadContext Passed to the read handler.
+ */
+void EventLoop_Init( EventLoop_t * pxLoop,
+                     NetworkContext_t * pxNetworkContext,
+                     EventLoopHandler_t xReadHandler,
+                     void * pvReadContext );
+
+/**
+ * @brief Set the handler of the events posted to a loop.
+ *
+ * @param[in] pxLoop The loop.
+ * @param[in] xEventHandler The handler, NULL to leave events pending.
+ * @param[in] pvEventContext Passed to the handler.
+ */
+void EventLoop_SetEventHandler( EventLoop_t * pxLoop,
+                                EventLoopEventHandler_t xEventHandler,
+                                void * pvEventContext );
+
+/**
+ * @brief Start a periodic timer. Its first expiry is one period from now.
+ *
+ * @param[in] pxLoop The loop.
+ * @param[in] xPeriod Ticks between two expiries, at least 1.
+ * @param[in] xHandler Called when the timer expires.
+ * @param[in] pvContext Passed to the handler.
+ * @return The timer, or NULL if the loop runs #EVENT_LOOP_MAX_TIMERS timers.
+ */
+EventLoopTimer_t * EventLoop_AddTimer( EventLoop_t * pxLoop,
+                                       TickType_t xPeriod,
+                                       EventLoopHandler_t xHandler,
+                                       void * pvContext );
+
+/**
+ * @brief Change the period of a timer. Its next expiry is one period from now.
+ *
+ * Must be called from the task running the loop, for example from a handler.
+ *
+ * @param[in] pxTimer The timer.
+ * @param[in] xPeriod Ticks between two expiries, at least 1.
+ */
+void EventLoop_SetTimerPeriod( EventLoopTimer_t * pxTimer,
+                               TickType_t xPeriod );
+
+/**
+ * @brief Post events to a loop from a task.
+ *
+ * @param[in] pxLoop The loop.
+ * @param[in] ulEvents Event bits, merged with the ones not handled yet.
+ */
+void EventLoop_Post( EventLoop_t * pxLoop,
+                     uint32_t ulEvents );
+
+/**
+ * @brief Post events to a loop from an interrupt.
+ *
+ * @param[in] pxLoop The loop.
+ * @param[in] ulEvents Event bits, merged with the ones not handled yet.
+ * @param[out] pxHigherPriorityTaskWoken Set to pdTRUE if a context switch
+ * should be requested before the interrupt exits.
+ */
+void EventLoop_PostFromISR( EventLoop_t * pxLoop,
+                            uint32_t ulEvents,
+                            BaseType_t * pxHigherPriorityTaskWoken );
+
+/**
+ * @brief Make #EventLoop_Run return once the current handler returns.
+ *
+ * Must be called from the task running the loop, for example from a handler.
+ *
+ * @param[in] pxLoop The loop.
+ */
+void EventLoop_Stop( EventLoop_t * pxLoop );
+
+/**
+ * @brief Run a loop until it is stopped or fails.
+ *
+ * @param[in] pxLoop The loop.
+ * @return pdPASS if #EventLoop_Stop was called, pdFAIL if a handler failed
+ * or waiting on the connection failed.
+ */
+BaseType_t EventLoop_Run( EventLoop_t * pxLoop );
+
+#endif /* EVENT_LOOP_H */
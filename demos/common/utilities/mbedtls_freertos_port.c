@@ -11,16 +11,386 @@
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 
 #include "sockets_wrapper.h"
 
 /* mbed TLS includes. */
 #include "mbedtls_config.h"
+#include "mbedtls_freertos_port.h"
 #include "threading_alt.h"
 #include "mbedtls/entropy.h"
 
+#if defined( MBEDTLS_ECDH_GEN_PUBLIC_ALT )
+    #include "mbedtls/ecdh.h"
+    #include "mbedtls/ecp.h"
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if ( MBEDTLS_FREERTOS_POOL == 1 )
+
+/**
+ * @brief One size class of the pool.
+ */
+    typedef struct PoolClass
+    {
+        size_t blockSize;  /**< @brief Size of each block. */
+        uint8_t * pStart;  /**< @brief First block. */
+        uint8_t * pEnd;    /**< @brief End of the last block. */
+        void * pFreeList;  /**< @brief Free blocks, linked through their first word. */
+    } PoolClass_t;
+
+/**
+ * @brief Block size of each size class.
+ */
+    static const size_t poolClassSizes[ MBEDTLS_FREERTOS_POOL_CLASSES ] = MBEDTLS_FREERTOS_POOL_CLASS_SIZES;
+
+/**
+ * @brief Number of blocks in each size class.
+ */
+    static const size_t poolClassBlocks[ MBEDTLS_FREERTOS_POOL_CLASSES ] = MBEDTLS_FREERTOS_POOL_CLASS_BLOCKS;
+
+/**
+ * @brief Size classes, set up on the first allocation.
+ */
+    static PoolClass_t poolClasses[ MBEDTLS_FREERTOS_POOL_CLASSES ];
+
+/**
+ * @brief Memory holding all blocks, NULL until set up.
+ */
+    static uint8_t * poolArena = NULL;
+
+/**
+ * @brief Pool usage.
+ */
+    static mbedtls_platform_pool_stats_t poolStats;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Set up the pool with one heap allocation that is never freed.
+ *
+ * @return pdTRUE if the pool is ready.
+ */
+    static BaseType_t poolInit( void )
+    {
+        uint8_t * pArena;
+        uint8_t * pBlock;
+        size_t size = 0;
+        size_t i;
+        size_t j;
+
+        for( i = 0; i < MBEDTLS_FREERTOS_POOL_CLASSES; i++ )
+        {
+            configASSERT( ( poolClassSizes[ i ] & portBYTE_ALIGNMENT_MASK ) == 0 );
+            configASSERT( poolClassSizes[ i ] >= sizeof( void * ) );
+            configASSERT( ( i == 0 ) || ( poolClassSizes[ i ] > poolClassSizes[ i - 1 ] ) );
+            size += poolClassSizes[ i ] * poolClassBlocks[ i ];
+        }
+
+        pArena = pvPortMalloc( size );
+
+        if( pArena != NULL )
+        {
+            /* Link the free blocks of each class, last block first. */
+            pBlock = pArena;
+
+            for( i = 0; i < MBEDTLS_FREERTOS_POOL_CLASSES; i++ )
+            {
+                for( j = 0; j < poolClassBlocks[ i ]; j++ )
+                {
+                    *( void ** ) pBlock = ( j == 0 ) ? NULL : ( void * ) ( pBlock - poolClassSizes[ i ] );
+                    pBlock += poolClassSizes[ i ];
+                }
+            }
+
+            taskENTER_CRITICAL();
+
+            if( poolArena == NULL )
+            {
+                pBlock = pArena;
+
+                for( i = 0; i < MBEDTLS_FREERTOS_POOL_CLASSES; i++ )
+                {
+                    poolClasses[ i ].blockSize = poolClassSizes[ i ];
+                    poolClasses[ i ].pStart = pBlock;
+                    pBlock += poolClassSizes[ i ] * poolClassBlocks[ i ];
+                    poolClasses[ i ].pEnd = pBlock;
+                    poolClasses[ i ].pFreeList = ( poolClassBlocks[ i ] > 0 ) ?
+                                                 ( void * ) ( pBlock - poolClassSizes[ i ] ) : NULL;
+                }
+
+                poolStats.poolSize = size;
+                poolArena = pArena;
+                pArena = NULL;
+            }
+
+            taskEXIT_CRITICAL();
+
+            if( pArena != NULL )
+            {
+                /* Another task set up the pool first. */
+                vPortFree( pArena );
+            }
+        }
+
+        return ( poolArena != NULL ) ? pdTRUE : pdFALSE;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Allocate memory from the smallest size class that has a free block
+ * large enough, or from the heap.
+ *
+ * @param[in] size Number of bytes to allocate.
+ *
+ * @return Pointer to the memory, or NULL.
+ */
+    static void * poolAlloc( size_t size )
+    {
+        void * pBlock = NULL;
+        PoolClass_t * pClass;
+        BaseType_t fits = pdFALSE;
+        size_t i;
+
+        if( ( poolArena != NULL ) || ( poolInit() == pdTRUE ) )
+        {
+            taskENTER_CRITICAL();
+
+            for( i = 0; ( i < MBEDTLS_FREERTOS_POOL_CLASSES ) && ( pBlock == NULL ); i++ )
+            {
+                pClass = &poolClasses[ i ];
+
+                if( size <= pClass->blockSize )
+                {
+                    fits = pdTRUE;
+
+                    if( pClass->pFreeList != NULL )
+                    {
+                        pBlock = pClass->pFreeList;
+                        pClass->pFreeList = *( void ** ) pBlock;
+
+                        poolStats.hits++;
+                        poolStats.current += pClass->blockSize;
+                        poolStats.requestedBytes += size;
+                        poolStats.blockBytes += pClass->blockSize;
+
+                        if( poolStats.current > poolStats.peak )
+                        {
+                            poolStats.peak = poolStats.current;
+                        }
+                    }
+                }
+            }
+
+            if( pBlock == NULL )
+            {
+                poolStats.misses++;
+
+                if( fits == pdTRUE )
+                {
+                    poolStats.exhausted++;
+                }
+            }
+
+            taskEXIT_CRITICAL();
+        }
+
+        if( pBlock == NULL )
+        {
+            pBlock = pvPortMalloc( size );
+        }
+
+        return pBlock;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Free memory allocated by poolAlloc.
+ *
+ * @param[in] ptr Pointer returned by poolAlloc, or NULL.
+ */
+    static void poolFree( void * ptr )
+    {
+        PoolClass_t * pClass = NULL;
+        size_t i;
+
+        if( ( poolArena != NULL ) &&
+            ( ( uint8_t * ) ptr >= poolArena ) &&
+            ( ( uint8_t * ) ptr < ( poolArena + poolStats.poolSize ) ) )
+        {
+            for( i = 0; ( i < MBEDTLS_FREERTOS_POOL_CLASSES ) && ( pClass == NULL ); i++ )
+            {
+                if( ( uint8_t * ) ptr < poolClasses[ i ].pEnd )
+                {
+                    pClass = &poolClasses[ i ];
+                }
+            }
+
+            configASSERT( ( ( ( uint8_t * ) ptr - pClass->pStart ) % pClass->blockSize ) == 0 );
+
+            taskENTER_CRITICAL();
+            *( void ** ) ptr = pClass->pFreeList;
+            pClass->pFreeList = ptr;
+            poolStats.current -= pClass->blockSize;
+            taskEXIT_CRITICAL();
+        }
+        else
+        {
+            vPortFree( ptr );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Allocator used for mbed TLS memory.
+ */
+    #define PLATFORM_MALLOC( size )    poolAlloc( size )
+    #define PLATFORM_FREE( ptr )       poolFree( ptr )
+
+#else /* MBEDTLS_FREERTOS_POOL == 1 */
+
+    #define PLATFORM_MALLOC( size )    pvPortMalloc( size )
+    #define PLATFORM_FREE( ptr )       vPortFree( ptr )
+
+#endif /* MBEDTLS_FREERTOS_POOL == 1 */
+
+/*-----------------------------------------------------------*/
+
+#if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+
+/**
+ * @brief Marks an allocation not charged to any account.
+ */
+    #define HEAP_NO_ACCOUNT      ( 0xFFFFU )
+
+/**
+ * @brief Size of the allocation header, keeping the returned memory aligned.
+ */
+    #define HEAP_HEADER_SIZE     ( ( sizeof( HeapHeader_t ) + portBYTE_ALIGNMENT_MASK ) & ~( ( size_t ) portBYTE_ALIGNMENT_MASK ) )
+
+/**
+ * @brief Heap usage charged to one account.
+ */
+    typedef struct HeapAccount
+    {
+        BaseType_t inUse;          /**< @brief pdTRUE while the account is open. */
+        uint16_t generation;       /**< @brief Changed on close, so frees of older allocations are not counted. */
+        TaskHandle_t attachedTask; /**< @brief Task whose allocations are charged, NULL if none. */
+        size_t current;            /**< @brief Bytes currently allocated. */
+        size_t peak;               /**< @brief Most bytes allocated at any time. */
+    } HeapAccount_t;
+
+/**
+ * @brief Header in front of every allocation.
+ */
+    typedef struct HeapHeader
+    {
+        size_t size;         /**< @brief Size requested by mbed TLS. */
+        uint16_t account;    /**< @brief Account charged, or HEAP_NO_ACCOUNT. */
+        uint16_t generation; /**< @brief Generation of the account when charged. */
+    } HeapHeader_t;
+
+/**
+ * @brief Heap accounts.
+ */
+    static HeapAccount_t heapAccounts[ MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS ];
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Allocate memory with a header, charging it to the account the
+ * calling task is attached to.
+ *
+ * @param[in] size Number of bytes to allocate.
+ *
+ * @return Pointer to the memory after the header, or NULL.
+ */
+    static void * heapStatsAlloc( size_t size )
+    {
+        uint8_t * pBlock = NULL;
+        HeapHeader_t * pHeader;
+        TaskHandle_t currentTask = xTaskGetCurrentTaskHandle();
+        uint16_t i;
+
+        if( size <= ( ( size_t ) -1 - HEAP_HEADER_SIZE ) )
+        {
+            pBlock = PLATFORM_MALLOC( HEAP_HEADER_SIZE + size );
+        }
+
+        if( pBlock != NULL )
+        {
+            pHeader = ( HeapHeader_t * ) pBlock;
+            pHeader->size = size;
+            pHeader->account = HEAP_NO_ACCOUNT;
+            pHeader->generation = 0;
+
+            taskENTER_CRITICAL();
+
+            for( i = 0; i < MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS; i++ )
+            {
+                if( ( heapAccounts[ i ].inUse == pdTRUE ) &&
+                    ( heapAccounts[ i ].attachedTask == currentTask ) )
+                {
+                    heapAccounts[ i ].current += size;
+
+                    if( heapAccounts[ i ].current > heapAccounts[ i ].peak )
+                    {
+                        heapAccounts[ i ].peak = heapAccounts[ i ].current;
+                    }
+
+                    pHeader->account = i;
+                    pHeader->generation = heapAccounts[ i ].generation;
+                    break;
+                }
+            }
+
+            taskEXIT_CRITICAL();
+
+            pBlock += HEAP_HEADER_SIZE;
+        }
+
+        return pBlock;
+    }
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Free memory allocated by heapStatsAlloc, crediting its account.
+ *
+ * @param[in] ptr Pointer returned by heapStatsAlloc, or NULL.
+ */
+    static void heapStatsFree( void * ptr )
+    {
+        HeapHeader_t * pHeader;
+        HeapAccount_t * pAccount;
+
+        if( ptr != NULL )
+        {
+            pHeader = ( HeapHeader_t * ) ( ( uint8_t * ) ptr - HEAP_HEADER_SIZE );
+
+            if( pHeader->account != HEAP_NO_ACCOUNT )
+            {
+                pAccount = &heapAccounts[ pHeader->account ];
+
+                taskENTER_CRITICAL();
+
+                if( ( pAccount->inUse == pdTRUE ) &&
+                    ( pAccount->generation == pHeader->generation ) )
+                {
+                    pAccount->current -= pHeader->size;
+                }
+
+                taskEXIT_CRITICAL();
+            }
+
+            PLATFORM_FREE( pHeader );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* MBEDTLS_FREERTOS_HEAP_STATS == 1 */
+
 /**
  * @brief Allocates memory for an array of members.
  *
@@ -41,7 +411,11 @@ void * mbedtls_platform_calloc( size_t nmemb,
         /* Overflow check. */
         if( ( totalSize / size ) == nmemb )
         {
-            pBuffer = pvPortMalloc( totalSize );
+            #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+                pBuffer = heapStatsAlloc( totalSize );
+            #else
+                pBuffer = PLATFORM_MALLOC( totalSize );
+            #endif
 
             if( pBuffer != NULL )
             {
@@ -61,10 +435,112 @@ void * mbedtls_platform_calloc( size_t nmemb,
  */
 void mbedtls_platform_free( void * ptr )
 {
-    vPortFree( ptr );
+    #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+        heapStatsFree( ptr );
+    #else
+        PLATFORM_FREE( ptr );
+    #endif
 }
 /*-----------------------------------------------------------*/
 
+#if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+
+    int32_t mbedtls_platform_heap_stats_open( void )
+    {
+        int32_t account = -1;
+        uint16_t i;
+
+        taskENTER_CRITICAL();
+
+        for( i = 0; i < MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS; i++ )
+        {
+            if( heapAccounts[ i ].inUse == pdFALSE )
+            {
+                heapAccounts[ i ].inUse = pdTRUE;
+                heapAccounts[ i ].attachedTask = NULL;
+                heapAccounts[ i ].current = 0;
+                heapAccounts[ i ].peak = 0;
+                account = ( int32_t ) i;
+                break;
+            }
+        }
+
+        taskEXIT_CRITICAL();
+
+        return account;
+    }
+/*-----------------------------------------------------------*/
+
+    void mbedtls_platform_heap_stats_close( int32_t account )
+    {
+        if( ( account >= 0 ) && ( account < MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS ) )
+        {
+            taskENTER_CRITICAL();
+            heapAccounts[ account ].inUse = pdFALSE;
+            heapAccounts[ account ].attachedTask = NULL;
+            heapAccounts[ account ].generation++;
+            taskEXIT_CRITICAL();
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    void mbedtls_platform_heap_stats_attach( int32_t account )
+    {
+        /* A task charges one account at a time. */
+        mbedtls_platform_heap_stats_detach();
+
+        if( ( account >= 0 ) && ( account < MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS ) )
+        {
+            heapAccounts[ account ].attachedTask = xTaskGetCurrentTaskHandle();
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    void mbedtls_platform_heap_stats_detach( void )
+    {
+        TaskHandle_t currentTask = xTaskGetCurrentTaskHandle();
+        uint16_t i;
+
+        for( i = 0; i < MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS; i++ )
+        {
+            if( heapAccounts[ i ].attachedTask == currentTask )
+            {
+                heapAccounts[ i ].attachedTask = NULL;
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    void mbedtls_platform_heap_stats_get( int32_t account,
+                                          size_t * pCurrent,
+                                          size_t * pPeak )
+    {
+        configASSERT( ( account >= 0 ) && ( account < MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS ) );
+        configASSERT( ( pCurrent != NULL ) && ( pPeak != NULL ) );
+
+        taskENTER_CRITICAL();
+        *pCurrent = heapAccounts[ account ].current;
+        *pPeak = heapAccounts[ account ].peak;
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* MBEDTLS_FREERTOS_HEAP_STATS == 1 */
+
+#if ( MBEDTLS_FREERTOS_POOL == 1 )
+
+    void mbedtls_platform_pool_stats_get( mbedtls_platform_pool_stats_t * pStats )
+    {
+        configASSERT( pStats != NULL );
+
+        taskENTER_CRITICAL();
+        *pStats = poolStats;
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* MBEDTLS_FREERTOS_POOL == 1 */
+
 /**
  * @brief Sends data over FreeRTOS+TCP sockets.
  *
@@ -188,3 +664,296 @@ int mbedtls_platform_mutex_unlock( mbedtls_threading_mutex_t * pMutex )
     return 0;
 }
 /*-----------------------------------------------------------*/
+
+#if defined( MBEDTLS_ECDH_GEN_PUBLIC_ALT )
+
+/**
+ * @brief State of a precomputed key slot.
+ */
+    typedef enum EcdheSlotState
+    {
+        ECDHE_SLOT_EMPTY = 0, /**< @brief Free for the key generation task. */
+        ECDHE_SLOT_BUSY,      /**< @brief Being filled, taken or dropped. */
+        ECDHE_SLOT_READY      /**< @brief Holds a key no handshake has used. */
+    } EcdheSlotState_t;
+
+/**
+ * @brief A precomputed ephemeral key.
+ */
+    typedef struct EcdheSlot
+    {
+        EcdheSlotState_t state;       /**< @brief Changed only inside a critical section. */
+        mbedtls_ecp_group_id groupId; /**< @brief Curve of the key. */
+        mbedtls_mpi d;                /**< @brief Private key. */
+        mbedtls_ecp_point Q;          /**< @brief Public key. */
+    } EcdheSlot_t;
+
+/**
+ * @brief Precomputed keys.
+ */
+    static EcdheSlot_t ecdheSlots[ MBEDTLS_FREERTOS_ECDHE_KEYS ];
+
+/**
+ * @brief Key generation task, NULL until started.
+ */
+    static TaskHandle_t ecdheTask = NULL;
+
+/**
+ * @brief Curve to generate keys for.
+ */
+    static volatile mbedtls_ecp_group_id ecdheGroup = MBEDTLS_FREERTOS_ECDHE_GROUP;
+
+/**
+ * @brief Random number generator of the key generation task.
+ */
+    static int ( * ecdheRng )( void *, unsigned char *, size_t );
+    static void * ecdheRngContext;
+
+/**
+ * @brief Key usage.
+ */
+    static mbedtls_platform_ecdhe_stats_t ecdheStats;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Mark the first slot in a state, on a curve, as busy.
+ *
+ * @param[in] state State to look for.
+ * @param[in] groupId Curve to look for, MBEDTLS_ECP_DP_NONE for any.
+ * @param[in] sameGroup pdFALSE to look for any curve but groupId instead.
+ *
+ * @return The slot, or NULL if there is none.
+ */
+    static EcdheSlot_t * ecdheClaim( EcdheSlotState_t state,
+                                     mbedtls_ecp_group_id groupId,
+                                     BaseType_t sameGroup )
+    {
+        EcdheSlot_t * pSlot = NULL;
+        size_t i;
+
+        taskENTER_CRITICAL();
+
+        for( i = 0; i < MBEDTLS_FREERTOS_ECDHE_KEYS; i++ )
+        {
+            if( ( ecdheSlots[ i ].state == state ) &&
+                ( ( groupId == MBEDTLS_ECP_DP_NONE ) ||
+                  ( ( ecdheSlots[ i ].groupId == groupId ) == ( sameGroup == pdTRUE ) ) ) )
+            {
+                ecdheSlots[ i ].state = ECDHE_SLOT_BUSY;
+                pSlot = &ecdheSlots[ i ];
+                break;
+            }
+        }
+
+        taskEXIT_CRITICAL();
+
+        return pSlot;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Wipe a busy slot and hand it back to the key generation task.
+ *
+ * @param[in] pSlot Slot to release.
+ */
+    static void ecdheRelease( EcdheSlot_t * pSlot )
+    {
+        /* Zeroizes the private key. */
+        mbedtls_mpi_free( &( pSlot->d ) );
+        mbedtls_ecp_point_free( &( pSlot->Q ) );
+
+        taskENTER_CRITICAL();
+        pSlot->groupId = MBEDTLS_ECP_DP_NONE;
+        pSlot->state = ECDHE_SLOT_EMPTY;
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Keep every slot filled with a key for the curve last asked for.
+ *
+ * Sleeps until a handshake takes a key or asks for another curve.
+ *
+ * @param[in] pParameters Unused.
+ */
+    static void ecdheTaskFunction( void * pParameters )
+    {
+        mbedtls_ecp_group group;
+        mbedtls_ecp_group_id groupId;
+        EcdheSlot_t * pSlot;
+        int ret;
+
+        ( void ) pParameters;
+
+        /* The group keeps the precomputed multiples of its generator between
+         * keys, so it stays loaded while the curve does not change. */
+        mbedtls_ecp_group_init( &group );
+
+        for( ; ; )
+        {
+            groupId = ecdheGroup;
+
+            while( ( pSlot = ecdheClaim( ECDHE_SLOT_READY, groupId, pdFALSE ) ) != NULL )
+            {
+                ecdheRelease( pSlot );
+
+                taskENTER_CRITICAL();
+                ecdheStats.discarded++;
+                taskEXIT_CRITICAL();
+            }
+
+            ret = 0;
+
+            if( group.id != groupId )
+            {
+                mbedtls_ecp_group_free( &group );
+                mbedtls_ecp_group_init( &group );
+                ret = mbedtls_ecp_group_load( &group, groupId );
+            }
+
+            if( ( ret == 0 ) &&
+                ( ( pSlot = ecdheClaim( ECDHE_SLOT_EMPTY, MBEDTLS_ECP_DP_NONE, pdTRUE ) ) != NULL ) )
+            {
+                mbedtls_mpi_init( &( pSlot->d ) );
+                mbedtls_ecp_point_init( &( pSlot->Q ) );
+
+                ret = mbedtls_ecp_gen_keypair( &group, &( pSlot->d ), &( pSlot->Q ),
+                                               ecdheRng, ecdheRngContext );
+
+                if( ret == 0 )
+                {
+                    taskENTER_CRITICAL();
+                    pSlot->groupId = groupId;
+                    pSlot->state = ECDHE_SLOT_READY;
+                    ecdheStats.precomputed++;
+                    taskEXIT_CRITICAL();
+                }
+                else
+                {
+                    ecdheRelease( pSlot );
+                }
+            }
+            else
+            {
+                /* All slots full; a failure is retried on the next use. */
+                ret = -1;
+            }
+
+            if( ret != 0 )
+            {
+                ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    int mbedtls_platform_ecdhe_start( int ( * f_rng )( void *, unsigned char *, size_t ),
+                                      void * p_rng )
+    {
+        int ret = 0;
+
+        configASSERT( f_rng != NULL );
+
+        if( ecdheTask == NULL )
+        {
+            ecdheRng = f_rng;
+            ecdheRngContext = p_rng;
+
+            if( xTaskCreate( ecdheTaskFunction,
+                             "EcdheKeys",
+                             MBEDTLS_FREERTOS_ECDHE_TASK_STACK_SIZE,
+                             NULL,
+                             MBEDTLS_FREERTOS_ECDHE_TASK_PRIORITY,
+                             &ecdheTask ) != pdPASS )
+            {
+                ecdheTask = NULL;
+                ret = MBEDTLS_ERR_ECP_ALLOC_FAILED;
+            }
+        }
+
+        return ret;
+    }
+/*-----------------------------------------------------------*/
+
+    void mbedtls_platform_ecdhe_stats_get( mbedtls_platform_ecdhe_stats_t * pStats )
+    {
+        configASSERT( pStats != NULL );
+
+        taskENTER_CRITICAL();
+        *pStats = ecdheStats;
+        taskEXIT_CRITICAL();
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Generate an ECDH key pair, replacing the mbed TLS implementation.
+ *
+ * Hands out a precomputed key for the curve if one is ready; otherwise,
+ * generates one as mbed TLS would.
+ *
+ * @param[in] grp Curve.
+ * @param[out] d Private key.
+ * @param[out] Q Public key.
+ * @param[in] f_rng Random number generator.
+ * @param[in] p_rng Context of f_rng.
+ *
+ * @return 0 on success; otherwise, an mbed TLS error code.
+ */
+    int mbedtls_ecdh_gen_public( mbedtls_ecp_group * grp,
+                                 mbedtls_mpi * d,
+                                 mbedtls_ecp_point * Q,
+                                 int ( * f_rng )( void *, unsigned char *, size_t ),
+                                 void * p_rng )
+    {
+        EcdheSlot_t * pSlot = NULL;
+        int ret = -1;
+
+        if( ( ecdheTask != NULL ) && ( grp->id != MBEDTLS_ECP_DP_NONE ) )
+        {
+            /* Follow the curve the servers pick. */
+            ecdheGroup = grp->id;
+            pSlot = ecdheClaim( ECDHE_SLOT_READY, grp->id, pdTRUE );
+        }
+
+        if( pSlot != NULL )
+        {
+            ret = mbedtls_mpi_copy( d, &( pSlot->d ) );
+
+            if( ret == 0 )
+            {
+                ret = mbedtls_ecp_copy( Q, &( pSlot->Q ) );
+            }
+
+            /* Each key is used once, even if copying it failed. */
+            ecdheRelease( pSlot );
+        }
+
+        taskENTER_CRITICAL();
+
+        if( ret == 0 )
+        {
+            ecdheStats.hits++;
+        }
+        else
+        {
+            ecdheStats.misses++;
+        }
+
+        taskEXIT_CRITICAL();
+
+        if( ret != 0 )
+        {
+            ret = mbedtls_ecp_gen_keypair( grp, d, Q, f_rng, p_rng );
+        }
+
+        if( ecdheTask != NULL )
+        {
+            xTaskNotifyGive( ecdheTask );
+        }
+
+        return ret;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* MBEDTLS_ECDH_GEN_PUBLIC_ALT */
@@ -0,0 +1,212 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file mbedtls_freertos_port.h
+ * @brief Heap accounting for the mbed TLS platform functions on FreeRTOS.
+ */
+
+#ifndef MBEDTLS_FREERTOS_PORT_H
+#define MBEDTLS_FREERTOS_PORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Set to 1 to count the heap mbed TLS allocates on behalf of each
+ * TLS connection.
+ *
+ * Every mbed TLS allocation then carries a small header recording its size
+ * and owner, so leave this off in production builds.
+ */
+#ifndef MBEDTLS_FREERTOS_HEAP_STATS
+    #define MBEDTLS_FREERTOS_HEAP_STATS    ( 0 )
+#endif
+
+/**
+ * @brief Number of heap accounts that can be open at the same time.
+ */
+#ifndef MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS
+    #define MBEDTLS_FREERTOS_HEAP_STATS_ACCOUNTS    ( 4 )
+#endif
+
+#if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+
+/**
+ * @brief Open a heap account.
+ *
+ * @return Account handle, or -1 if all accounts are in use.
+ */
+    int32_t mbedtls_platform_heap_stats_open( void );
+
+/**
+ * @brief Close a heap account. Memory still allocated to it is no longer
+ * counted anywhere.
+ *
+ * @param[in] account Account handle, ignored if -1.
+ */
+    void mbedtls_platform_heap_stats_close( int32_t account );
+
+/**
+ * @brief Charge the allocations the calling task makes to an account, until
+ * #mbedtls_platform_heap_stats_detach.
+ *
+ * @param[in] account Account handle, ignored if -1.
+ */
+    void mbedtls_platform_heap_stats_attach( int32_t account );
+
+/**
+ * @brief Stop charging the allocations of the calling task to an account.
+ */
+    void mbedtls_platform_heap_stats_detach( void );
+
+/**
+ * @brief Get the heap usage of an account.
+ *
+ * @param[in] account Account handle.
+ * @param[out] pCurrent Bytes currently allocated.
+ * @param[out] pPeak Most bytes allocated at any time.
+ */
+    void mbedtls_platform_heap_stats_get( int32_t account,
+                                          size_t * pCurrent,
+                                          size_t * pPeak );
+
+#endif /* MBEDTLS_FREERTOS_HEAP_STATS == 1 */
+
+/**
+ * @brief Set to 1 to serve small mbed TLS allocations from a pool of fixed
+ * size blocks instead of the FreeRTOS heap.
+ *
+ * A handshake makes hundreds of small, short lived allocations. Keeping them
+ * out of the heap stops them from fragmenting it over many reconnects.
+ * Allocations larger than the largest block, or made while their size class
+ * is exhausted, still go to pvPortMalloc.
+ */
+#ifndef MBEDTLS_FREERTOS_POOL
+    #define MBEDTLS_FREERTOS_POOL    ( 0 )
+#endif
+
+/**
+ * @brief Block size of each pool size class, in increasing order. Each must be
+ * a multiple of portBYTE_ALIGNMENT.
+ */
+#ifndef MBEDTLS_FREERTOS_POOL_CLASS_SIZES
+    #define MBEDTLS_FREERTOS_POOL_CLASS_SIZES    { 32, 64, 128, 256, 512 }
+#endif
+
+/**
+ * @brief Number of blocks in each pool size class.
+ */
+#ifndef MBEDTLS_FREERTOS_POOL_CLASS_BLOCKS
+    #define MBEDTLS_FREERTOS_POOL_CLASS_BLOCKS    { 64, 48, 24, 12, 6 }
+#endif
+
+/**
+ * @brief Number of pool size classes, the length of both lists above.
+ */
+#ifndef MBEDTLS_FREERTOS_POOL_CLASSES
+    #define MBEDTLS_FREERTOS_POOL_CLASSES    ( 5 )
+#endif
+
+#if ( MBEDTLS_FREERTOS_POOL == 1 )
+
+/**
+ * @brief Pool usage, see #mbedtls_platform_pool_stats_get.
+ */
+    typedef struct mbedtls_platform_pool_stats
+    {
+        uint32_t hits;           /**< @brief Allocations served from the pool. */
+        uint32_t misses;         /**< @brief Allocations passed to pvPortMalloc. */
+        uint32_t exhausted;      /**< @brief Misses because the size class had no free block. */
+        size_t poolSize;         /**< @brief Bytes in the pool. */
+        size_t current;          /**< @brief Bytes of pool blocks in use. */
+        size_t peak;             /**< @brief Most bytes of pool blocks in use at any time. */
+        uint64_t requestedBytes; /**< @brief Bytes requested by the allocations served from the pool. */
+        uint64_t blockBytes;     /**< @brief Bytes of the blocks that served them. Compared to requestedBytes
+                                  *   this gives the memory lost to rounding up to a block size. */
+    } mbedtls_platform_pool_stats_t;
+
+/**
+ * @brief Get the pool usage since start up.
+ *
+ * @param[out] pStats Receives the usage.
+ */
+    void mbedtls_platform_pool_stats_get( mbedtls_platform_pool_stats_t * pStats );
+
+#endif /* MBEDTLS_FREERTOS_POOL == 1 */
+
+/*
+ * Define MBEDTLS_ECDH_GEN_PUBLIC_ALT in mbedtls_config.h to generate ECDHE
+ * ephemeral keys ahead of time, in a low priority task, instead of in the
+ * middle of the handshake. Each key is still used for one handshake only.
+ * Only the TLS 1.2 key exchange of mbed TLS goes through this; TLS 1.3 uses
+ * PSA crypto. Include this header after the mbed TLS configuration.
+ */
+
+/**
+ * @brief Number of ECDHE keys kept ready.
+ */
+#ifndef MBEDTLS_FREERTOS_ECDHE_KEYS
+    #define MBEDTLS_FREERTOS_ECDHE_KEYS    ( 1 )
+#endif
+
+/**
+ * @brief Curve of the keys generated before the first handshake. Later keys
+ * are for the curve the last handshake used.
+ */
+#ifndef MBEDTLS_FREERTOS_ECDHE_GROUP
+    #define MBEDTLS_FREERTOS_ECDHE_GROUP    MBEDTLS_ECP_DP_SECP256R1
+#endif
+
+/**
+ * @brief Priority of the key generation task. At the idle priority it only
+ * runs when nothing else has work to do.
+ */
+#ifndef MBEDTLS_FREERTOS_ECDHE_TASK_PRIORITY
+    #define MBEDTLS_FREERTOS_ECDHE_TASK_PRIORITY    ( tskIDLE_PRIORITY )
+#endif
+
+/**
+ * @brief Stack size of the key generation task, in words.
+ */
+#ifndef MBEDTLS_FREERTOS_ECDHE_TASK_STACK_SIZE
+    #define MBEDTLS_FREERTOS_ECDHE_TASK_STACK_SIZE    ( 1024 )
+#endif
+
+#if defined( MBEDTLS_ECDH_GEN_PUBLIC_ALT )
+
+/**
+ * @brief ECDHE key usage, see #mbedtls_platform_ecdhe_stats_get.
+ */
+    typedef struct mbedtls_platform_ecdhe_stats
+    {
+        uint32_t precomputed; /**< @brief Keys generated by the background task. */
+        uint32_t hits;        /**< @brief Handshakes that found a key ready. */
+        uint32_t misses;      /**< @brief Handshakes that generated their own key. */
+        uint32_t discarded;   /**< @brief Keys dropped because the curve changed. */
+    } mbedtls_platform_ecdhe_stats_t;
+
+/**
+ * @brief Start the task that keeps #MBEDTLS_FREERTOS_ECDHE_KEYS keys ready.
+ * Does nothing if it is already running.
+ *
+ * @param[in] f_rng Random number generator for the keys. It must be safe to
+ * call from another task.
+ * @param[in] p_rng Context of f_rng.
+ *
+ * @return 0 on success, or MBEDTLS_ERR_ECP_ALLOC_FAILED if the task could
+ * not be created. Handshakes then generate their own keys.
+ */
+    int mbedtls_platform_ecdhe_start( int ( * f_rng )( void *, unsigned char *, size_t ),
+                                      void * p_rng );
+
+/**
+ * @brief Get the ECDHE key usage since start up.
+ *
+ * @param[out] pStats Receives the usage.
+ */
+    void mbedtls_platform_ecdhe_stats_get( mbedtls_platform_ecdhe_stats_t * pStats );
+
+#endif /* MBEDTLS_ECDH_GEN_PUBLIC_ALT */
+
+#endif /* MBEDTLS_FREERTOS_PORT_H */
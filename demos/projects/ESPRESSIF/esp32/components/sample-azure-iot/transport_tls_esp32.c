@@ -173,6 +173,35 @@ int32_t TLS_Socket_Recv( NetworkContext_t * pNetworkContext,
 }
 /*-----------------------------------------------------------*/
 
+int32_t TLS_Socket_Poll( NetworkContext_t * pNetworkContext,
+                         TickType_t xTimeoutTicks )
+{
+    int32_t tlsStatus = 0;
+    int timeoutMs = -1;
+
+    if (( pNetworkContext == NULL ))
+    {
+        ESP_LOGE( TAG, "Invalid input parameter(s): Arguments cannot be NULL. pNetworkContext=%p.", pNetworkContext );
+        return eTLSTransportInvalidParameter;
+    }
+
+    if ( xTimeoutTicks != portMAX_DELAY )
+    {
+        timeoutMs = ( int ) ( xTimeoutTicks * portTICK_PERIOD_MS );
+    }
+
+    /* The SSL transport also reports data esp-tls already decrypted. */
+    tlsStatus = esp_transport_poll_read( pNetworkContext->xTransport, timeoutMs );
+    if ( tlsStatus < 0 )
+    {
+        ESP_LOGE( TAG, "Polling failed, errno= %d", errno );
+        return ESP_FAIL;
+    }
+
+    return ( tlsStatus > 0 ) ? 1 : 0;
+}
+/*-----------------------------------------------------------*/
+
 int32_t TLS_Socket_Send( NetworkContext_t * pNetworkContext,
                            const void * pBuffer,
                            size_t xBytesToSend )
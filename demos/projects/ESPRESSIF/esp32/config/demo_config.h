@@ -165,6 +165,12 @@
  */
 #define democonfigIOTHUB_PORT 8883
 
+/**
+ * @brief esp-tls resolves host names itself, so there is no sockets host
+ * name cache to refresh.
+ */
+#define democonfigSOCKETS_DNS_CACHE 0
+
 /**
  * @brief Defines configRAND32, used by the common sample modules.
  */
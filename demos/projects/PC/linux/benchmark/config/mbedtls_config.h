@@ -0,0 +1,22 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+/* This file configures mbed TLS for the TLS benchmark: the Linux demo
+ * configuration, plus what the loopback server needs. */
+
+#ifndef BENCHMARK_MBEDTLS_CONFIG_H
+#define BENCHMARK_MBEDTLS_CONFIG_H
+
+/* Server side TLS with session tickets. */
+#define MBEDTLS_SSL_SRV_C
+#define MBEDTLS_SSL_TICKET_C
+
+/* The mbed TLS test certificates. Their CA key is on P-384. */
+#define MBEDTLS_CERTS_C
+#define MBEDTLS_ECP_DP_SECP384R1_ENABLED
+#define MBEDTLS_SHA512_C
+
+/* The client keeps exactly the configuration of the demo. */
+#include "../../config/mbedtls_config.h"
+
+#endif /* ifndef BENCHMARK_MBEDTLS_CONFIG_H */
@@ -0,0 +1,845 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file tls_benchmark.c
+ * @brief Loopback benchmark of the TLS transport.
+ *
+ * Drives transport_tls_socket_using_mbedtls.c, over host sockets, against an
+ * mbed TLS server in a child process. Results are printed to stdout as one
+ * JSON object per line; logs go to stderr.
+ */
+
+/* Standard includes. */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX includes. */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* mbed TLS includes, for the test certificates. */
+#include "mbedtls/certs.h"
+
+/* TLS transport includes. */
+#include "transport_tls_socket.h"
+#include "mbedtls_freertos_port.h"
+
+#include "tls_benchmark.h"
+
+/**
+ * @brief Handshakes timed in each handshake run.
+ */
+#ifndef benchmarkHANDSHAKES
+    #define benchmarkHANDSHAKES    ( 200 )
+#endif
+
+/**
+ * @brief Bytes moved by each bulk transfer run.
+ */
+#ifndef benchmarkBULK_BYTES
+    #define benchmarkBULK_BYTES    ( 8U * 1024U * 1024U )
+#endif
+
+/**
+ * @brief Connect and disconnect cycles of the soak run.
+ */
+#ifndef benchmarkSOAK_CYCLES
+    #define benchmarkSOAK_CYCLES    ( 1000 )
+#endif
+
+/**
+ * @brief Receive and send timeout of the benchmark connections.
+ */
+#define benchmarkTIMEOUT_MS        ( 10000U )
+
+/**
+ * @brief Stack of the benchmark task, in words. mbed TLS runs the handshake
+ * on it.
+ */
+#define benchmarkTASK_STACK_SIZE    ( 8192 )
+
+/**
+ * @brief Above the timer task, so host calls that block the scheduler thread
+ * are never preempted.
+ */
+#define benchmarkTASK_PRIORITY      ( configMAX_PRIORITIES - 1 )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    TlsTransportParams_t * pParams;
+};
+
+/**
+ * @brief Result of one handshake run.
+ */
+typedef struct BenchmarkHandshakeResult
+{
+    uint32_t ulConnects;
+    uint32_t ulFailures;
+    uint32_t ulResumed;
+    uint64_t ullElapsedUs;
+    uint64_t ullCpuUs;
+    size_t xHeapPeak;
+    size_t xHeapSteady;
+    const char * pcCiphersuite;
+} BenchmarkHandshakeResult_t;
+
+static NetworkContext_t xNetworkContext;
+static TlsTransportParams_t xTlsTransportParams;
+
+static uint16_t usFullPort;
+static uint16_t usResumePort;
+static int lServerControl = -1;
+static pid_t xServerPid = -1;
+
+static uint32_t ulLatencyUs[ benchmarkHANDSHAKES ];
+static uint8_t ucBulkBuffer[ benchmarkMAX_WRITE_SIZE ];
+
+/* Write sizes of the bulk runs. Sizes above the negotiated maximum fragment
+ * length are split into several records by mbed TLS. */
+static const uint32_t ulWriteSizes[] = { 256, 1024, 4096, 16384 };
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Monotonic host time in microseconds. The tick is too coarse to time
+ * a loopback handshake.
+ */
+static uint64_t prvTimeUs( void );
+
+/**
+ * @brief CPU time used by the calling thread in microseconds. The server runs
+ * in another process and other tasks in other threads, so only the work of
+ * the benchmark task is counted.
+ */
+static uint64_t prvCpuTimeUs( void );
+
+/**
+ * @brief Credentials trusting the mbed TLS test EC CA.
+ */
+static void prvCredentials( NetworkCredentials_t * pxCredentials,
+                            TlsTransportProfile_t xProfile );
+
+/**
+ * @brief Connect, time the connect, and record the connection metrics.
+ *
+ * @return pdPASS if connected; otherwise, pdFAIL.
+ */
+static BaseType_t prvTimedConnect( uint16_t usPort,
+                                   const NetworkCredentials_t * pxCredentials,
+                                   BenchmarkHandshakeResult_t * pxResult );
+
+/**
+ * @brief Time the connect that parses the credentials apart from connects
+ * that find them in the credential store, and print the result.
+ */
+static void prvRunCredentials( void );
+
+/**
+ * @brief Time #benchmarkHANDSHAKES connects and print the result.
+ */
+static void prvRunHandshakes( const char * pcName,
+                              uint16_t usPort,
+                              TlsTransportProfile_t xProfile );
+
+/**
+ * @brief Time one bulk transfer on the connection in xNetworkContext and
+ * print the result.
+ *
+ * @return pdPASS if the transfer completed; otherwise, pdFAIL.
+ */
+static BaseType_t prvRunBulk( const char * pcName,
+                              uint8_t ucCommand,
+                              uint32_t ulWriteSize,
+                              BaseType_t xBorrow );
+
+/**
+ * @brief Connect and disconnect #benchmarkSOAK_CYCLES times and print how
+ * much FreeRTOS heap was not given back.
+ *
+ * @return pdPASS if every cycle connected and the free heap is unchanged;
+ * otherwise, pdFAIL.
+ */
+static BaseType_t prvRunSoak( void );
+
+/**
+ * @brief Print heap high-water marks, and the pool and ECDHE key usage if
+ * enabled.
+ */
+static void prvReportHeap( void );
+
+/**
+ * @brief Task running all benchmarks, then exiting the process.
+ */
+static void prvBenchmarkTask( void * pvParameters );
+
+/**
+ * @brief Open a loopback listening socket on any free port.
+ *
+ * @return The socket, or -1 on failure.
+ */
+static int prvListen( uint16_t * pusPort );
+/*-----------------------------------------------------------*/
+
+static uint64_t prvTimeUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000U ) + ( ( uint64_t ) xNow.tv_nsec / 1000U );
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvCpuTimeUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_THREAD_CPUTIME_ID, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000U ) + ( ( uint64_t ) xNow.tv_nsec / 1000U );
+}
+/*-----------------------------------------------------------*/
+
+static int prvCompareLatency( const void * pvLeft,
+                              const void * pvRight )
+{
+    uint32_t ulLeft = *( ( const uint32_t * ) pvLeft );
+    uint32_t ulRight = *( ( const uint32_t * ) pvRight );
+
+    return ( ulLeft > ulRight ) - ( ulLeft < ulRight );
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvPercentile( uint32_t ulCount,
+                               uint32_t ulPercent )
+{
+    /* Nearest rank, on sorted latencies. */
+    uint32_t ulRank = ( ( ulCount * ulPercent ) + 99U ) / 100U;
+
+    return ( ulRank == 0U ) ? 0U : ulLatencyUs[ ulRank - 1U ];
+}
+/*-----------------------------------------------------------*/
+
+static void prvCredentials( NetworkCredentials_t * pxCredentials,
+                            TlsTransportProfile_t xProfile )
+{
+    ( void ) memset( pxCredentials, 0, sizeof( *pxCredentials ) );
+
+    pxCredentials->xProfile = xProfile;
+    pxCredentials->pucRootCa = ( const uint8_t * ) mbedtls_test_ca_crt_ec;
+    pxCredentials->xRootCaSize = mbedtls_test_ca_crt_ec_len;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTimedConnect( uint16_t usPort,
+                                   const NetworkCredentials_t * pxCredentials,
+                                   BenchmarkHandshakeResult_t * pxResult )
+{
+    TlsConnectMetrics_t xMetrics;
+    uint64_t ullStart = prvTimeUs();
+    uint64_t ullCpuStart = prvCpuTimeUs();
+    BaseType_t xResult = pdFAIL;
+
+    #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+        TlsTransportHeapStats_t xHeapStats;
+    #endif
+
+    if( TLS_Socket_Connect( &xNetworkContext, benchmarkHOST_NAME, usPort, pxCredentials,
+                            benchmarkTIMEOUT_MS, benchmarkTIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        pxResult->ulFailures++;
+    }
+    else
+    {
+        if( pxResult->ulConnects < benchmarkHANDSHAKES )
+        {
+            ulLatencyUs[ pxResult->ulConnects ] = ( uint32_t ) ( prvTimeUs() - ullStart );
+        }
+
+        pxResult->ullCpuUs += prvCpuTimeUs() - ullCpuStart;
+        pxResult->ulConnects++;
+
+        if( ( TLS_Socket_GetConnectMetrics( &xNetworkContext, &xMetrics ) == eTLSTransportSuccess ) &&
+            ( xMetrics.xResumed == pdTRUE ) )
+        {
+            pxResult->ulResumed++;
+        }
+
+        pxResult->pcCiphersuite = TLS_Socket_GetCiphersuite( &xNetworkContext );
+
+        #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+            if( TLS_Socket_GetHeapStats( &xNetworkContext, &xHeapStats ) == eTLSTransportSuccess )
+            {
+                pxResult->xHeapPeak = ( xHeapStats.xPeakBytes > pxResult->xHeapPeak ) ?
+                                      xHeapStats.xPeakBytes : pxResult->xHeapPeak;
+                pxResult->xHeapSteady = ( xHeapStats.xSteadyBytes > pxResult->xHeapSteady ) ?
+                                        xHeapStats.xSteadyBytes : pxResult->xHeapSteady;
+            }
+        #endif
+
+        xResult = pdPASS;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvRunCredentials( void )
+{
+    NetworkCredentials_t xCredentials;
+    BenchmarkHandshakeResult_t xParsed = { 0 };
+    BenchmarkHandshakeResult_t xCached = { 0 };
+    uint32_t ulParsedUs = 0;
+    uint32_t ulIndex;
+
+    /* Set up mbed TLS and the sockets with other credentials, so the first
+     * timed connect only adds parsing the standard ones. */
+    prvCredentials( &xCredentials, eTLSTransportProfileConstrained );
+
+    if( prvTimedConnect( usFullPort, &xCredentials, &xParsed ) == pdPASS )
+    {
+        TLS_Socket_Disconnect( &xNetworkContext );
+    }
+
+    ( void ) memset( &xParsed, 0, sizeof( xParsed ) );
+    prvCredentials( &xCredentials, eTLSTransportProfileStandard );
+
+    if( prvTimedConnect( usFullPort, &xCredentials, &xParsed ) == pdPASS )
+    {
+        ulParsedUs = ulLatencyUs[ 0 ];
+        TLS_Socket_Disconnect( &xNetworkContext );
+    }
+
+    for( ulIndex = 0; ulIndex < benchmarkHANDSHAKES; ulIndex++ )
+    {
+        if( prvTimedConnect( usFullPort, &xCredentials, &xCached ) == pdPASS )
+        {
+            TLS_Socket_Disconnect( &xNetworkContext );
+        }
+    }
+
+    qsort( ulLatencyUs, xCached.ulConnects, sizeof( ulLatencyUs[ 0 ] ), prvCompareLatency );
+
+    printf( "{\"benchmark\":\"credentials\",\"failures\":%" PRIu32
+            ",\"parsed\":{\"latency_us\":%" PRIu32,
+            xParsed.ulFailures + xCached.ulFailures, ulParsedUs );
+
+    #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+        printf( ",\"heap_peak\":%zu", xParsed.xHeapPeak );
+    #endif
+
+    printf( "},\"cached\":{\"connects\":%" PRIu32 ",\"latency_us\":{\"p50\":%" PRIu32 ",\"max\":%" PRIu32 "}",
+            xCached.ulConnects, prvPercentile( xCached.ulConnects, 50 ),
+            prvPercentile( xCached.ulConnects, 100 ) );
+
+    #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+        printf( ",\"heap_peak\":%zu", xCached.xHeapPeak );
+    #endif
+
+    printf( "}}\n" );
+}
+/*-----------------------------------------------------------*/
+
+static void prvRunHandshakes( const char * pcName,
+                              uint16_t usPort,
+                              TlsTransportProfile_t xProfile )
+{
+    NetworkCredentials_t xCredentials;
+    BenchmarkHandshakeResult_t xResult = { 0 };
+    BenchmarkHandshakeResult_t xWarmUp = { 0 };
+    uint64_t ullStart;
+    uint32_t ulIndex;
+
+    prvCredentials( &xCredentials, xProfile );
+
+    /* Parses the credentials and, on the resumption port, obtains the first
+     * session ticket, so that only steady state connects are timed. */
+    if( prvTimedConnect( usPort, &xCredentials, &xWarmUp ) == pdPASS )
+    {
+        TLS_Socket_Disconnect( &xNetworkContext );
+    }
+
+    ullStart = prvTimeUs();
+
+    for( ulIndex = 0; ulIndex < benchmarkHANDSHAKES; ulIndex++ )
+    {
+        if( prvTimedConnect( usPort, &xCredentials, &xResult ) == pdPASS )
+        {
+            TLS_Socket_Disconnect( &xNetworkContext );
+        }
+    }
+
+    xResult.ullElapsedUs = prvTimeUs() - ullStart;
+
+    qsort( ulLatencyUs, xResult.ulConnects, sizeof( ulLatencyUs[ 0 ] ), prvCompareLatency );
+
+    printf( "{\"benchmark\":\"handshake\",\"name\":\"%s\",\"connects\":%" PRIu32 ",\"failures\":%" PRIu32
+            ",\"resumed\":%" PRIu32 ",\"ciphersuite\":\"%s\",\"per_second\":%.1f"
+            ",\"latency_us\":{\"p50\":%" PRIu32 ",\"p90\":%" PRIu32 ",\"p99\":%" PRIu32 ",\"max\":%" PRIu32 "}",
+            pcName, xResult.ulConnects, xResult.ulFailures, xResult.ulResumed,
+            ( xResult.pcCiphersuite != NULL ) ? xResult.pcCiphersuite : "",
+            ( xResult.ullElapsedUs > 0U ) ? ( double ) xResult.ulConnects * 1e6 / ( double ) xResult.ullElapsedUs : 0.0,
+            prvPercentile( xResult.ulConnects, 50 ), prvPercentile( xResult.ulConnects, 90 ),
+            prvPercentile( xResult.ulConnects, 99 ), prvPercentile( xResult.ulConnects, 100 ) );
+
+    printf( ",\"cpu_us\":%" PRIu64,
+            ( xResult.ulConnects > 0U ) ? xResult.ullCpuUs / xResult.ulConnects : 0U );
+
+    #if ( MBEDTLS_FREERTOS_HEAP_STATS == 1 )
+        printf( ",\"connection_heap\":{\"peak\":%zu,\"steady\":%zu}",
+                xResult.xHeapPeak, xResult.xHeapSteady );
+    #endif
+
+    printf( "}\n" );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSendAll( const uint8_t * pucData,
+                              size_t xLength )
+{
+    size_t xOffset = 0;
+    int32_t lSent = 0;
+
+    while( ( lSent >= 0 ) && ( xOffset < xLength ) )
+    {
+        lSent = TLS_Socket_Send( &xNetworkContext, pucData + xOffset, xLength - xOffset );
+
+        if( lSent > 0 )
+        {
+            xOffset += ( size_t ) lSent;
+        }
+    }
+
+    return ( xOffset == xLength ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRunBulk( const char * pcName,
+                              uint8_t ucCommand,
+                              uint32_t ulWriteSize,
+                              BaseType_t xBorrow )
+{
+    uint8_t ucRequest[ benchmarkREQUEST_LENGTH ];
+    const uint8_t * pucBorrowed;
+    uint32_t ulTotal = benchmarkBULK_BYTES;
+    uint32_t ulDone = 0;
+    uint32_t ulChunk;
+    int32_t lReceived = 0;
+    uint64_t ullStart;
+    uint64_t ullElapsedUs;
+    BaseType_t xResult;
+
+    ucRequest[ 0 ] = ucCommand;
+    ucRequest[ 1 ] = ( uint8_t ) ( ulTotal >> 24 );
+    ucRequest[ 2 ] = ( uint8_t ) ( ulTotal >> 16 );
+    ucRequest[ 3 ] = ( uint8_t ) ( ulTotal >> 8 );
+    ucRequest[ 4 ] = ( uint8_t ) ulTotal;
+    ucRequest[ 5 ] = ( uint8_t ) ( ulWriteSize >> 24 );
+    ucRequest[ 6 ] = ( uint8_t ) ( ulWriteSize >> 16 );
+    ucRequest[ 7 ] = ( uint8_t ) ( ulWriteSize >> 8 );
+    ucRequest[ 8 ] = ( uint8_t ) ulWriteSize;
+
+    ullStart = prvTimeUs();
+    xResult = prvSendAll( ucRequest, sizeof( ucRequest ) );
+
+    if( ucCommand == benchmarkCOMMAND_UPLOAD )
+    {
+        while( ( xResult == pdPASS ) && ( ulDone < ulTotal ) )
+        {
+            ulChunk = ( ( ulTotal - ulDone ) < ulWriteSize ) ? ( ulTotal - ulDone ) : ulWriteSize;
+            xResult = prvSendAll( ucBulkBuffer, ulChunk );
+            ulDone += ulChunk;
+        }
+
+        /* The transfer is over once the server has read it all. */
+        ulTotal = 1;
+        ulDone = 0;
+    }
+
+    /* Receive the download, or the one byte acknowledging the upload. A
+     * receive timeout reads 0 bytes, so give up on the first one. */
+    while( ( xResult == pdPASS ) && ( ulDone < ulTotal ) )
+    {
+        if( xBorrow == pdTRUE )
+        {
+            if( ( lReceived = TLS_Socket_RecvBorrow( &xNetworkContext, &pucBorrowed ) ) > 0 )
+            {
+                lReceived = ( ( uint32_t ) lReceived > ( ulTotal - ulDone ) ) ? ( int32_t ) ( ulTotal - ulDone ) : lReceived;
+
+                if( TLS_Socket_RecvRelease( &xNetworkContext, ( size_t ) lReceived ) != eTLSTransportSuccess )
+                {
+                    lReceived = -1;
+                }
+            }
+        }
+        else
+        {
+            ulChunk = ( ( ulTotal - ulDone ) < sizeof( ucBulkBuffer ) ) ? ( ulTotal - ulDone ) : sizeof( ucBulkBuffer );
+            lReceived = TLS_Socket_Recv( &xNetworkContext, ucBulkBuffer, ulChunk );
+        }
+
+        if( lReceived > 0 )
+        {
+            ulDone += ( uint32_t ) lReceived;
+        }
+        else
+        {
+            xResult = pdFAIL;
+        }
+    }
+
+    ullElapsedUs = prvTimeUs() - ullStart;
+
+    printf( "{\"benchmark\":\"bulk\",\"name\":\"%s\",\"write_size\":%" PRIu32 ",\"bytes\":%u"
+            ",\"completed\":%s,\"seconds\":%.6f,\"mb_per_s\":%.2f}\n",
+            pcName, ulWriteSize, benchmarkBULK_BYTES,
+            ( xResult == pdPASS ) ? "true" : "false",
+            ( double ) ullElapsedUs / 1e6,
+            ( ( xResult == pdPASS ) && ( ullElapsedUs > 0U ) ) ?
+            ( double ) benchmarkBULK_BYTES / ( double ) ullElapsedUs : 0.0 );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRunSoak( void )
+{
+    NetworkCredentials_t xCredentials;
+    BenchmarkHandshakeResult_t xResult = { 0 };
+    size_t xFreeBefore;
+    size_t xFreeAfter;
+    uint32_t ulIndex;
+    BaseType_t xPassed;
+
+    #if ( MBEDTLS_FREERTOS_POOL == 1 )
+        mbedtls_platform_pool_stats_t xPoolBefore;
+        mbedtls_platform_pool_stats_t xPoolAfter;
+    #endif
+
+    prvCredentials( &xCredentials, eTLSTransportProfileBuildDefault );
+
+    /* The credential store, session cache and random generator keep their
+     * memory between connections; allocate it before measuring. */
+    if( prvTimedConnect( usFullPort, &xCredentials, &xResult ) == pdPASS )
+    {
+        TLS_Socket_Disconnect( &xNetworkContext );
+    }
+
+    xResult.ulConnects = 0;
+    xResult.ulFailures = 0;
+    xFreeBefore = xPortGetFreeHeapSize();
+
+    #if ( MBEDTLS_FREERTOS_POOL == 1 )
+        mbedtls_platform_pool_stats_get( &xPoolBefore );
+    #endif
+
+    for( ulIndex = 0; ulIndex < benchmarkSOAK_CYCLES; ulIndex++ )
+    {
+        if( prvTimedConnect( usFullPort, &xCredentials, &xResult ) == pdPASS )
+        {
+            TLS_Socket_Disconnect( &xNetworkContext );
+        }
+    }
+
+    xFreeAfter = xPortGetFreeHeapSize();
+    xPassed = ( ( xResult.ulFailures == 0U ) && ( xFreeAfter == xFreeBefore ) ) ? pdPASS : pdFAIL;
+
+    printf( "{\"benchmark\":\"soak\",\"cycles\":%d,\"failures\":%" PRIu32
+            ",\"free_before\":%zu,\"free_after\":%zu,\"leaked_bytes\":%lld,\"passed\":%s",
+            benchmarkSOAK_CYCLES, xResult.ulFailures, xFreeBefore, xFreeAfter,
+            ( long long ) xFreeBefore - ( long long ) xFreeAfter,
+            ( xPassed == pdPASS ) ? "true" : "false" );
+
+    #if ( MBEDTLS_FREERTOS_POOL == 1 )
+        mbedtls_platform_pool_stats_get( &xPoolAfter );
+        printf( ",\"pool\":{\"hits\":%" PRIu32 ",\"misses\":%" PRIu32 ",\"exhausted\":%" PRIu32
+                ",\"current_before\":%zu,\"current_after\":%zu}",
+                xPoolAfter.hits - xPoolBefore.hits,
+                xPoolAfter.misses - xPoolBefore.misses,
+                xPoolAfter.exhausted - xPoolBefore.exhausted,
+                xPoolBefore.current, xPoolAfter.current );
+    #endif
+
+    printf( "}\n" );
+
+    return xPassed;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReportHeap( void )
+{
+    #if ( MBEDTLS_FREERTOS_POOL == 1 )
+        mbedtls_platform_pool_stats_t xPool;
+    #endif
+
+    #if defined( MBEDTLS_ECDH_GEN_PUBLIC_ALT )
+        mbedtls_platform_ecdhe_stats_t xEcdhe;
+    #endif
+
+    printf( "{\"benchmark\":\"heap\",\"total\":%zu,\"free\":%zu,\"min_ever_free\":%zu,\"high_water\":%zu}\n",
+            ( size_t ) configTOTAL_HEAP_SIZE,
+            xPortGetFreeHeapSize(),
+            xPortGetMinimumEverFreeHeapSize(),
+            ( size_t ) configTOTAL_HEAP_SIZE - xPortGetMinimumEverFreeHeapSize() );
+
+    #if ( MBEDTLS_FREERTOS_POOL == 1 )
+        mbedtls_platform_pool_stats_get( &xPool );
+        printf( "{\"benchmark\":\"pool\",\"hits\":%" PRIu32 ",\"misses\":%" PRIu32 ",\"exhausted\":%" PRIu32
+                ",\"pool_size\":%zu,\"peak\":%zu,\"requested_bytes\":%" PRIu64 ",\"block_bytes\":%" PRIu64 "}\n",
+                xPool.hits, xPool.misses, xPool.exhausted, xPool.poolSize, xPool.peak,
+                xPool.requestedBytes, xPool.blockBytes );
+    #endif
+
+    #if defined( MBEDTLS_ECDH_GEN_PUBLIC_ALT )
+        mbedtls_platform_ecdhe_stats_get( &xEcdhe );
+        printf( "{\"benchmark\":\"ecdhe\",\"precomputed\":%" PRIu32 ",\"hits\":%" PRIu32
+                ",\"misses\":%" PRIu32 ",\"discarded\":%" PRIu32 "}\n",
+                xEcdhe.precomputed, xEcdhe.hits, xEcdhe.misses, xEcdhe.discarded );
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static void prvBenchmarkTask( void * pvParameters )
+{
+    NetworkCredentials_t xCredentials;
+    BenchmarkHandshakeResult_t xResult = { 0 };
+    BaseType_t xConnected = pdFALSE;
+    BaseType_t xSoakPassed;
+    size_t xIndex;
+    int lStatus = -1;
+
+    ( void ) pvParameters;
+
+    xNetworkContext.pParams = &xTlsTransportParams;
+
+    /* First, while the credential store is empty. */
+    prvRunCredentials();
+    prvRunHandshakes( "full", usFullPort, eTLSTransportProfileStandard );
+    prvRunHandshakes( "full_constrained", usFullPort, eTLSTransportProfileConstrained );
+    prvRunHandshakes( "resumed", usResumePort, eTLSTransportProfileStandard );
+
+    /* All bulk runs share one connection. */
+    prvCredentials( &xCredentials, eTLSTransportProfileBuildDefault );
+    xConnected = prvTimedConnect( usFullPort, &xCredentials, &xResult );
+
+    for( xIndex = 0; ( xConnected == pdPASS ) && ( xIndex < sizeof( ulWriteSizes ) / sizeof( ulWriteSizes[ 0 ] ) ); xIndex++ )
+    {
+        xConnected = prvRunBulk( "upload", benchmarkCOMMAND_UPLOAD, ulWriteSizes[ xIndex ], pdFALSE );
+
+        if( xConnected == pdPASS )
+        {
+            xConnected = prvRunBulk( "download", benchmarkCOMMAND_DOWNLOAD, ulWriteSizes[ xIndex ], pdFALSE );
+        }
+
+        if( xConnected == pdPASS )
+        {
+            xConnected = prvRunBulk( "download_borrow", benchmarkCOMMAND_DOWNLOAD, ulWriteSizes[ xIndex ], pdTRUE );
+        }
+    }
+
+    if( xResult.ulConnects > 0U )
+    {
+        TLS_Socket_Disconnect( &xNetworkContext );
+    }
+
+    xSoakPassed = prvRunSoak();
+    prvReportHeap();
+
+    ( void ) fflush( stdout );
+
+    /* Closing the control pipe stops the server. */
+    ( void ) close( lServerControl );
+    ( void ) waitpid( xServerPid, &lStatus, 0 );
+
+    exit( ( ( xConnected == pdPASS ) && ( xSoakPassed == pdPASS ) &&
+            WIFEXITED( lStatus ) && ( WEXITSTATUS( lStatus ) == 0 ) ) ?
+          EXIT_SUCCESS : EXIT_FAILURE );
+}
+/*-----------------------------------------------------------*/
+
+static int prvListen( uint16_t * pusPort )
+{
+    struct sockaddr_in xAddr = { 0 };
+    socklen_t xAddrLength = sizeof( xAddr );
+    int lFd = socket( AF_INET, SOCK_STREAM, 0 );
+
+    xAddr.sin_family = AF_INET;
+    xAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    xAddr.sin_port = 0;
+
+    if( ( lFd >= 0 ) &&
+        ( ( bind( lFd, ( struct sockaddr * ) &xAddr, sizeof( xAddr ) ) != 0 ) ||
+          ( listen( lFd, 8 ) != 0 ) ||
+          ( getsockname( lFd, ( struct sockaddr * ) &xAddr, &xAddrLength ) != 0 ) ) )
+    {
+        ( void ) close( lFd );
+        lFd = -1;
+    }
+
+    if( lFd >= 0 )
+    {
+        *pusPort = ntohs( xAddr.sin_port );
+    }
+
+    return lFd;
+}
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    int lListenFull;
+    int lListenResume;
+    int lControl[ 2 ];
+
+    lListenFull = prvListen( &usFullPort );
+    lListenResume = prvListen( &usResumePort );
+
+    if( ( lListenFull < 0 ) || ( lListenResume < 0 ) || ( pipe( lControl ) != 0 ) )
+    {
+        fprintf( stderr, "Failed to open the loopback sockets: %s\n", strerror( errno ) );
+        return EXIT_FAILURE;
+    }
+
+    /* Fork before the scheduler starts, so the server never shares it with
+     * the client. */
+    xServerPid = fork();
+
+    if( xServerPid == 0 )
+    {
+        ( void ) close( lControl[ 1 ] );
+        _exit( lBenchmarkServerRun( lListenFull, lListenResume, lControl[ 0 ] ) );
+    }
+    else if( xServerPid < 0 )
+    {
+        fprintf( stderr, "Failed to start the server: %s\n", strerror( errno ) );
+        return EXIT_FAILURE;
+    }
+
+    ( void ) close( lListenFull );
+    ( void ) close( lListenResume );
+    ( void ) close( lControl[ 0 ] );
+    lServerControl = lControl[ 1 ];
+
+    ( void ) xTaskCreate( prvBenchmarkTask,
+                          "Benchmark",
+                          benchmarkTASK_STACK_SIZE,
+                          NULL,
+                          benchmarkTASK_PRIORITY,
+                          NULL );
+
+    vTaskStartScheduler();
+
+    /* Only reached if there was not enough heap to start the scheduler. */
+    return EXIT_FAILURE;
+}
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * pcFormat,
+                     ... )
+{
+    va_list arg;
+
+    /* stdout carries the results. */
+    va_start( arg, pcFormat );
+    vfprintf( stderr, pcFormat, arg );
+    va_end( arg );
+}
+/*-----------------------------------------------------------*/
+
+void vAssertCalled( const char * pcFile,
+                    uint32_t ulLine )
+{
+    fprintf( stderr, "vAssertCalled( %s, %u\n", pcFile, ( unsigned int ) ulLine );
+    abort();
+}
+/*-----------------------------------------------------------*/
+
+/* configUSE_STATIC_ALLOCATION is set to 1, so the application must provide an
+ * implementation of vApplicationGetIdleTaskMemory() to provide the memory that is
+ * used by the Idle task. */
+void vApplicationGetIdleTaskMemory( StaticTask_t ** ppxIdleTaskTCBBuffer,
+                                    StackType_t ** ppxIdleTaskStackBuffer,
+                                    uint32_t * pulIdleTaskStackSize )
+{
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+/* configUSE_STATIC_ALLOCATION and configUSE_TIMERS are both set to 1, so the
+ * application must provide an implementation of vApplicationGetTimerTaskMemory()
+ * to provide the memory that is used by the Timer service task. */
+void vApplicationGetTimerTaskMemory( StaticTask_t ** ppxTimerTaskTCBBuffer,
+                                     StackType_t ** ppxTimerTaskStackBuffer,
+                                     uint32_t * pulTimerTaskStackSize )
+{
+    static StaticTask_t xTimerTaskTCB;
+    static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Entropy source of mbed TLS, for both the client and the server.
+ */
+int mbedtls_platform_entropy_poll( void * data,
+                                   unsigned char * output,
+                                   size_t len,
+                                   size_t * olen )
+{
+    FILE * file;
+    int ret = -1;
+
+    ( ( void ) data );
+
+    *olen = 0;
+
+    file = fopen( "/dev/urandom", "rb" );
+
+    if( file != NULL )
+    {
+        if( fread( output, 1, len, file ) == len )
+        {
+            *olen = len;
+            ret = 0;
+        }
+
+        fclose( file );
+    }
+
+    return ret;
+}
+/*-----------------------------------------------------------*/
+
+/* Not used for anything secure. */
+int iMainRand32( void )
+{
+    static UBaseType_t uxlNextRand;
+    const uint32_t ulMultiplier = 0x015a4e35UL, ulIncrement = 1UL;
+
+    uxlNextRand = ( ulMultiplier * uxlNextRand ) + ulIncrement;
+
+    return( ( int ) ( uxlNextRand >> 16UL ) & 0x7fffUL );
+}
+/*-----------------------------------------------------------*/
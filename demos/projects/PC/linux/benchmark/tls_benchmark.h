@@ -0,0 +1,58 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file tls_benchmark.h
+ * @brief Protocol shared by the TLS benchmark client and its loopback server.
+ */
+
+#ifndef TLS_BENCHMARK_H
+#define TLS_BENCHMARK_H
+
+#include <stdint.h>
+
+/**
+ * @brief Host name the benchmark connects to. Matches the common name of
+ * the mbed TLS test server certificate.
+ */
+#define benchmarkHOST_NAME             "localhost"
+
+/**
+ * @brief Length of a request header: one command byte, then the total
+ * length and the write size, both 32 bit big endian.
+ */
+#define benchmarkREQUEST_LENGTH        ( 9 )
+
+/**
+ * @brief Client sends the total length in writes of the given size. The
+ * server answers with one byte once it has read it all.
+ */
+#define benchmarkCOMMAND_UPLOAD        ( ( uint8_t ) 'U' )
+
+/**
+ * @brief Server sends the total length in writes of the given size.
+ */
+#define benchmarkCOMMAND_DOWNLOAD      ( ( uint8_t ) 'D' )
+
+/**
+ * @brief Largest write size a request may ask for.
+ */
+#define benchmarkMAX_WRITE_SIZE        ( 16384 )
+
+/**
+ * @brief Serve TLS connections until the client closes the control pipe.
+ *
+ * Runs in a child process forked before the scheduler starts, so it does not
+ * compete with the client for the FreeRTOS scheduler.
+ *
+ * @param[in] lListenFull Listening socket offering full handshakes only.
+ * @param[in] lListenResume Listening socket that also issues session tickets.
+ * @param[in] lControl Read end of a pipe, closed by the client on exit.
+ *
+ * @return 0 on a clean exit, 1 on a setup failure.
+ */
+int lBenchmarkServerRun( int lListenFull,
+                         int lListenResume,
+                         int lControl );
+
+#endif /* TLS_BENCHMARK_H */
@@ -0,0 +1,443 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file tls_benchmark_server.c
+ * @brief Loopback mbed TLS server the TLS benchmark connects to.
+ *
+ * Presents the mbed TLS test EC server certificate, issued for localhost.
+ * Connections are served one at a time, as the benchmark makes them.
+ */
+
+/* Standard includes. */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/* POSIX includes. */
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* mbed TLS includes. */
+#include "mbedtls/certs.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_ticket.h"
+#include "mbedtls/threading.h"
+#include "mbedtls/x509_crt.h"
+
+#include "tls_benchmark.h"
+
+/**
+ * @brief Lifetime of the session tickets the server issues, in seconds.
+ */
+#define benchmarkTICKET_LIFETIME_S    ( 86400 )
+
+/**
+ * @brief Server side mbed TLS state shared by all connections.
+ */
+typedef struct BenchmarkServer
+{
+    mbedtls_entropy_context xEntropy;
+    mbedtls_ctr_drbg_context xCtrDrbg;
+    mbedtls_x509_crt xCertificate;
+    mbedtls_pk_context xPrivateKey;
+    mbedtls_ssl_ticket_context xTicket;
+    mbedtls_ssl_config xFullConfig;   /**< No session cache or tickets: every handshake is a full one. */
+    mbedtls_ssl_config xResumeConfig; /**< Issues and accepts session tickets. */
+} BenchmarkServer_t;
+
+static BenchmarkServer_t xServer;
+
+/* Keeps the largest write off the stack. */
+static uint8_t ucServerBuffer[ benchmarkMAX_WRITE_SIZE ];
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief mbed TLS send callback over a blocking host socket.
+ */
+static int prvServerSend( void * pvContext,
+                          const unsigned char * pucBuffer,
+                          size_t xLength );
+
+/**
+ * @brief mbed TLS receive callback over a blocking host socket.
+ */
+static int prvServerRecv( void * pvContext,
+                          unsigned char * pucBuffer,
+                          size_t xLength );
+
+/**
+ * @brief Set up the certificate, key, random generator and both configs.
+ *
+ * @return 0 on success; otherwise, an mbed TLS error code.
+ */
+static int prvServerSetup( void );
+
+/**
+ * @brief Read exactly @p xLength bytes from a TLS connection.
+ *
+ * @return 0 on success; otherwise, an mbed TLS error code.
+ */
+static int prvReadAll( mbedtls_ssl_context * pxSsl,
+                       uint8_t * pucBuffer,
+                       size_t xLength );
+
+/**
+ * @brief Write exactly @p xLength bytes to a TLS connection.
+ *
+ * @return 0 on success; otherwise, an mbed TLS error code.
+ */
+static int prvWriteAll( mbedtls_ssl_context * pxSsl,
+                        const uint8_t * pucBuffer,
+                        size_t xLength );
+
+/**
+ * @brief Run the handshake and then answer requests until the client
+ * closes the connection.
+ */
+static void prvServeConnection( int lFd,
+                                const mbedtls_ssl_config * pxConfig );
+/*-----------------------------------------------------------*/
+
+static int prvServerSend( void * pvContext,
+                          const unsigned char * pucBuffer,
+                          size_t xLength )
+{
+    int lFd = *( ( int * ) pvContext );
+    ssize_t lSent;
+
+    do
+    {
+        lSent = send( lFd, pucBuffer, xLength, MSG_NOSIGNAL );
+    } while( ( lSent < 0 ) && ( errno == EINTR ) );
+
+    return ( lSent < 0 ) ? MBEDTLS_ERR_NET_SEND_FAILED : ( int ) lSent;
+}
+/*-----------------------------------------------------------*/
+
+static int prvServerRecv( void * pvContext,
+                          unsigned char * pucBuffer,
+                          size_t xLength )
+{
+    int lFd = *( ( int * ) pvContext );
+    ssize_t lReceived;
+
+    do
+    {
+        lReceived = recv( lFd, pucBuffer, xLength, 0 );
+    } while( ( lReceived < 0 ) && ( errno == EINTR ) );
+
+    /* 0 is end of stream to mbed TLS, as to recv. */
+    return ( lReceived < 0 ) ? MBEDTLS_ERR_NET_RECV_FAILED : ( int ) lReceived;
+}
+/*-----------------------------------------------------------*/
+
+static int prvServerSetup( void )
+{
+    int lRet;
+
+    /* The FreeRTOS mutexes work before the scheduler starts, and this
+     * process never starts it. */
+    mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
+                               mbedtls_platform_mutex_free,
+                               mbedtls_platform_mutex_lock,
+                               mbedtls_platform_mutex_unlock );
+
+    mbedtls_entropy_init( &( xServer.xEntropy ) );
+    mbedtls_ctr_drbg_init( &( xServer.xCtrDrbg ) );
+    mbedtls_x509_crt_init( &( xServer.xCertificate ) );
+    mbedtls_pk_init( &( xServer.xPrivateKey ) );
+    mbedtls_ssl_ticket_init( &( xServer.xTicket ) );
+    mbedtls_ssl_config_init( &( xServer.xFullConfig ) );
+    mbedtls_ssl_config_init( &( xServer.xResumeConfig ) );
+
+    if( ( lRet = mbedtls_entropy_add_source( &( xServer.xEntropy ),
+                                             mbedtls_platform_entropy_poll,
+                                             NULL,
+                                             32,
+                                             MBEDTLS_ENTROPY_SOURCE_STRONG ) ) != 0 )
+    {
+        configPRINTF( ( "Server: failed to add entropy source %d.\r\n", lRet ) );
+    }
+    else if( ( lRet = mbedtls_ctr_drbg_seed( &( xServer.xCtrDrbg ),
+                                             mbedtls_entropy_func,
+                                             &( xServer.xEntropy ),
+                                             NULL,
+                                             0 ) ) != 0 )
+    {
+        configPRINTF( ( "Server: failed to seed the random generator %d.\r\n", lRet ) );
+    }
+    else if( ( lRet = mbedtls_x509_crt_parse( &( xServer.xCertificate ),
+                                              ( const unsigned char * ) mbedtls_test_srv_crt_ec,
+                                              mbedtls_test_srv_crt_ec_len ) ) != 0 )
+    {
+        configPRINTF( ( "Server: failed to parse the certificate %d.\r\n", lRet ) );
+    }
+    else if( ( lRet = mbedtls_pk_parse_key( &( xServer.xPrivateKey ),
+                                            ( const unsigned char * ) mbedtls_test_srv_key_ec,
+                                            mbedtls_test_srv_key_ec_len,
+                                            NULL,
+                                            0 ) ) != 0 )
+    {
+        configPRINTF( ( "Server: failed to parse the private key %d.\r\n", lRet ) );
+    }
+    else if( ( lRet = mbedtls_ssl_ticket_setup( &( xServer.xTicket ),
+                                                mbedtls_ctr_drbg_random,
+                                                &( xServer.xCtrDrbg ),
+                                                MBEDTLS_CIPHER_AES_256_GCM,
+                                                benchmarkTICKET_LIFETIME_S ) ) != 0 )
+    {
+        configPRINTF( ( "Server: failed to set up session tickets %d.\r\n", lRet ) );
+    }
+    else
+    {
+        mbedtls_ssl_config * pxConfigs[] = { &( xServer.xFullConfig ), &( xServer.xResumeConfig ) };
+        size_t xIndex;
+
+        for( xIndex = 0; ( lRet == 0 ) && ( xIndex < sizeof( pxConfigs ) / sizeof( pxConfigs[ 0 ] ) ); xIndex++ )
+        {
+            if( ( lRet = mbedtls_ssl_config_defaults( pxConfigs[ xIndex ],
+                                                      MBEDTLS_SSL_IS_SERVER,
+                                                      MBEDTLS_SSL_TRANSPORT_STREAM,
+                                                      MBEDTLS_SSL_PRESET_DEFAULT ) ) != 0 )
+            {
+                configPRINTF( ( "Server: failed to set config defaults %d.\r\n", lRet ) );
+            }
+            else if( ( lRet = mbedtls_ssl_conf_own_cert( pxConfigs[ xIndex ],
+                                                         &( xServer.xCertificate ),
+                                                         &( xServer.xPrivateKey ) ) ) != 0 )
+            {
+                configPRINTF( ( "Server: failed to set the certificate %d.\r\n", lRet ) );
+            }
+            else
+            {
+                mbedtls_ssl_conf_rng( pxConfigs[ xIndex ], mbedtls_ctr_drbg_random, &( xServer.xCtrDrbg ) );
+                mbedtls_ssl_conf_authmode( pxConfigs[ xIndex ], MBEDTLS_SSL_VERIFY_NONE );
+            }
+        }
+
+        if( lRet == 0 )
+        {
+            mbedtls_ssl_conf_session_tickets_cb( &( xServer.xResumeConfig ),
+                                                 mbedtls_ssl_ticket_write,
+                                                 mbedtls_ssl_ticket_parse,
+                                                 &( xServer.xTicket ) );
+        }
+    }
+
+    return lRet;
+}
+/*-----------------------------------------------------------*/
+
+static int prvReadAll( mbedtls_ssl_context * pxSsl,
+                       uint8_t * pucBuffer,
+                       size_t xLength )
+{
+    size_t xOffset = 0;
+    int lRet = 0;
+
+    while( ( lRet >= 0 ) && ( xOffset < xLength ) )
+    {
+        lRet = mbedtls_ssl_read( pxSsl, pucBuffer + xOffset, xLength - xOffset );
+
+        if( lRet > 0 )
+        {
+            xOffset += ( size_t ) lRet;
+        }
+        else if( lRet == 0 )
+        {
+            lRet = MBEDTLS_ERR_SSL_CONN_EOF;
+        }
+        else if( ( lRet == MBEDTLS_ERR_SSL_WANT_READ ) || ( lRet == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+        {
+            lRet = 0;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    return ( lRet < 0 ) ? lRet : 0;
+}
+/*-----------------------------------------------------------*/
+
+static int prvWriteAll( mbedtls_ssl_context * pxSsl,
+                        const uint8_t * pucBuffer,
+                        size_t xLength )
+{
+    size_t xOffset = 0;
+    int lRet = 0;
+
+    while( ( lRet >= 0 ) && ( xOffset < xLength ) )
+    {
+        lRet = mbedtls_ssl_write( pxSsl, pucBuffer + xOffset, xLength - xOffset );
+
+        if( lRet > 0 )
+        {
+            xOffset += ( size_t ) lRet;
+        }
+        else if( ( lRet == MBEDTLS_ERR_SSL_WANT_READ ) || ( lRet == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+        {
+            lRet = 0;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    return ( lRet < 0 ) ? lRet : 0;
+}
+/*-----------------------------------------------------------*/
+
+static void prvServeConnection( int lFd,
+                                const mbedtls_ssl_config * pxConfig )
+{
+    mbedtls_ssl_context xSsl;
+    uint8_t ucRequest[ benchmarkREQUEST_LENGTH ];
+    uint32_t ulTotal;
+    uint32_t ulWriteSize;
+    uint32_t ulChunk;
+    int lRet;
+
+    mbedtls_ssl_init( &xSsl );
+
+    if( ( lRet = mbedtls_ssl_setup( &xSsl, pxConfig ) ) == 0 )
+    {
+        mbedtls_ssl_set_bio( &xSsl, &lFd, prvServerSend, prvServerRecv, NULL );
+
+        do
+        {
+            lRet = mbedtls_ssl_handshake( &xSsl );
+        } while( ( lRet == MBEDTLS_ERR_SSL_WANT_READ ) || ( lRet == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+    }
+
+    if( lRet != 0 )
+    {
+        configPRINTF( ( "Server: handshake failed -0x%04x.\r\n", ( unsigned int ) -lRet ) );
+    }
+
+    /* Handshake-only connections end here, when the client closes. */
+    while( ( lRet == 0 ) &&
+           ( ( lRet = prvReadAll( &xSsl, ucRequest, sizeof( ucRequest ) ) ) == 0 ) )
+    {
+        ulTotal = ( ( uint32_t ) ucRequest[ 1 ] << 24 ) | ( ( uint32_t ) ucRequest[ 2 ] << 16 ) |
+                  ( ( uint32_t ) ucRequest[ 3 ] << 8 ) | ( uint32_t ) ucRequest[ 4 ];
+        ulWriteSize = ( ( uint32_t ) ucRequest[ 5 ] << 24 ) | ( ( uint32_t ) ucRequest[ 6 ] << 16 ) |
+                      ( ( uint32_t ) ucRequest[ 7 ] << 8 ) | ( uint32_t ) ucRequest[ 8 ];
+
+        if( ( ulWriteSize == 0 ) || ( ulWriteSize > benchmarkMAX_WRITE_SIZE ) )
+        {
+            configPRINTF( ( "Server: bad write size %u.\r\n", ( unsigned int ) ulWriteSize ) );
+            lRet = MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+        }
+        else if( ucRequest[ 0 ] == benchmarkCOMMAND_UPLOAD )
+        {
+            while( ( lRet == 0 ) && ( ulTotal > 0 ) )
+            {
+                ulChunk = ( ulTotal < benchmarkMAX_WRITE_SIZE ) ? ulTotal : benchmarkMAX_WRITE_SIZE;
+                lRet = prvReadAll( &xSsl, ucServerBuffer, ulChunk );
+                ulTotal -= ulChunk;
+            }
+
+            if( lRet == 0 )
+            {
+                lRet = prvWriteAll( &xSsl, ucRequest, 1 );
+            }
+        }
+        else if( ucRequest[ 0 ] == benchmarkCOMMAND_DOWNLOAD )
+        {
+            while( ( lRet == 0 ) && ( ulTotal > 0 ) )
+            {
+                ulChunk = ( ulTotal < ulWriteSize ) ? ulTotal : ulWriteSize;
+                lRet = prvWriteAll( &xSsl, ucServerBuffer, ulChunk );
+                ulTotal -= ulChunk;
+            }
+        }
+        else
+        {
+            configPRINTF( ( "Server: unknown command 0x%02x.\r\n", ucRequest[ 0 ] ) );
+            lRet = MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+        }
+    }
+
+    if( lRet == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY )
+    {
+        ( void ) mbedtls_ssl_close_notify( &xSsl );
+    }
+
+    mbedtls_ssl_free( &xSsl );
+    ( void ) close( lFd );
+}
+/*-----------------------------------------------------------*/
+
+int lBenchmarkServerRun( int lListenFull,
+                         int lListenResume,
+                         int lControl )
+{
+    struct pollfd xPollFds[ 3 ];
+    int lFd;
+    int lNoDelay = 1;
+    int lRet = 0;
+    size_t xIndex;
+
+    if( prvServerSetup() != 0 )
+    {
+        lRet = 1;
+    }
+
+    xPollFds[ 0 ].fd = lListenFull;
+    xPollFds[ 1 ].fd = lListenResume;
+    xPollFds[ 2 ].fd = lControl;
+
+    for( xIndex = 0; xIndex < 3; xIndex++ )
+    {
+        xPollFds[ xIndex ].events = POLLIN;
+    }
+
+    /* The control pipe becomes readable, at end of file, once the client
+     * exits for any reason. */
+    while( lRet == 0 )
+    {
+        if( poll( xPollFds, 3, -1 ) < 0 )
+        {
+            if( errno != EINTR )
+            {
+                lRet = 1;
+            }
+        }
+        else if( xPollFds[ 2 ].revents != 0 )
+        {
+            break;
+        }
+        else
+        {
+            for( xIndex = 0; xIndex < 2; xIndex++ )
+            {
+                if( ( ( xPollFds[ xIndex ].revents & POLLIN ) != 0 ) &&
+                    ( ( lFd = accept( xPollFds[ xIndex ].fd, NULL, NULL ) ) >= 0 ) )
+                {
+                    /* Each handshake flight is several writes; do not let
+                     * Nagle hold them back waiting for a delayed ACK. */
+                    ( void ) setsockopt( lFd, IPPROTO_TCP, TCP_NODELAY, &lNoDelay, sizeof( lNoDelay ) );
+                    prvServeConnection( lFd, ( xIndex == 0 ) ? &( xServer.xFullConfig ) :
+                                        &( xServer.xResumeConfig ) );
+                }
+            }
+        }
+    }
+
+    return lRet;
+}
+/*-----------------------------------------------------------*/
@@ -165,6 +165,12 @@
 /* The UDP port to which print messages are sent. */
 #define configPRINT_PORT                    ( 15000 )
 
+/* Keep TLS sessions in files next to the executable, so a restarted demo
+ * resumes the previous session instead of a full handshake. */
+#ifndef TLS_TRANSPORT_SESSION_CACHE_PERSIST
+    #define TLS_TRANSPORT_SESSION_CACHE_PERSIST    ( 1 )
+#endif
+
 
 #if ( defined( _MSC_VER ) && ( _MSC_VER <= 1600 ) && !defined( snprintf ) )
     /* Map to Windows names. */
@@ -8,6 +8,8 @@
 #include <time.h>
 #include <strings.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <assert.h>
 
 /* FreeRTOS includes. */
@@ -24,9 +26,16 @@
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+/* TLS transport include, for the session persistence hooks. */
+#include "transport_tls_socket.h"
+
 #define mainHOST_NAME           "RTOSDemo"
 #define mainDEVICE_NICK_NAME    "linux_demo"
 
+/* File, in the working directory, that holds the persisted TLS session for
+ * a host and port. Created readable by the owner only. */
+#define mainTLS_SESSION_FILE_FORMAT    "tls_session_%s_%u.bin"
+
 /*
  * Prototypes for the demos that can be started from this project.  Note the
  * MQTT demo is not actually started until the network is already, which is
@@ -428,6 +437,80 @@ int mbedtls_platform_entropy_poll( void * data,
 }
 /*-----------------------------------------------------------*/
 
+#if ( TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 )
+
+BaseType_t xApplicationTlsSessionSave( const char * pcHostName,
+                                       uint16_t usPort,
+                                       const uint8_t * pucData,
+                                       size_t xDataLength )
+{
+    char cFileName[ SOCKETS_MAX_HOST_NAME_LENGTH + sizeof( mainTLS_SESSION_FILE_FORMAT ) + 5 ];
+    FILE * file = NULL;
+    BaseType_t xResult = pdFAIL;
+    int lFd;
+
+    ( void ) snprintf( cFileName, sizeof( cFileName ), mainTLS_SESSION_FILE_FORMAT, pcHostName, usPort );
+
+    /* The session holds its master secret, so only the owner may read it.
+     * fchmod also covers a file left by an earlier run. */
+    lFd = open( cFileName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+
+    if( lFd >= 0 )
+    {
+        if( ( fchmod( lFd, S_IRUSR | S_IWUSR ) != 0 ) ||
+            ( ( file = fdopen( lFd, "wb" ) ) == NULL ) )
+        {
+            close( lFd );
+        }
+    }
+
+    if( file != NULL )
+    {
+        if( fwrite( pucData, 1, xDataLength, file ) == xDataLength )
+        {
+            xResult = pdPASS;
+        }
+
+        fclose( file );
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xApplicationTlsSessionLoad( const char * pcHostName,
+                                       uint16_t usPort,
+                                       uint8_t * pucBuffer,
+                                       size_t xBufferLength,
+                                       size_t * pxDataLength )
+{
+    char cFileName[ SOCKETS_MAX_HOST_NAME_LENGTH + sizeof( mainTLS_SESSION_FILE_FORMAT ) + 5 ];
+    FILE * file;
+    BaseType_t xResult = pdFAIL;
+
+    ( void ) snprintf( cFileName, sizeof( cFileName ), mainTLS_SESSION_FILE_FORMAT, pcHostName, usPort );
+
+    file = fopen( cFileName, "rb" );
+
+    if( file != NULL )
+    {
+        *pxDataLength = fread( pucBuffer, 1, xBufferLength, file );
+
+        /* A full buffer means the file may have been truncated. */
+        if( ( *pxDataLength > 0 ) && ( *pxDataLength < xBufferLength ) )
+        {
+            xResult = pdPASS;
+        }
+
+        fclose( file );
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* TLS_TRANSPORT_SESSION_CACHE_PERSIST == 1 */
+
 /* Psuedo random number generator.  Just used by demos so does not need to be
  * secure.  Do not use the standard C library rand() function as it can cause
  * unexpected behaviour, such as calls to malloc(). */
@@ -7,6 +7,7 @@
  */
 
 #include "sockets_wrapper.h"
+#include "sockets_dns_cache.h"
 
 /* Standard includes. */
 #include <string.h>
@@ -14,6 +15,7 @@
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "task.h"
 
 /* Wifi module */
 #include "es_wifi.h"
@@ -97,6 +99,8 @@ typedef struct STSecureSocket
     uint32_t ulFlags;                   /**< Various properties of the socket (secured etc.). */
     uint32_t ulSendTimeout;             /**< Send timeout. */
     uint32_t ulReceiveTimeout;          /**< Receive timeout. */
+    uint8_t ucPeeked;                   /**< 1 if Sockets_Poll read ucPeekByte ahead of Sockets_Recv. */
+    uint8_t ucPeekByte;                 /**< Byte read by Sockets_Poll. */
 } STSecureSocket_t;
 
 static STSecureSocket_t xSockets[ wificonfigMAX_SOCKETS ];
@@ -239,6 +243,7 @@ BaseType_t Sockets_Init()
     {
         xSockets[ ulIndex ].ucInUse = 0;
         xSockets[ ulIndex ].ulFlags = 0;
+        xSockets[ ulIndex ].ucPeeked = 0;
 
         xSockets[ ulIndex ].ulFlags |= stsecuresocketsSOCKET_READ_CLOSED_FLAG;
         xSockets[ ulIndex ].ulFlags |= stsecuresocketsSOCKET_WRITE_CLOSED_FLAG;
@@ -265,6 +270,7 @@ SocketHandle Sockets_Open()
         pxSecureSocket->ulFlags = stsecuresocketsSOCKET_SECURE_FLAG;
         pxSecureSocket->ulSendTimeout = socketsconfigDEFAULT_SEND_TIMEOUT;
         pxSecureSocket->ulReceiveTimeout = socketsconfigDEFAULT_RECV_TIMEOUT;
+        pxSecureSocket->ucPeeked = 0;
     }
 
     return ( SocketHandle ) ulSocketNumber;
@@ -287,11 +293,32 @@ BaseType_t Sockets_Close( SocketHandle xSocket )
 BaseType_t Sockets_Connect( SocketHandle xSocket,
                             const char * pcHostName,
                             uint16_t usPort )
+{
+    return Sockets_ConnectTimed( xSocket, pcHostName, usPort, NULL );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectTimed( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes )
+{
+    /* The Inventek module connects in one blocking command. */
+    return Sockets_ConnectStart( xSocket, pcHostName, usPort, pxTimes );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectStart( SocketHandle xSocket,
+                                 const char * pcHostName,
+                                 uint16_t usPort,
+                                 SocketsConnectTimes_t * pxTimes )
 {
     uint32_t ulSocketNumber = ( uint32_t ) xSocket;
     STSecureSocket_t * pxSecureSocket;
     int32_t lRetVal = SOCKETS_ERROR_NONE;
     uint32_t ulIPAddres = 0;
+    SocketsConnectTimes_t xTimes = { 0 };
+    TickType_t xStart = xTaskGetTickCount();
 
     if ( prvIsValidSocket( ulSocketNumber ) ==  pdFALSE )
     {
@@ -301,7 +328,11 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
     {
         pxSecureSocket = &( xSockets[ ulSocketNumber ] );
 
-        if( ( ulIPAddres = prvGetHostByName( pcHostName ) ) == 0 )
+        ulIPAddres = SocketsDnsCache_Resolve( pcHostName, prvGetHostByName );
+        xTimes.xResolveTicks = xTaskGetTickCount() - xStart;
+        xStart = xTaskGetTickCount();
+
+        if( ulIPAddres == 0 )
         {
             lRetVal = SOCKETS_SOCKET_ERROR;
         }
@@ -323,19 +354,47 @@ BaseType_t Sockets_Connect( SocketHandle xSocket,
             }
             else
             {
-                /* Connection failed. */
+                /* Connection failed. The host may have moved, resolve it
+                 * again next time. */
+                SocketsDnsCache_Invalidate( pcHostName );
                 lRetVal = SOCKETS_SOCKET_ERROR;
             }
 
             /* Return the semaphore. */
             ( void ) xSemaphoreGive( xWifiSemaphoreHandle );
+
+            xTimes.xConnectTicks = xTaskGetTickCount() - xStart;
         }
     }
-    
+
+    if( pxTimes != NULL )
+    {
+        *pxTimes = xTimes;
+    }
+
     return lRetVal;
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_ConnectPoll( SocketHandle xSocket,
+                                TickType_t xTimeoutTicks )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket;
+    BaseType_t xRetVal = SOCKETS_SOCKET_ERROR;
+
+    ( void ) xTimeoutTicks;
+
+    /* Sockets_ConnectStart has already waited for the server. */
+    if( ( prvIsValidSocket( ulSocketNumber ) == pdTRUE ) &&
+        ( ( xSockets[ ulSocketNumber ].ulFlags & stsecuresocketsSOCKET_IS_CONNECTED_FLAG ) != 0UL ) )
+    {
+        xRetVal = SOCKETS_ERROR_NONE;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 void Sockets_Disconnect( SocketHandle xSocket )
 {
     uint32_t ulSocketNumber = ( uint32_t ) xSocket;
@@ -374,9 +433,10 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
     uint32_t ulSocketNumber = ( uint32_t ) xSocket;
     STSecureSocket_t * pxSecureSocket;
     uint16_t usReceivedBytes = 0;
-    BaseType_t xRetVal;
+    BaseType_t xRetVal = 0;
+    BaseType_t xPeekedBytes = 0;
     WIFI_Status_t xWiFiResult = WIFI_STATUS_OK;
-    TickType_t xTimeOnEntering = xTaskGetTickCount(), xSemaphoreWait;
+    TickType_t xTimeOnEntering = xTaskGetTickCount(), xSemaphoreWait, xReceiveTimeout;
 
     /* Shortcut for easy access. */
     pxSecureSocket = &( xSockets[ ulSocketNumber ] );
@@ -388,9 +448,23 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
         xReceiveBufferLength = ( uint32_t ) ES_WIFI_PAYLOAD_SIZE;
     }
 
-    xSemaphoreWait = pxSecureSocket->ulReceiveTimeout + stsecuresocketsFIVE_MILLISECONDS;
+    xReceiveTimeout = pxSecureSocket->ulReceiveTimeout;
+
+    if( pxSecureSocket->ucPeeked != 0U )
+    {
+        /* Deliver the byte Sockets_Poll read first, with whatever else has
+         * arrived since, without waiting for more. */
+        pucReceiveBuffer[ 0 ] = pxSecureSocket->ucPeekByte;
+        pxSecureSocket->ucPeeked = 0;
+        pucReceiveBuffer++;
+        xReceiveBufferLength--;
+        xPeekedBytes = 1;
+        xReceiveTimeout = 0;
+    }
+
+    xSemaphoreWait = xReceiveTimeout + stsecuresocketsFIVE_MILLISECONDS;
 
-    for( ; ; )
+    while( xReceiveBufferLength > 0U )
     {
         /* Try to acquire the semaphore. */
         if( xSemaphoreTake( xWifiSemaphoreHandle, xSemaphoreWait ) == pdTRUE )
@@ -415,7 +489,7 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
             {
                 /* The WiFi poll timed out, but has the socket timeout expired
                  * too? */
-                if( ( xTaskGetTickCount() - xTimeOnEntering ) < pxSecureSocket->ulReceiveTimeout )
+                if( ( xTaskGetTickCount() - xTimeOnEntering ) < xReceiveTimeout )
                 {
                     /* The socket has not timed out, but the driver supplied
                      * with the board is polling, which would block other tasks, so
@@ -475,6 +549,79 @@ BaseType_t Sockets_Recv( SocketHandle xSocket,
         }
     }
 
+    if( xRetVal >= 0 )
+    {
+        xRetVal += xPeekedBytes;
+    }
+
+    return xRetVal;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Poll( SocketHandle xSocket,
+                         TickType_t xTimeoutTicks )
+{
+    uint32_t ulSocketNumber = ( uint32_t ) xSocket;
+    STSecureSocket_t * pxSecureSocket;
+    uint16_t usReceivedBytes = 0;
+    BaseType_t xRetVal = SOCKETS_SOCKET_ERROR;
+    WIFI_Status_t xWiFiResult;
+    TickType_t xTimeOnEntering = xTaskGetTickCount();
+
+    if( prvIsValidSocket( ulSocketNumber ) == pdTRUE )
+    {
+        /* Shortcut for easy access. */
+        pxSecureSocket = &( xSockets[ ulSocketNumber ] );
+
+        /* The Inventek module cannot tell whether data is waiting without
+         * reading it, so one byte is read ahead and kept for Sockets_Recv.
+         * Like Sockets_Recv, poll in short steps to let other tasks use the
+         * module in between. */
+        while( pxSecureSocket->ucPeeked == 0U )
+        {
+            if( xSemaphoreTake( xWifiSemaphoreHandle, xSemaphoreWaitTicks ) != pdTRUE )
+            {
+                xRetVal = 0;
+                break;
+            }
+
+            xWiFiResult = WIFI_ReceiveData( ( uint8_t ) ulSocketNumber,
+                                            &( pxSecureSocket->ucPeekByte ),
+                                            1,
+                                            &( usReceivedBytes ),
+                                            stsecuresocketsONE_MILLISECOND );
+
+            /* Return the semaphore. */
+            ( void ) xSemaphoreGive( xWifiSemaphoreHandle );
+
+            if( ( xWiFiResult == WIFI_STATUS_OK ) && ( usReceivedBytes != 0 ) )
+            {
+                pxSecureSocket->ucPeeked = 1;
+            }
+            else if( ( xWiFiResult != WIFI_STATUS_TIMEOUT ) && ( xWiFiResult != WIFI_STATUS_OK ) )
+            {
+                /* Readable, in that Sockets_Recv returns the error at once
+                 * and resets the module if needed. */
+                xRetVal = 1;
+                break;
+            }
+            else if( ( xTaskGetTickCount() - xTimeOnEntering ) < xTimeoutTicks )
+            {
+                vTaskDelay( stsecuresocketsFIVE_MILLISECONDS );
+            }
+            else
+            {
+                xRetVal = 0;
+                break;
+            }
+        }
+
+        if( pxSecureSocket->ucPeeked != 0U )
+        {
+            xRetVal = 1;
+        }
+    }
+
     return xRetVal;
 }
 /*-----------------------------------------------------------*/
@@ -550,6 +697,36 @@ BaseType_t Sockets_Send( SocketHandle xSocket,
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_SendV( SocketHandle xSocket,
+                          const SocketsIoVec_t * pxIoVec,
+                          size_t xIoVecCount )
+{
+    BaseType_t xSent = 0;
+    BaseType_t xRetVal = 0;
+    size_t xIndex;
+
+    /* The Inventek module takes one buffer per send command. */
+    for( xIndex = 0; xIndex < xIoVecCount; xIndex++ )
+    {
+        xRetVal = Sockets_Send( xSocket,
+                                pxIoVec[ xIndex ].pucData,
+                                pxIoVec[ xIndex ].xDataLength );
+
+        if( xRetVal > 0 )
+        {
+            xSent += xRetVal;
+        }
+
+        if( xRetVal != ( BaseType_t ) pxIoVec[ xIndex ].xDataLength )
+        {
+            break;
+        }
+    }
+
+    return ( ( xSent > 0 ) || ( xRetVal >= 0 ) ) ? xSent : xRetVal;
+}
+/*-----------------------------------------------------------*/
+
 int32_t Sockets_SetSockOpt( SocketHandle xSocket,
                             int32_t lOptionName,
                             const void * pvOptionValue,
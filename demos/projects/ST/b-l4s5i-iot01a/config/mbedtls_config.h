@@ -43,6 +43,13 @@
 #define MBEDTLS_SSL_PROTO_TLS1_2
 #define MBEDTLS_SSL_ALPN
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION
+#define MBEDTLS_SSL_SESSION_TICKETS
+
+/* Smaller output record buffer. It must still hold the client certificate
+ * chain; the input buffer stays at 16 KB unless the server accepts a maximum
+ * fragment length. Both buffers shrink to fit once the handshake is done. */
+#define MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+#define MBEDTLS_SSL_OUT_CONTENT_LEN    4096
 
 /* Check certificate key usage. */
 #define MBEDTLS_X509_CHECK_KEY_USAGE
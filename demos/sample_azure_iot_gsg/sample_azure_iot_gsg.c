@@ -24,6 +24,12 @@
 /* Transport interface implementation include header for TLS. */
 #include "transport_tls_socket.h"
 
+/* Host name cache include. */
+#include "sockets_dns_cache.h"
+
+/* Event loop include. */
+#include "event_loop.h"
+
 /* Crypto helper header. */
 #include "crypto.h"
 
@@ -54,6 +60,12 @@
 #if !defined( democonfigDEVICE_SYMMETRIC_KEY ) && !defined( democonfigCLIENT_CERTIFICATE_PEM )
     #error "Please define one auth democonfigDEVICE_SYMMETRIC_KEY or democonfigCLIENT_CERTIFICATE_PEM in demo_config.h."
 #endif
+
+/* Set to 0 in demo_config.h when the transport does not resolve host names
+ * through the sockets wrappers, and so does not build sockets_dns_cache.c. */
+#ifndef democonfigSOCKETS_DNS_CACHE
+    #define democonfigSOCKETS_DNS_CACHE    1
+#endif
 /*-----------------------------------------------------------*/
 
 /**
@@ -102,6 +114,16 @@
  * @brief Wait timeout for subscribe to finish.
  */
 #define sampleazureiotgsgSUBSCRIBE_TIMEOUT                       ( 10 * 1000U )
+
+/**
+ * @brief Delay (in ticks) between two runs of the MQTT process loop while no
+ * message arrives, so that keep alive packets are sent in time.
+ *
+ * Must be well below the MQTT keep alive interval, and below
+ * SOCKETS_DNS_CACHE_PREFETCH_SECONDS so cached addresses are resolved again
+ * before they expire.
+ */
+#define sampleazureiotgsgKEEP_ALIVE_PERIOD_TICKS                 ( pdMS_TO_TICKS( 20 * 1000U ) )
 /*-----------------------------------------------------------*/
 
 #define sampleazureiotgsgTELEMETRY_INTERVAL_PROPERTY             ( "telemetryInterval" )
@@ -148,6 +170,10 @@ static int32_t lTelemetryInterval = 5;
 static bool xLedState = false;
 
 static AzureIoTHubClient_t xAzureIoTHubClient;
+
+/* Event loop of the demo task, and its telemetry timer */
+static EventLoop_t xEventLoop;
+static EventLoopTimer_t * pxTelemetryTimer = NULL;
 /*-----------------------------------------------------------*/
 
 /**
@@ -164,6 +190,17 @@ uint64_t ullGetUnixTime( void );
 static uint8_t ucMQTTMessageBuffer[ democonfigNETWORK_BUFFER_SIZE ];
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Telemetry interval in ticks, at least one second.
+ */
+static TickType_t prvTelemetryPeriodTicks( void )
+{
+    int32_t lSeconds = ( lTelemetryInterval > 0 ) ? lTelemetryInterval : 1;
+
+    return pdMS_TO_TICKS( ( uint32_t ) lSeconds * 1000U );
+}
+/*-----------------------------------------------------------*/
+
 static void prvReportLedState()
 {
     AzureIoTResult_t xResult;
@@ -446,6 +483,11 @@ static AzureIoTResult_t prvProcessProperties( AzureIoTHubClientPropertiesRespons
                 lTelemetryInterval = lNewTelemetryInterval;
                 prvReportTelemetryInterval( ulVersion );
 
+                if( pxTelemetryTimer != NULL )
+                {
+                    EventLoop_SetTimerPeriod( pxTelemetryTimer, prvTelemetryPeriodTicks() );
+                }
+
                 LogInfo( ( "TelemetryInterval Property received: %d.", lTelemetryInterval ) );
             }
             else
@@ -523,6 +565,62 @@ static void prvHandleProperties( AzureIoTHubClientPropertiesResponse_t * pxMessa
 }
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Event loop handler processing the messages from IoT Hub and the
+ * MQTT keep alive.
+ */
+static BaseType_t prvProcessLoop( void * pvContext )
+{
+    AzureIoTResult_t xResult;
+
+    ( void ) pvContext;
+
+    /* The event loop only calls in when there is data, or keep alive is
+     * due, so do not wait for more. */
+    xResult = AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient, 0 );
+    configASSERT( xResult == eAzureIoTSuccess );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Event loop handler for the keep alive timer, which also resolves
+ * the host names of the connection again before their cached addresses expire.
+ */
+static BaseType_t prvKeepAlive( void * pvContext )
+{
+    #if ( democonfigSOCKETS_DNS_CACHE == 1 )
+        /* Only addresses about to expire are resolved, at most once per
+         * TTL, so the next reconnect does not wait for the DNS server. */
+        SocketsDnsCache_Prefetch();
+    #endif
+
+    return prvProcessLoop( pvContext );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Event loop handler sending telemetry, every telemetry interval.
+ */
+static BaseType_t prvSendTelemetry( void * pvContext )
+{
+    uint32_t ulScratchBufferLength;
+    AzureIoTResult_t xResult;
+
+    ( void ) pvContext;
+
+    ulScratchBufferLength = ulCreateTelemetry( ucScratchBuffer, sizeof( ucScratchBuffer ) - 1 );
+
+    xResult = AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient,
+                                               ucScratchBuffer, ulScratchBufferLength,
+                                               NULL, eAzureIoTHubMessageQoS1, NULL );
+    configASSERT( xResult == eAzureIoTSuccess );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Setup transport credentials.
  */
@@ -735,7 +833,6 @@ static uint32_t prvConnectToServerWithBackoffRetries( const char * pcHostName,
  */
 static void prvAzureDemoTask( void * pvParameters )
 {
-    uint32_t ulScratchBufferLength = 0U;
     NetworkCredentials_t xNetworkCredentials = { 0 };
     AzureIoTTransportInterface_t xTransport;
     NetworkContext_t xNetworkContext = { 0 };
@@ -744,7 +841,8 @@ static void prvAzureDemoTask( void * pvParameters )
     uint32_t ulStatus;
     AzureIoTHubClientOptions_t xHubOptions = { 0 };
     bool xSessionPresent;
-    uint64_t lastTelemetryTime;
+    EventLoopTimer_t * pxKeepAliveTimer;
+    BaseType_t xLoopResult;
 
     #ifdef democonfigENABLE_DPS_SAMPLE
         uint8_t * pucIotHubHostname = NULL;
@@ -842,7 +940,14 @@ static void prvAzureDemoTask( void * pvParameters )
     xResult = AzureIoTHubClient_RequestPropertiesAsync( &xAzureIoTHubClient );
     configASSERT( xResult == eAzureIoTSuccess );
 
-    lastTelemetryTime = ullGetUnixTime();
+    /* Sleep until a message arrives or one of the timers is due. */
+    EventLoop_Init( &xEventLoop, &xNetworkContext, prvProcessLoop, NULL );
+    pxTelemetryTimer = EventLoop_AddTimer( &xEventLoop, prvTelemetryPeriodTicks(),
+                                           prvSendTelemetry, NULL );
+    configASSERT( pxTelemetryTimer != NULL );
+    pxKeepAliveTimer = EventLoop_AddTimer( &xEventLoop, sampleazureiotgsgKEEP_ALIVE_PERIOD_TICKS,
+                                           prvKeepAlive, NULL );
+    configASSERT( pxKeepAliveTimer != NULL );
 
     /* Report properties */
     prvReportLedState();
@@ -850,31 +955,8 @@ static void prvAzureDemoTask( void * pvParameters )
     prvReportDeviceInfo();
 
     /* Loop forever */
-    while( true )
-    {
-        uint64_t currentTime = ullGetUnixTime();
-
-        if( currentTime > ( lastTelemetryTime + lTelemetryInterval ) )
-        {
-            /* Advance the time */
-            while( currentTime > ( lastTelemetryTime + lTelemetryInterval ) )
-            {
-                lastTelemetryTime += lTelemetryInterval;
-            }
-
-            ulScratchBufferLength = ulCreateTelemetry( ucScratchBuffer, sizeof( ucScratchBuffer ) - 1 );
-
-            xResult = AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient,
-                                                       ucScratchBuffer, ulScratchBufferLength,
-                                                       NULL, eAzureIoTHubMessageQoS1, NULL );
-            configASSERT( xResult == eAzureIoTSuccess );
-        }
-
-        /* :TODO: the processloop runs for 10 seconds */
-        xResult = AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient, 0 );
-
-        configASSERT( xResult == eAzureIoTSuccess );
-    }
+    xLoopResult = EventLoop_Run( &xEventLoop );
+    configASSERT( xLoopResult == pdPASS );
 }
 /*-----------------------------------------------------------*/
 
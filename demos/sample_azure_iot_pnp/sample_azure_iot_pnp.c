@@ -24,6 +24,12 @@
 /* Transport interface implementation include header for TLS. */
 #include "transport_tls_socket.h"
 
+/* Host name cache include. */
+#include "sockets_dns_cache.h"
+
+/* Event loop include. */
+#include "event_loop.h"
+
 /* Crypto helper header. */
 #include "crypto.h"
 
@@ -54,6 +60,12 @@
 #if !defined( democonfigDEVICE_SYMMETRIC_KEY ) && !defined( democonfigCLIENT_CERTIFICATE_PEM )
     #error "Please define one auth democonfigDEVICE_SYMMETRIC_KEY or democonfigCLIENT_CERTIFICATE_PEM in demo_config.h."
 #endif
+
+/* Set to 0 in demo_config.h when the transport does not resolve host names
+ * through the sockets wrappers, and so does not build sockets_dns_cache.c. */
+#ifndef democonfigSOCKETS_DNS_CACHE
+    #define democonfigSOCKETS_DNS_CACHE    1
+#endif
 /*-----------------------------------------------------------*/
 
 /**
@@ -89,20 +101,24 @@
  */
 #define sampleazureiotDELAY_BETWEEN_DEMO_ITERATIONS_TICKS     ( pdMS_TO_TICKS( 5000U ) )
 
-/**
- * @brief Timeout for MQTT_ProcessLoop in milliseconds.
- */
-#define sampleazureiotPROCESS_LOOP_TIMEOUT_MS                 ( 500U )
-
 /**
  * @brief Delay (in ticks) between consecutive cycles of MQTT publish operations in a
  * demo iteration.
  *
- * Note that the process loop also has a timeout, so the total time between
- * publishes is the sum of the two delays.
+ * Messages from IoT Hub are processed as they arrive, in between.
  */
 #define sampleazureiotDELAY_BETWEEN_PUBLISHES_TICKS           ( pdMS_TO_TICKS( 2000U ) )
 
+/**
+ * @brief Delay (in ticks) between two runs of the MQTT process loop while no
+ * message arrives, so that keep alive packets are sent in time.
+ *
+ * Must be well below the MQTT keep alive interval, and below
+ * SOCKETS_DNS_CACHE_PREFETCH_SECONDS so cached addresses are resolved again
+ * before they expire.
+ */
+#define sampleazureiotKEEP_ALIVE_PERIOD_TICKS                 ( pdMS_TO_TICKS( 20 * 1000U ) )
+
 /**
  * @brief Transport timeout in milliseconds for transport send and receive.
  */
@@ -151,6 +167,9 @@ static uint8_t ucCommandResponsePayloadBuffer[ 256 ];
 /* Reported Properties buffers */
 static uint8_t ucReportedPropertiesUpdate[ 320 ];
 static uint32_t ulReportedPropertiesUpdateLength;
+
+/* Event loop of the demo task */
+static EventLoop_t xEventLoop;
 /*-----------------------------------------------------------*/
 
 #ifdef democonfigENABLE_DPS_SAMPLE
@@ -294,6 +313,74 @@ static void prvHandleProperties( AzureIoTHubClientPropertiesResponse_t * pxMessa
 }
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Event loop handler processing the messages from IoT Hub and the
+ * MQTT keep alive.
+ */
+static BaseType_t prvProcessLoop( void * pvContext )
+{
+    AzureIoTResult_t xResult;
+
+    ( void ) pvContext;
+
+    /* The event loop only calls in when there is data, or keep alive is
+     * due, so do not wait for more. */
+    xResult = AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient, 0 );
+    configASSERT( xResult == eAzureIoTSuccess );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Event loop handler for the keep alive timer, which also resolves
+ * the host names of the connection again before their cached addresses expire.
+ */
+static BaseType_t prvKeepAlive( void * pvContext )
+{
+    #if ( democonfigSOCKETS_DNS_CACHE == 1 )
+        /* Only addresses about to expire are resolved, at most once per
+         * TTL, so the next reconnect does not wait for the DNS server. */
+        SocketsDnsCache_Prefetch();
+    #endif
+
+    return prvProcessLoop( pvContext );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Event loop handler sending telemetry and reported properties.
+ */
+static BaseType_t prvSendTelemetry( void * pvContext )
+{
+    uint32_t ulScratchBufferLength = 0U;
+    AzureIoTResult_t xResult;
+
+    ( void ) pvContext;
+
+    /* Hook for sending Telemetry */
+    if( ( ulCreateTelemetry( ucScratchBuffer, sizeof( ucScratchBuffer ), &ulScratchBufferLength ) == 0 ) &&
+        ( ulScratchBufferLength > 0 ) )
+    {
+        xResult = AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient,
+                                                   ucScratchBuffer, ulScratchBufferLength,
+                                                   NULL, eAzureIoTHubMessageQoS1, NULL );
+        configASSERT( xResult == eAzureIoTSuccess );
+    }
+
+    /* Hook for sending update to reported properties */
+    ulReportedPropertiesUpdateLength = ulCreateReportedPropertiesUpdate( ucReportedPropertiesUpdate, sizeof( ucReportedPropertiesUpdate ) );
+
+    if( ulReportedPropertiesUpdateLength > 0 )
+    {
+        xResult = AzureIoTHubClient_SendPropertiesReported( &xAzureIoTHubClient, ucReportedPropertiesUpdate, ulReportedPropertiesUpdateLength, NULL );
+        configASSERT( xResult == eAzureIoTSuccess );
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Setup transport credentials.
  */
@@ -321,7 +408,6 @@ static uint32_t prvSetupNetworkCredentials( NetworkCredentials_t * pxNetworkCred
  */
 static void prvAzureDemoTask( void * pvParameters )
 {
-    uint32_t ulScratchBufferLength = 0U;
     NetworkCredentials_t xNetworkCredentials = { 0 };
     AzureIoTTransportInterface_t xTransport;
     NetworkContext_t xNetworkContext = { 0 };
@@ -330,6 +416,8 @@ static void prvAzureDemoTask( void * pvParameters )
     uint32_t ulStatus;
     AzureIoTHubClientOptions_t xHubOptions = { 0 };
     bool xSessionPresent;
+    EventLoopTimer_t * pxTimer;
+    BaseType_t xLoopResult;
 
     #ifdef democonfigENABLE_DPS_SAMPLE
         uint8_t * pucIotHubHostname = NULL;
@@ -429,37 +517,21 @@ static void prvAzureDemoTask( void * pvParameters )
         xResult = AzureIoTHubClient_RequestPropertiesAsync( &xAzureIoTHubClient );
         configASSERT( xResult == eAzureIoTSuccess );
 
-        /* Publish messages with QoS1, send and process Keep alive messages. */
-        for( ; ; )
-        {
-            /* Hook for sending Telemetry */
-            if( ( ulCreateTelemetry( ucScratchBuffer, sizeof( ucScratchBuffer ), &ulScratchBufferLength ) == 0 ) &&
-                ( ulScratchBufferLength > 0 ) )
-            {
-                xResult = AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient,
-                                                           ucScratchBuffer, ulScratchBufferLength,
-                                                           NULL, eAzureIoTHubMessageQoS1, NULL );
-                configASSERT( xResult == eAzureIoTSuccess );
-            }
-
-            /* Hook for sending update to reported properties */
-            ulReportedPropertiesUpdateLength = ulCreateReportedPropertiesUpdate( ucReportedPropertiesUpdate, sizeof( ucReportedPropertiesUpdate ) );
-
-            if( ulReportedPropertiesUpdateLength > 0 )
-            {
-                xResult = AzureIoTHubClient_SendPropertiesReported( &xAzureIoTHubClient, ucReportedPropertiesUpdate, ulReportedPropertiesUpdateLength, NULL );
-                configASSERT( xResult == eAzureIoTSuccess );
-            }
-
-            LogInfo( ( "Attempt to receive publish message from IoT Hub.\r\n" ) );
-            xResult = AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient,
-                                                     sampleazureiotPROCESS_LOOP_TIMEOUT_MS );
-            configASSERT( xResult == eAzureIoTSuccess );
-
-            /* Leave Connection Idle for some time. */
-            LogInfo( ( "Keeping Connection Idle...\r\n\r\n" ) );
-            vTaskDelay( sampleazureiotDELAY_BETWEEN_PUBLISHES_TICKS );
-        }
+        /* Publish messages with QoS1, send and process Keep alive messages.
+         * The task sleeps until a message arrives or one of the timers is due. */
+        EventLoop_Init( &xEventLoop, &xNetworkContext, prvProcessLoop, NULL );
+        pxTimer = EventLoop_AddTimer( &xEventLoop, sampleazureiotDELAY_BETWEEN_PUBLISHES_TICKS,
+                                      prvSendTelemetry, NULL );
+        configASSERT( pxTimer != NULL );
+        pxTimer = EventLoop_AddTimer( &xEventLoop, sampleazureiotKEEP_ALIVE_PERIOD_TICKS,
+                                      prvKeepAlive, NULL );
+        configASSERT( pxTimer != NULL );
+
+        /* Send the first telemetry without waiting a full period. */
+        ( void ) prvSendTelemetry( NULL );
+
+        xLoopResult = EventLoop_Run( &xEventLoop );
+        configASSERT( xLoopResult == pdPASS );
 
         xResult = AzureIoTHubClient_UnsubscribeProperties( &xAzureIoTHubClient );
         configASSERT( xResult == eAzureIoTSuccess );